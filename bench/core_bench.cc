@@ -0,0 +1,230 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 组件微基准: 分别测量请求解析、响应头生成、线程池调度与缓冲区增长的耗时,
+ *               端到端压测中被网络与系统调用掩盖的回退在这里能直接看到
+ * @Date: 2026-10-17 21:58:40
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 21:58:40
+ */
+#include "http_conn.h"
+#include "threadpool.h"
+#include <sched.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+/**
+ * 通过 http_conn 的友元直接调用内部步骤, 连接使用 socketpair, 不经过 eventloop
+ */
+struct http_conn_probe{
+    static bool open(http_conn* conn, int* fds){
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) return false;
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        conn->init(fds[0], addr, nullptr);
+        return true;
+    }
+
+    // 开始一个新请求, 相当于 read() 读入了 request
+    static bool feed(http_conn* conn, const std::string& request){
+        conn->init();
+        if(!conn->m_read_buf.reserve(0, request.size() + 1)) return false;
+        memcpy(conn->m_read_buf.data(), request.data(), request.size());
+        conn->m_read_idx = (int)request.size();
+        return true;
+    }
+
+    static http_conn::HTTP_CODE read(http_conn* conn){
+        return conn->process_read();
+    }
+
+    static bool write(http_conn* conn, http_conn::HTTP_CODE code){
+        return conn->process_write(code);
+    }
+
+    // 连接没有注册到事件引擎, 释放后直接关闭描述符
+    static void close(http_conn* conn){
+        int fd = conn->m_sockfd;
+        conn->release();
+        ::close(fd);
+    }
+
+    static void unmap(http_conn* conn){ conn->unmap(); }
+    static void clear(http_conn* conn){ conn->clear_responses(); }
+    static int written(http_conn* conn){ return conn->m_write_idx; }
+};
+
+// 每轮的步骤, 由 run() 统一计时
+enum STEP{
+    STEP_FEED = 0,              // 只拷贝请求, 作为基线从其他结果中减去
+    STEP_READ,                  // 拷贝 + process_read()
+    STEP_WRITE,                 // 拷贝 + process_read() + process_write()
+    STEP_ERROR                  // 拷贝 + 直接生成 404 响应
+};
+
+static double now_ns(){
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @return {double} 每轮纳秒数, 结果不符合预期时返回负数
+ */
+static double run(http_conn* conn, const std::string& request, STEP step, long rounds){
+    double t0 = now_ns();
+    for(long i = 0; i < rounds; i++){
+        if(!http_conn_probe::feed(conn, request)) return -1;
+        if(step == STEP_ERROR){
+            if(!http_conn_probe::write(conn, http_conn::NO_RESOURCE)) return -1;
+            http_conn_probe::clear(conn);
+            continue;
+        }
+        if(step == STEP_FEED) continue;
+        http_conn::HTTP_CODE code = http_conn_probe::read(conn);
+        if(code != http_conn::FILE_REQUEST) return -1;
+        if(step == STEP_READ){
+            http_conn_probe::unmap(conn);
+            continue;
+        }
+        if(!http_conn_probe::write(conn, code)) return -1;
+        http_conn_probe::clear(conn);
+    }
+    return (now_ns() - t0) / rounds;
+}
+
+struct request_case{
+    const char* name;
+    std::string text;
+};
+
+static void bench_conn(long rounds){
+    // 文件缓存与服务器默认配置相同: 缓存命中, sendfile 模式
+    DOC_ROOT = RESOURCE_DIR;
+    http_conn::m_file_cache = new file_cache(1024, 64 * 1024 * 1024, !http_conn::m_use_sendfile);
+
+    std::string cookie(3000, 'c');
+    request_case cases[] = {
+        {"curl", "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: curl/8.5.0\r\nAccept: */*\r\n\r\n"},
+        {"browser",
+         "GET /images/tmp1.jpg HTTP/1.1\r\n"
+         "Host: 127.0.0.1:9006\r\n"
+         "Connection: keep-alive\r\n"
+         "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+         "Accept: image/avif,image/webp,image/apng,image/svg+xml,image/*,*/*;q=0.8\r\n"
+         "Referer: http://127.0.0.1:9006/index.html\r\n"
+         "Accept-Encoding: gzip, deflate, br\r\n"
+         "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+         "Sec-Fetch-Dest: image\r\n"
+         "Sec-Fetch-Mode: no-cors\r\n"
+         "Sec-Fetch-Site: same-origin\r\n\r\n"},
+        // 超过读缓冲区内联大小, 每轮 init() 后都在堆上增长
+        {"cookie", "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1\r\nCookie: session=" + cookie + "\r\n\r\n"},
+    };
+
+    int fds[2];
+    http_conn* conn = new http_conn();
+    if(!http_conn_probe::open(conn, fds)){
+        printf("create connection failed, errno: %d\n", errno);
+        return;
+    }
+    printf("http_conn (ns/request, request copy subtracted)\n");
+    printf("  %-8s %6s %12s %12s %12s\n", "request", "bytes", "process_read", "serialize", "404");
+    for(request_case& c : cases){
+        // 预热: 载入文件缓存, 生成 Date 缓存
+        if(run(conn, c.text, STEP_WRITE, 1000) < 0){
+            printf("  %-8s unexpected result\n", c.name);
+            continue;
+        }
+        double feed = run(conn, c.text, STEP_FEED, rounds);
+        double read = run(conn, c.text, STEP_READ, rounds);
+        double write = run(conn, c.text, STEP_WRITE, rounds);
+        double error = run(conn, c.text, STEP_ERROR, rounds);
+        printf("  %-8s %6zu %12.1f %12.1f %12.1f\n", c.name, c.text.size(), read - feed, write - read, error - feed);
+    }
+    http_conn_probe::close(conn);
+    close(fds[1]);
+}
+
+/**
+ * 处理时只计数的请求, 测量线程池自身的 append + 取出 + 唤醒开销
+ */
+struct empty_task{
+    static std::atomic<long> done;
+    int id;
+    void process(){ done.fetch_add(1, std::memory_order_relaxed); }
+    int affinity() const{ return id; }
+};
+
+std::atomic<long> empty_task::done(0);
+
+static void bench_pool(long rounds){
+    printf("threadpool (ns/request, one producer)\n");
+    const int TASKS = 1024;
+    empty_task* tasks = new empty_task[TASKS];
+    for(int i = 0; i < TASKS; i++) tasks[i].id = i;
+    for(POOL_MODE mode : {SHARED_QUEUE, WORK_STEALING}){
+        for(int threads : {1, 4}){
+            // worker 为 detach 线程, 与 threadpool_bench 一样不释放 pool
+            threadpool<empty_task>* pool = new threadpool<empty_task>(threads, 10000, mode);
+            empty_task::done.store(0);
+            double t0 = now_ns();
+            for(long i = 0; i < rounds; i++){
+                while(!pool->append(tasks + i % TASKS)) sched_yield();
+            }
+            while(empty_task::done.load(std::memory_order_relaxed) < rounds) sched_yield();
+            printf("  %-14s %d threads %8.1f\n", mode == SHARED_QUEUE ? "shared queue" : "work stealing",
+                   threads, (now_ns() - t0) / rounds);
+        }
+    }
+
+    // 不经过 worker 的队列本身: 单线程 push + pop
+    mpmc_queue<empty_task*> queue(1024);
+    empty_task* out;
+    double t0 = now_ns();
+    for(long i = 0; i < rounds; i++){
+        queue.push(tasks);
+        queue.pop(out);
+    }
+    printf("  %-14s           %8.1f\n", "queue push+pop", (now_ns() - t0) / rounds);
+}
+
+static void bench_buffer(long rounds){
+    printf("buffer<%d> (ns/op)\n", http_conn::READ_BUFFER_SIZE);
+    buffer<http_conn::READ_BUFFER_SIZE> buf;
+    buf.init(64 * 1024);
+    memset(buf.data(), 'a', http_conn::READ_BUFFER_SIZE);
+
+    double t0 = now_ns();
+    for(long i = 0; i < rounds; i++){
+        if(!buf.reserve(512, 1000)) return;
+        asm volatile("" : : "r"(buf.data()) : "memory");
+    }
+    printf("  %-24s %8.1f\n", "reserve within inline", (now_ns() - t0) / rounds);
+
+    for(size_t size : {4096, 65536}){
+        t0 = now_ns();
+        for(long i = 0; i < rounds; i++){
+            if(!buf.reserve(http_conn::READ_BUFFER_SIZE, size)) return;
+            buf.data()[size - 1] = 'b';
+            buf.shrink(512);
+        }
+        char name[48];
+        snprintf(name, sizeof(name), "grow to %zuK + shrink", size / 1024);
+        printf("  %-24s %8.1f\n", name, (now_ns() - t0) / rounds);
+    }
+}
+
+int main(int argc, char* argv[]){
+    long rounds = argc > 1 ? atol(argv[1]) : 200000;
+    if(!logger::init("/dev/null")){
+        printf("open /dev/null failed\n");
+        return 1;
+    }
+    bench_conn(rounds);
+    bench_pool(rounds * 5);
+    bench_buffer(rounds * 5);
+    logger::stop();
+    return 0;
+}
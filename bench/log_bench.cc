@@ -0,0 +1,81 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 日志开销: 异步日志调用线程一侧的耗时, 与每条日志 fprintf + fflush 对比
+ * @Date: 2026-10-17 20:21:37
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 20:21:37
+ */
+#include "log.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define BURST 1000              // 每批条数, 批之间留时间给后台线程写出, 避免测到缓冲区满时的丢弃
+
+static FILE* s_null;
+
+struct bench_arg{
+    int mode;                   // 0 异步日志, 1 fprintf + fflush, 2 编译期关闭的日志
+    int bursts;
+    double ns;
+};
+
+static void* bench_worker(void* arg){
+    bench_arg* a = (bench_arg*)arg;
+    const char* path = "/images/tmp1.jpg";
+    std::chrono::steady_clock::duration spent{};
+    for(int b = 0; b < a->bursts; b++){
+        auto t0 = std::chrono::steady_clock::now();
+        for(int i = 0; i < BURST; i++){
+            if(a->mode == 0){
+                LOG_INFO("fd %d read %d bytes, file: %s", i, b, path);
+            }else if(a->mode == 1){
+                fprintf(s_null, "fd %d read %d bytes, file: %s\n", i, b, path);
+                fflush(s_null);
+            }else{
+                LOG_DISCARD("fd %d read %d bytes, file: %s", i, b, path);
+            }
+        }
+        spent += std::chrono::steady_clock::now() - t0;
+        usleep(20000);
+    }
+    a->ns = std::chrono::duration<double, std::nano>(spent).count() / ((double)a->bursts * BURST);
+    return nullptr;
+}
+
+static void run(const char* name, int mode, int threads, int bursts){
+    std::vector<pthread_t> tids(threads);
+    std::vector<bench_arg> args(threads);
+    for(int i = 0; i < threads; i++){
+        args[i] = {mode, bursts, 0};
+        pthread_create(&tids[i], nullptr, bench_worker, &args[i]);
+    }
+    double total = 0;
+    for(int i = 0; i < threads; i++){
+        pthread_join(tids[i], nullptr);
+        total += args[i].ns;
+    }
+    printf("  %-16s %8.1f ns/call\n", name, total / threads);
+}
+
+int main(int argc, char* argv[]){
+    int bursts = argc > 1 ? atoi(argv[1]) : 100;
+    s_null = fopen("/dev/null", "w");
+    if(!s_null || !logger::init("/dev/null")){
+        printf("open /dev/null failed\n");
+        return 1;
+    }
+    for(int threads : {1, 4, 8}){
+        printf("%d threads, %d calls each\n", threads, bursts * BURST);
+        run("async log", 0, threads, bursts);
+        run("fprintf+fflush", 1, threads, bursts);
+        run("disabled", 2, threads, bursts);
+    }
+    logger::stop();
+    printf("dropped: %llu\n", (unsigned long long)logger::dropped());
+    return 0;
+}
@@ -0,0 +1,626 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: HTTP/1.1 压测工具: 多线程 epoll, 支持 keep-alive、流水线、按 resources/ 中的文件混合请求,
+ *               输出吞吐与经过 coordinated omission 修正的延迟分位数, 以及服务端每个请求的系统调用数
+ * @Date: 2026-10-17 21:20:52
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 21:20:52
+ */
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <strings.h>
+#include <vector>
+
+#define MAX_PIPELINE 64                 // 单个连接最多同时未完成的请求
+#define READ_BUFFER_SIZE (64 * 1024)
+#define MAX_EVENTS 256
+
+static uint64_t now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * 对数线性分桶的延迟直方图(纳秒), 每个 2 的幂区间 16 个子桶, 相对误差不超过 6.25%
+ */
+struct histogram{
+    static const int SUB_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKETS = 40 * SUB_BUCKETS;
+
+    uint64_t counts[BUCKETS];
+    uint64_t total;
+    uint64_t max;
+
+    histogram(){ clear(); }
+
+    void clear(){
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+        max = 0;
+    }
+
+    static int bucket(uint64_t v){
+        if(v < (uint64_t)SUB_BUCKETS) return (int)v;
+        int shift = 63 - __builtin_clzll(v) - SUB_BITS;
+        int index = shift * SUB_BUCKETS + (int)(v >> shift);
+        return index < BUCKETS ? index : BUCKETS - 1;
+    }
+
+    // 桶内取中点作为代表值
+    static uint64_t value(int index){
+        if(index < SUB_BUCKETS) return index;
+        int shift = index / SUB_BUCKETS - 1;
+        uint64_t low = (uint64_t)(index % SUB_BUCKETS + SUB_BUCKETS) << shift;
+        return low + ((1ull << shift) >> 1);
+    }
+
+    void record(uint64_t v, uint64_t n = 1){
+        counts[bucket(v)] += n;
+        total += n;
+        if(v > max) max = v;
+    }
+
+    /**
+     * @brief 补上因为等待慢响应而没有发出的请求:
+     *        一个耗时 v 的请求期间, 按预期间隔本应再发出 (v - interval), (v - 2 * interval) ... 的请求
+     *        (与 HdrHistogram 的 recordValueWithExpectedInterval 相同)
+     */
+    void record_corrected(uint64_t v, uint64_t interval){
+        record(v);
+        if(interval == 0) return;
+        for(uint64_t missed = v > interval ? v - interval : 0; missed >= interval; missed -= interval){
+            record(missed);
+        }
+    }
+
+    void merge(const histogram& o){
+        for(int i = 0; i < BUCKETS; i++) counts[i] += o.counts[i];
+        total += o.total;
+        if(o.max > max) max = o.max;
+    }
+
+    uint64_t percentile(double p) const{
+        if(total == 0) return 0;
+        uint64_t rank = (uint64_t)(p / 100.0 * total + 0.5);
+        if(rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for(int i = 0; i < BUCKETS; i++){
+            seen += counts[i];
+            if(seen >= rank) return value(i) < max ? value(i) : max;
+        }
+        return max;
+    }
+};
+
+struct config{
+    int port = 9006;
+    int connections = 64;
+    int threads = 4;
+    int duration = 10;                  // 秒
+    int pipeline = 1;
+    bool keep_alive = true;
+    double rate = 0;                    // 总请求速率(请求/秒), 0 表示不限速
+    std::vector<std::string> urls;
+};
+
+static config s_config;
+static std::vector<std::string> s_requests;     // 每个 URL 预先生成的请求
+
+struct connection{
+    int fd = -1;
+    bool connected = false;
+    int url_index = 0;
+    std::string out;                    // 待发送的请求
+    size_t out_off = 0;
+    bool want_write = false;
+
+    char* in = nullptr;
+    size_t in_len = 0;
+    bool in_body = false;
+    uint64_t body_left = 0;
+    bool server_close = false;
+    int status = 0;
+
+    uint64_t sent[MAX_PIPELINE];        // 未完成请求的实际发送时间
+    uint64_t planned[MAX_PIPELINE];     // 限速时未完成请求的计划发送时间
+    int sent_head = 0;
+    int sent_count = 0;
+    uint64_t next_send = 0;             // 限速时下一个请求的计划时间, 第一次连接成功前为相对的错开时间
+    bool started = false;
+};
+
+struct worker{
+    int index;
+    int connections;
+    pthread_t tid;
+    int epollfd;
+    std::vector<connection> conns;
+    uint64_t interval;                  // 限速时每个连接的请求间隔
+
+    histogram latency;                  // 实测
+    histogram corrected;                // 修正后
+    uint64_t requests = 0;
+    uint64_t bytes = 0;
+    uint64_t status_2xx = 0;
+    uint64_t status_other = 0;
+    uint64_t errors = 0;
+    uint64_t connects = 0;
+};
+
+static void set_events(worker* w, connection* c, bool write){
+    struct epoll_event ev;
+    ev.data.ptr = c;
+    ev.events = EPOLLIN | (write ? (uint32_t)EPOLLOUT : 0u);
+    epoll_ctl(w->epollfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->want_write = write;
+}
+
+static bool open_conn(worker* w, connection* c){
+    c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(c->fd < 0) return false;
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(s_config.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(connect(c->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS){
+        close(c->fd);
+        c->fd = -1;
+        return false;
+    }
+    c->connected = false;
+    c->out.clear();
+    c->out_off = 0;
+    c->in_len = 0;
+    c->in_body = false;
+    c->server_close = false;
+    c->sent_head = 0;
+    c->sent_count = 0;
+    struct epoll_event ev;
+    ev.data.ptr = c;
+    ev.events = EPOLLIN | EPOLLOUT;
+    epoll_ctl(w->epollfd, EPOLL_CTL_ADD, c->fd, &ev);
+    c->want_write = true;
+    w->connects++;
+    return true;
+}
+
+static void close_conn(worker* w, connection* c){
+    if(c->fd != -1){
+        epoll_ctl(w->epollfd, EPOLL_CTL_DEL, c->fd, nullptr);
+        close(c->fd);
+        c->fd = -1;
+    }
+}
+
+static void reconnect(worker* w, connection* c, bool error){
+    if(error) w->errors += c->sent_count > 0 ? c->sent_count : 1;
+    close_conn(w, c);
+    if(!open_conn(w, c)) w->errors++;
+}
+
+/**
+ * @brief 发出 out 中剩余的数据
+ * @return {bool} 出错时返回 false
+ */
+static bool flush(worker* w, connection* c){
+    while(c->out_off < c->out.size()){
+        ssize_t n = send(c->fd, c->out.data() + c->out_off, c->out.size() - c->out_off, MSG_NOSIGNAL);
+        if(n < 0){
+            if(errno == EAGAIN){
+                if(!c->want_write) set_events(w, c, true);
+                return true;
+            }
+            return false;
+        }
+        c->out_off += n;
+    }
+    c->out.clear();
+    c->out_off = 0;
+    if(c->want_write) set_events(w, c, false);
+    return true;
+}
+
+/**
+ * @brief 补满流水线: 不限速时立即发出, 限速时只发出已到计划时间的请求
+ */
+static bool fill(worker* w, connection* c, uint64_t now){
+    if(!c->connected) return true;
+    int depth = s_config.keep_alive ? s_config.pipeline : 1;
+    bool added = false;
+    while(c->sent_count < depth){
+        uint64_t start = now;
+        if(w->interval){
+            if(c->next_send > now) break;
+            start = c->next_send;
+            c->next_send += w->interval;
+        }
+        c->out += s_requests[c->url_index++ % s_requests.size()];
+        int slot = (c->sent_head + c->sent_count) % MAX_PIPELINE;
+        c->sent[slot] = now;
+        c->planned[slot] = start;
+        c->sent_count++;
+        added = true;
+        if(!s_config.keep_alive) break;
+    }
+    return !added || flush(w, c);
+}
+
+/**
+ * @brief 一个响应接收完成
+ */
+static void complete(worker* w, connection* c, uint64_t now){
+    uint64_t start = c->sent[c->sent_head];
+    uint64_t planned = c->planned[c->sent_head];
+    c->sent_head = (c->sent_head + 1) % MAX_PIPELINE;
+    c->sent_count--;
+    w->latency.record(now > start ? now - start : 0);
+    // 限速时从计划发送时间算起, 因前面的慢响应而推迟发出的时间也计入延迟
+    if(w->interval) w->corrected.record(now > planned ? now - planned : 0);
+    w->requests++;
+    if(c->status >= 200 && c->status < 300) w->status_2xx++;
+    else w->status_other++;
+}
+
+/**
+ * @brief 解析缓冲区中的响应
+ * @return {bool} 响应格式错误时返回 false
+ */
+static bool parse(worker* w, connection* c, uint64_t now){
+    size_t pos = 0;
+    while(pos < c->in_len){
+        if(c->in_body){
+            uint64_t n = c->in_len - pos < c->body_left ? c->in_len - pos : c->body_left;
+            pos += n;
+            c->body_left -= n;
+        }else{
+            char* begin = c->in + pos;
+            char* end = (char*)memmem(begin, c->in_len - pos, "\r\n\r\n", 4);
+            if(!end) break;
+            *end = '\0';
+            if(strncmp(begin, "HTTP/1.", 7) != 0) return false;
+            c->status = atoi(begin + 9);
+            c->body_left = 0;
+            c->server_close = false;
+            for(char* line = strstr(begin, "\r\n"); line; line = strstr(line, "\r\n")){
+                line += 2;
+                if(strncasecmp(line, "Content-Length:", 15) == 0){
+                    c->body_left = strtoull(line + 15, nullptr, 10);
+                }else if(strncasecmp(line, "Connection:", 11) == 0){
+                    c->server_close = strcasestr(line + 11, "close") != nullptr;
+                }
+            }
+            pos = end + 4 - c->in;
+            c->in_body = true;
+        }
+        if(c->in_body && c->body_left == 0){
+            c->in_body = false;
+            if(c->sent_count == 0) return false;
+            complete(w, c, now);
+            if(c->server_close) return true;
+        }
+    }
+    // 剩余的不完整响应头移到开头
+    if(pos > 0){
+        memmove(c->in, c->in + pos, c->in_len - pos);
+        c->in_len -= pos;
+    }
+    return c->in_len < READ_BUFFER_SIZE;
+}
+
+static void on_readable(worker* w, connection* c, uint64_t now){
+    while(true){
+        ssize_t n = recv(c->fd, c->in + c->in_len, READ_BUFFER_SIZE - c->in_len, 0);
+        if(n < 0){
+            if(errno == EAGAIN) break;
+            reconnect(w, c, true);
+            return;
+        }
+        if(n == 0){
+            // 服务器关闭: 请求都已完成时是正常的 Connection: close
+            reconnect(w, c, c->sent_count > 0);
+            return;
+        }
+        w->bytes += n;
+        c->in_len += n;
+        if(!parse(w, c, now)){
+            reconnect(w, c, true);
+            return;
+        }
+        // 响应头中的 Connection: close 要等实体接收完才生效
+        if((c->server_close && !c->in_body) || (!s_config.keep_alive && c->sent_count == 0)){
+            if(c->sent_count > 0) w->errors += c->sent_count;
+            reconnect(w, c, false);
+            return;
+        }
+    }
+    if(!fill(w, c, now)) reconnect(w, c, true);
+}
+
+static void* run_worker(void* arg){
+    worker* w = (worker*)arg;
+    w->epollfd = epoll_create1(EPOLL_CLOEXEC);
+    w->conns.resize(w->connections);
+    uint64_t now = now_ns();
+    for(int i = 0; i < w->connections; i++){
+        connection* c = &w->conns[i];
+        c->in = (char*)malloc(READ_BUFFER_SIZE);
+        c->url_index = (w->index * 7919 + i * 104729) % (int)s_requests.size();
+        // 限速时各连接错开发送时间
+        c->next_send = w->interval ? w->interval * i / w->connections : 0;
+        if(!open_conn(w, c)) w->errors++;
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t end = now + (uint64_t)s_config.duration * 1000000000ull;
+    while((now = now_ns()) < end){
+        // 限速时睡到最早的计划发送时间, 不足 1ms 时不睡眠, 否则毫秒级的超时会被计入延迟
+        int timeout = 100;
+        if(w->interval){
+            uint64_t next = end;
+            for(connection& c : w->conns){
+                if(c.fd != -1 && c.connected && c.sent_count == 0 && c.next_send < next) next = c.next_send;
+            }
+            timeout = next > now ? (int)((next - now) / 1000000) : 0;
+            if(timeout > 100) timeout = 100;
+        }
+        int num = epoll_wait(w->epollfd, events, MAX_EVENTS, timeout);
+        now = now_ns();
+        for(int i = 0; i < num; i++){
+            connection* c = (connection*)events[i].data.ptr;
+            if(c->fd == -1) continue;
+            if(events[i].events & (EPOLLERR | EPOLLHUP)){
+                reconnect(w, c, true);
+                continue;
+            }
+            if(events[i].events & EPOLLOUT){
+                if(!c->connected){
+                    int err = 0;
+                    socklen_t len = sizeof(err);
+                    getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                    if(err){
+                        reconnect(w, c, true);
+                        continue;
+                    }
+                    c->connected = true;
+                    set_events(w, c, false);
+                    // 计划从第一次连接成功时开始, 建立连接的耗时(如 SYN 重传)不计入请求延迟
+                    if(!c->started){
+                        c->next_send += now;
+                        c->started = true;
+                    }
+                    if(!fill(w, c, now)){
+                        reconnect(w, c, true);
+                        continue;
+                    }
+                }else if(!flush(w, c)){
+                    reconnect(w, c, true);
+                    continue;
+                }
+            }
+            if(events[i].events & EPOLLIN){
+                on_readable(w, c, now);
+            }
+        }
+        if(w->interval){
+            for(connection& c : w->conns){
+                if(c.fd != -1 && !fill(w, &c, now)) reconnect(w, &c, true);
+            }
+        }
+    }
+    for(connection& c : w->conns){
+        close_conn(w, &c);
+        free(c.in);
+    }
+    close(w->epollfd);
+    return nullptr;
+}
+
+/**
+ * @brief 递归收集目录下的文件, URL 为相对路径
+ */
+static void collect(const std::string& root, const std::string& rel, std::vector<std::string>& urls){
+    DIR* dir = opendir((root + rel).c_str());
+    if(!dir) return;
+    struct dirent* ent;
+    while((ent = readdir(dir)) != nullptr){
+        if(ent->d_name[0] == '.') continue;
+        std::string path = rel + "/" + ent->d_name;
+        struct stat st;
+        if(stat((root + path).c_str(), &st) < 0) continue;
+        if(S_ISDIR(st.st_mode)) collect(root, path, urls);
+        else if(S_ISREG(st.st_mode)) urls.push_back(path);
+    }
+    closedir(dir);
+}
+
+/**
+ * 服务端 /metrics 中与系统调用相关的计数器, 压测前后各取一次求差
+ */
+struct server_counters{
+    bool ok = false;
+    uint64_t syscalls = 0;
+    uint64_t responses = 0;             // nk_requests_total 各状态码之和
+};
+
+/**
+ * @brief 阻塞地请求一次 /metrics 并解析需要的计数器, 服务端未提供时 ok 为 false
+ */
+static server_counters scrape(int port){
+    server_counters result;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0) return result;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    std::string body;
+    const char* req = "GET /metrics HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n";
+    if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 && write(fd, req, strlen(req)) == (ssize_t)strlen(req)){
+        char buf[16 * 1024];
+        ssize_t n;
+        while((n = read(fd, buf, sizeof(buf))) > 0) body.append(buf, n);
+    }
+    close(fd);
+    if(body.compare(0, 12, "HTTP/1.1 200") != 0) return result;
+
+    size_t pos = 0;
+    while(pos < body.size()){
+        size_t end = body.find('\n', pos);
+        if(end == std::string::npos) end = body.size();
+        std::string line = body.substr(pos, end - pos);
+        pos = end + 1;
+        size_t space = line.rfind(' ');
+        if(line.empty() || line[0] == '#' || space == std::string::npos) continue;
+        uint64_t value = strtoull(line.c_str() + space + 1, nullptr, 10);
+        if(line.compare(0, space, "nk_syscalls_total") == 0){
+            result.syscalls = value;
+            result.ok = true;
+        }else if(line.compare(0, 18, "nk_requests_total{") == 0){
+            result.responses += value;
+        }
+    }
+    return result;
+}
+
+static void usage(const char* name){
+    printf("%s [-c connections] [-t threads] [-d seconds] [-p pipeline] [-R rate] [-K] [-r dir] [-u url]... port\n", name);
+    printf("  -c  连接数, 默认 64\n");
+    printf("  -t  线程数, 默认 4\n");
+    printf("  -d  测试时长(秒), 默认 10\n");
+    printf("  -p  每个连接的流水线深度, 默认 1, 最大 %d\n", MAX_PIPELINE);
+    printf("  -R  总请求速率(请求/秒), 延迟从计划发送时间算起; 默认不限速\n");
+    printf("  -K  不使用 keep-alive, 每个请求一个连接\n");
+    printf("  -r  请求该目录下的所有文件, 默认 resources\n");
+    printf("  -u  请求的 URL, 可以重复; 指定后不再扫描目录\n");
+}
+
+static void print_latency(const char* name, const histogram& h){
+    printf("  %-10s %9.3f %9.3f %9.3f %9.3f %9.3f\n", name,
+           h.percentile(50) / 1e6, h.percentile(99) / 1e6, h.percentile(99.9) / 1e6,
+           h.percentile(99.99) / 1e6, h.max / 1e6);
+}
+
+int main(int argc, char* argv[]){
+    const char* dir = "resources";
+    int opt;
+    while((opt = getopt(argc, argv, "c:t:d:p:R:Kr:u:")) != -1){
+        switch(opt){
+            case 'c': s_config.connections = atoi(optarg); break;
+            case 't': s_config.threads = atoi(optarg); break;
+            case 'd': s_config.duration = atoi(optarg); break;
+            case 'p': s_config.pipeline = atoi(optarg); break;
+            case 'R': s_config.rate = atof(optarg); break;
+            case 'K': s_config.keep_alive = false; break;
+            case 'r': dir = optarg; break;
+            case 'u': s_config.urls.push_back(optarg); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(optind >= argc || s_config.connections <= 0 || s_config.threads <= 0 || s_config.duration <= 0
+       || s_config.pipeline <= 0 || s_config.pipeline > MAX_PIPELINE){
+        usage(argv[0]);
+        return 1;
+    }
+    s_config.port = atoi(argv[optind]);
+    if(s_config.threads > s_config.connections) s_config.threads = s_config.connections;
+
+    if(s_config.urls.empty()){
+        collect(dir, "", s_config.urls);
+        if(s_config.urls.empty()){
+            printf("no files under %s, use -u to give URLs\n", dir);
+            return 1;
+        }
+    }
+    for(const std::string& url : s_config.urls){
+        std::string req = "GET " + url + " HTTP/1.1\r\nHost: 127.0.0.1\r\n";
+        if(!s_config.keep_alive) req += "Connection: close\r\n";
+        s_requests.push_back(req + "\r\n");
+    }
+
+    printf("%d s test @ 127.0.0.1:%d, %d threads, %d connections, pipeline %d, %s, %zu urls",
+           s_config.duration, s_config.port, s_config.threads, s_config.connections,
+           s_config.keep_alive ? s_config.pipeline : 1, s_config.keep_alive ? "keep-alive" : "close",
+           s_config.urls.size());
+    if(s_config.rate > 0) printf(", %.0f req/s", s_config.rate);
+    printf("\n");
+
+    server_counters before = scrape(s_config.port);
+    std::vector<worker> workers(s_config.threads);
+    uint64_t begin = now_ns();
+    for(int i = 0; i < s_config.threads; i++){
+        worker& w = workers[i];
+        w.index = i;
+        w.connections = s_config.connections / s_config.threads + (i < s_config.connections % s_config.threads);
+        w.interval = s_config.rate > 0 ? (uint64_t)(1e9 * s_config.connections / s_config.rate) : 0;
+        pthread_create(&w.tid, nullptr, run_worker, &w);
+    }
+    histogram latency, corrected;
+    uint64_t requests = 0, bytes = 0, ok = 0, other = 0, errors = 0, connects = 0;
+    for(worker& w : workers){
+        pthread_join(w.tid, nullptr);
+        latency.merge(w.latency);
+        requests += w.requests;
+        bytes += w.bytes;
+        ok += w.status_2xx;
+        other += w.status_other;
+        errors += w.errors;
+        connects += w.connects;
+    }
+    double seconds = (now_ns() - begin) / 1e9;
+
+    // 不限速时每个流水线位置一个接一个地发请求, 预期间隔取平均延迟; 限速时已按计划时间记录
+    if(s_config.rate > 0){
+        for(worker& w : workers) corrected.merge(w.corrected);
+    }else if(requests > 0){
+        int depth = s_config.keep_alive ? s_config.pipeline : 1;
+        uint64_t interval = (uint64_t)(seconds * 1e9 * s_config.connections * depth / requests);
+        for(int i = 0; i < histogram::BUCKETS; i++){
+            for(uint64_t n = 0; n < latency.counts[i]; n++){
+                corrected.record_corrected(histogram::value(i), interval);
+            }
+        }
+        corrected.max = latency.max;
+    }
+
+    printf("  requests   %llu in %.2f s, %.1f req/s, %.2f MB/s\n", (unsigned long long)requests, seconds,
+           requests / seconds, bytes / seconds / (1024 * 1024));
+    printf("  responses  2xx %llu, other %llu, errors %llu, connects %llu\n", (unsigned long long)ok,
+           (unsigned long long)other, (unsigned long long)errors, (unsigned long long)connects);
+    printf("  latency(ms)      p50       p99      p999     p9999       max\n");
+    print_latency("measured", latency);
+    print_latency("corrected", corrected);
+
+    // 包含本工具两次读取 /metrics 的请求, 相对压测的请求数可以忽略
+    server_counters after = scrape(s_config.port);
+    if(before.ok && after.ok && after.responses > before.responses){
+        uint64_t syscalls = after.syscalls - before.syscalls;
+        uint64_t responses = after.responses - before.responses;
+        printf("  server     %llu syscalls, %.2f syscalls/request\n", (unsigned long long)syscalls,
+               (double)syscalls / responses);
+    }
+    return 0;
+}
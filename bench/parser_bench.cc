@@ -0,0 +1,261 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 请求解析基准: 原逐字节 + strpbrk/strncasecmp 解析与 http_scan 解析对比; 各指令集的一致性由 test/http_scan_test.cc 校验
+ * @Date: 2026-10-17 18:20:44
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 18:20:44
+ */
+#include "http_scan.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * 解析结果, 指针以相对请求开头的偏移记录
+ */
+struct parse_result{
+    int requests;               // 解析出的完整请求数
+    bool bad;
+    long url;
+    long version;
+    long host;
+    long content_length;
+    bool linger;
+    long accept_encoding;
+};
+
+/**
+ * 与 http_conn 相同的状态机, 去掉了 socket 与打印, 行与字段的查找方式由 SCAN 决定
+ */
+template<typename SCAN>
+class request_parser{
+public:
+    parse_result parse(char* buf, int len){
+        parse_result r;
+        memset(&r, 0, sizeof(r));
+        int checked = 0;
+        int start = 0;
+        bool request_line = true;
+        r.url = r.version = r.host = r.accept_encoding = -1;
+        while(true){
+            int status = SCAN::line(buf, checked, len);
+            if(status != 1){
+                r.bad = status < 0;
+                return r;
+            }
+            char* text = buf + start;
+            char* end = buf + checked - 2;
+            start = checked;
+            if(request_line){
+                if(!SCAN::request_line(text, end, r)){
+                    r.bad = true;
+                    return r;
+                }
+                request_line = false;
+            }else if(text == end){
+                r.requests++;
+                request_line = true;
+            }else{
+                SCAN::header(text, end, r);
+            }
+        }
+    }
+};
+
+static char* s_base;
+
+/**
+ * 原实现
+ */
+struct scalar_scan{
+    static int line(char* buf, int& checked, int len){
+        while(checked < len){
+            if(buf[checked] == '\r'){
+                if(checked + 1 == len) return 0;
+                if(buf[checked + 1] == '\n'){
+                    buf[checked++] = '\0';
+                    buf[checked++] = '\0';
+                    return 1;
+                }
+                return -1;
+            }
+            checked++;
+        }
+        return 0;
+    }
+
+    static bool request_line(char* text, char*, parse_result& r){
+        char* itr = strpbrk(text, " ");
+        if(!itr) return false;
+        *itr = '\0';
+        if(strcasecmp(text, "GET") != 0) return false;
+        char* url = ++itr;
+        itr = strpbrk(itr, " ");
+        if(!itr) return false;
+        *itr = '\0';
+        char* version = ++itr;
+        if(strcasecmp(version, "HTTP/1.1") != 0) return false;
+        r.linger = true;
+        r.url = url - s_base;
+        r.version = version - s_base;
+        return true;
+    }
+
+    static void header(char* text, char*, parse_result& r){
+        if(strncasecmp(text, "Connection:", 11) == 0){
+            text += 11;
+            text += strspn(text, " ");
+            if(strcasecmp(text, "keep-alive") == 0) r.linger = true;
+            else if(strcasecmp(text, "close") == 0) r.linger = false;
+        }else if(strncasecmp(text, "Content-Length:", 15) == 0){
+            text += 15;
+            text += strspn(text, " ");
+            r.content_length = atol(text);
+        }else if(strncasecmp(text, "Accept-Encoding:", 16) == 0){
+            text += 16;
+            text += strspn(text, " ");
+            r.accept_encoding = text - s_base;
+        }else if(strncasecmp(text, "Host:", 5) == 0){
+            text += 5;
+            text += strspn(text, " ");
+            r.host = text - s_base;
+        }
+    }
+};
+
+/**
+ * http_scan 实现, 与 http_conn::parse_line/parse_request_line/parse_header 相同
+ */
+struct simd_scan{
+    static int line(char* buf, int& checked, int len){
+        while(checked < len){
+            checked = http_scan::find(buf + checked, buf + len, '\r') - buf;
+            if(checked == len) break;
+            if(checked + 1 == len) return 0;
+            if(buf[checked + 1] == '\n'){
+                buf[checked++] = '\0';
+                buf[checked++] = '\0';
+                return 1;
+            }
+            return -1;
+        }
+        return 0;
+    }
+
+    static bool request_line(char* text, char* end, parse_result& r){
+        char* itr = http_scan::find(text, end, ' ');
+        if(itr == end) return false;
+        *itr = '\0';
+        if(strcasecmp(text, "GET") != 0) return false;
+        char* url = ++itr;
+        itr = http_scan::find(itr, end, ' ');
+        if(itr == end) return false;
+        *itr = '\0';
+        char* version = ++itr;
+        if(strcasecmp(version, "HTTP/1.1") != 0) return false;
+        r.linger = true;
+        r.url = url - s_base;
+        r.version = version - s_base;
+        return true;
+    }
+
+    static void header(char* text, char* end, parse_result& r){
+        char* colon = http_scan::find(text, end, ':');
+        HEADER_NAME name = colon == end ? HEADER_UNKNOWN : http_scan::header_name(text, colon - text);
+        if(name == HEADER_UNKNOWN) return;
+        text = colon + 1;
+        text += strspn(text, " ");
+        if(name == HEADER_CONNECTION){
+            if(strcasecmp(text, "keep-alive") == 0) r.linger = true;
+            else if(strcasecmp(text, "close") == 0) r.linger = false;
+        }else if(name == HEADER_CONTENT_LENGTH){
+            r.content_length = atol(text);
+        }else if(name == HEADER_ACCEPT_ENCODING){
+            r.accept_encoding = text - s_base;
+        }else if(name == HEADER_HOST){
+            r.host = text - s_base;
+        }
+    }
+};
+
+// 基准使用的请求; 边界情况的语料在 test/http_scan_test.cc 中
+static const char* CORPUS[] = {
+    // curl
+    "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1:9006\r\nUser-Agent: curl/8.5.0\r\nAccept: */*\r\n\r\n",
+    // 浏览器
+    "GET /images/tmp1.jpg HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"118\", \"Google Chrome\";v=\"118\", \"Not=A?Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/118.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8\r\n"
+    "Sec-Fetch-Site: none\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Cookie: _ga=GA1.1.1234567890.1697500000; session=0123456789abcdef0123456789abcdef; theme=dark\r\n"
+    "\r\n",
+};
+
+template<typename SCAN>
+static parse_result run(const char* request, std::string& copy){
+    copy.assign(request);
+    s_base = &copy[0];
+    request_parser<SCAN> parser;
+    return parser.parse(&copy[0], (int)copy.size());
+}
+
+static inline unsigned long long cycles(){
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+template<typename SCAN>
+static void bench(const char* name, const char* request, long rounds){
+    std::string copy;
+    volatile long sink = 0;
+    unsigned long long c0 = cycles();
+    auto t0 = std::chrono::steady_clock::now();
+    for(long i = 0; i < rounds; i++){
+        parse_result r = run<SCAN>(request, copy);
+        sink = sink + r.host;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    unsigned long long c1 = cycles();
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / rounds;
+    printf("  %-8s %8.1f ns/req %8.0f cycles/req\n", name, ns, (double)(c1 - c0) / rounds);
+}
+
+int main(int argc, char* argv[]){
+    long rounds = argc > 1 ? atol(argv[1]) : 1000000;
+    http_scan::ISA best = http_scan::isa();
+    printf("cpu: %s\n", http_scan::isa_name(best));
+
+    const int samples[] = {0, 1};
+    const char* names[] = {"curl", "browser"};
+    for(int s : samples){
+        printf("%s request (%zu bytes), %ld rounds\n", names[s], strlen(CORPUS[s]), rounds);
+        bench<scalar_scan>("original", CORPUS[s], rounds);
+        for(int isa = http_scan::SCALAR; isa <= best; isa++){
+            http_scan::select((http_scan::ISA)isa);
+            bench<simd_scan>(http_scan::isa_name((http_scan::ISA)isa), CORPUS[s], rounds);
+        }
+    }
+    return 0;
+}
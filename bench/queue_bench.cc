@@ -0,0 +1,115 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 线程池请求队列吞吐测试, 每个线程循环执行 入队 + 出队
+ * @Date: 2026-10-17 11:48:02
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 11:48:02
+ */
+#include "locker.h"
+#include "mpmc_queue.h"
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <vector>
+
+/**
+ * 原 threadpool 使用的队列: std::list + locker + sem
+ */
+class locked_queue{
+public:
+    explicit locked_queue(size_t max_requests) : m_max_requests(max_requests){}
+
+    bool push(int* request){
+        m_queuelocker.lock();
+        if(m_workqueue.size() > m_max_requests){
+            m_queuelocker.unlock();
+            return false;
+        }
+        m_workqueue.push_back(request);
+        m_queuelocker.unlock();
+        m_queuesem.post();
+        return true;
+    }
+
+    bool pop(int*& request){
+        m_queuesem.wait();
+        m_queuelocker.lock();
+        if(m_workqueue.empty()){
+            m_queuelocker.unlock();
+            return false;
+        }
+        request = m_workqueue.front();
+        m_workqueue.pop_front();
+        m_queuelocker.unlock();
+        return true;
+    }
+
+private:
+    size_t m_max_requests;
+    std::list<int*> m_workqueue;
+    locker m_queuelocker;
+    sem m_queuesem;
+};
+
+template<typename Q>
+struct bench_arg{
+    Q* queue;
+    long ops;
+    std::atomic<bool>* go;
+};
+
+template<typename Q>
+void* bench_worker(void* arg){
+    bench_arg<Q>* a = (bench_arg<Q>*) arg;
+    static int item;
+    int* out = nullptr;
+    while(!a->go->load(std::memory_order_acquire)){}
+    for(long i = 0; i < a->ops; i++){
+        // 失败时让出 CPU, 线程数超过核数时避免空转占满时间片
+        while(!a->queue->push(&item)) sched_yield();
+        while(!a->queue->pop(out)) sched_yield();
+    }
+    return nullptr;
+}
+
+/**
+ * @brief 启动 threads 个线程, 每个线程执行 ops 次 入队+出队
+ * @return {double} 每秒完成的 入队+出队 次数
+ */
+template<typename Q>
+double run_bench(Q* queue, int threads, long ops){
+    std::atomic<bool> go(false);
+    std::vector<pthread_t> tids(threads);
+    bench_arg<Q> arg{queue, ops, &go};
+    for(int i = 0; i < threads; i++){
+        pthread_create(&tids[i], nullptr, bench_worker<Q>, &arg);
+    }
+    auto begin = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for(int i = 0; i < threads; i++){
+        pthread_join(tids[i], nullptr);
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return (double)threads * ops / sec;
+}
+
+int main(int argc, char* argv[]){
+    long total_ops = argc > 1 ? atol(argv[1]) : 2000000;
+    const int capacity = 10000;
+
+    printf("%8s %18s %18s %8s\n", "threads", "list+mutex(op/s)", "mpmc_ring(op/s)", "speedup");
+    for(int threads = 1; threads <= 64; threads *= 2){
+        long ops = total_ops / threads;
+        locked_queue before(capacity);
+        mpmc_queue<int*> after(capacity);
+        double b = run_bench(&before, threads, ops);
+        double a = run_bench(&after, threads, ops);
+        printf("%8d %18.0f %18.0f %7.2fx\n", threads, b, a, a / b);
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 静态文件发送路径的 CPU 开销对比: mmap + writev 与 send(MSG_MORE) + sendfile
+ * @Date: 2026-10-17 15:02:44
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 15:02:44
+ */
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+/**
+ * 客户端线程: 只负责把数据读走
+ */
+void* drain(void* arg){
+    int fd = *(int*)arg;
+    static char buf[256 * 1024];
+    while(recv(fd, buf, sizeof(buf), 0) > 0){}
+    return nullptr;
+}
+
+/**
+ * @brief 建立一对回环 TCP 连接
+ * @param {int*} fds fds[0] 为服务端, fds[1] 为客户端
+ */
+bool tcp_pair(int* fds){
+    int listenfd = socket(PF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if(bind(listenfd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenfd, 1) != 0) return false;
+    getsockname(listenfd, (struct sockaddr*)&addr, &len);
+    fds[1] = socket(PF_INET, SOCK_STREAM, 0);
+    if(connect(fds[1], (struct sockaddr*)&addr, sizeof(addr)) != 0) return false;
+    fds[0] = accept(listenfd, nullptr, nullptr);
+    close(listenfd);
+    return fds[0] >= 0;
+}
+
+bool write_all(int fd, const char* data, size_t len, int flags){
+    while(len > 0){
+        ssize_t n = send(fd, data, len, flags);
+        if(n < 0){
+            if(errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+/**
+ * @brief 与 http_conn 的 mmap 路径相同: open + fstat + mmap + writev + munmap
+ */
+bool send_mmap(int sockfd, const char* path, const char* header, size_t header_len){
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    fstat(fd, &st);
+    char* addr = (char*)mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    struct iovec iv[2];
+    iv[0].iov_base = (void*)header;
+    iv[0].iov_len = header_len;
+    iv[1].iov_base = addr;
+    iv[1].iov_len = st.st_size;
+    int count = 2;
+    struct iovec* cur = iv;
+    while(count > 0){
+        ssize_t n = writev(sockfd, cur, count);
+        if(n < 0){
+            munmap(addr, st.st_size);
+            return false;
+        }
+        while(count > 0 && (size_t)n >= cur->iov_len){
+            n -= cur->iov_len;
+            cur++;
+            count--;
+        }
+        if(count > 0){
+            cur->iov_base = (char*)cur->iov_base + n;
+            cur->iov_len -= n;
+        }
+    }
+    munmap(addr, st.st_size);
+    return true;
+}
+
+/**
+ * @brief 与 http_conn 的 sendfile 路径相同: open + fstat + send(MSG_MORE) + sendfile
+ */
+bool send_file(int sockfd, const char* path, const char* header, size_t header_len){
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    fstat(fd, &st);
+    if(!write_all(sockfd, header, header_len, MSG_MORE)){
+        close(fd);
+        return false;
+    }
+    off_t offset = 0;
+    while(offset < st.st_size){
+        if(sendfile(sockfd, fd, &offset, st.st_size - offset) <= 0){
+            close(fd);
+            return false;
+        }
+    }
+    close(fd);
+    return true;
+}
+
+double thread_cpu_us(){
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+double wall_us(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+typedef bool (*send_func)(int, const char*, const char*, size_t);
+
+void run(const char* name, send_func func, const char* path, int requests){
+    int fds[2];
+    if(!tcp_pair(fds)){
+        printf("create tcp pair failed\n");
+        exit(1);
+    }
+    pthread_t tid;
+    pthread_create(&tid, nullptr, drain, &fds[1]);
+
+    const char header[] = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nContent-Type: image/jpeg\r\nConnection: keep-alive\r\n\r\n";
+    double cpu = thread_cpu_us();
+    double wall = wall_us();
+    for(int i = 0; i < requests; i++){
+        if(!func(fds[0], path, header, sizeof(header) - 1)){
+            printf("%s: send failed, errno %d\n", name, errno);
+            break;
+        }
+    }
+    cpu = thread_cpu_us() - cpu;
+    wall = wall_us() - wall;
+    shutdown(fds[0], SHUT_WR);
+    pthread_join(tid, nullptr);
+    close(fds[0]);
+    close(fds[1]);
+    printf("%-10s %12.2f %12.2f\n", name, cpu / requests, wall / requests);
+}
+
+int main(int argc, char* argv[]){
+    const char* path = argc > 1 ? argv[1] : "resources/images/tmp1.jpg";
+    int requests = argc > 2 ? atoi(argv[2]) : 20000;
+    struct stat st;
+    if(stat(path, &st) != 0){
+        printf("usage: %s {file} [requests]\n", argv[0]);
+        return 1;
+    }
+    printf("file: %s (%ld bytes), requests: %d\n", path, (long)st.st_size, requests);
+    printf("%-10s %12s %12s\n", "path", "cpu(us/req)", "wall(us/req)");
+    run("mmap", send_mmap, path, requests);
+    run("sendfile", send_file, path, requests);
+    return 0;
+}
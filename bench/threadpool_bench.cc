@@ -0,0 +1,74 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 线程池调度方式对比: 共享队列 vs work stealing
+ * @Date: 2026-10-17 13:05:19
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 13:05:19
+ */
+#include "threadpool.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sched.h>
+
+/**
+ * 模拟一个连接: 每次 process() 都要读写一遍自己的状态,
+ * 状态仍在上次处理它的核的 cache 中时更快
+ */
+struct bench_conn{
+    static const int STATE_SIZE = 16 * 1024;
+    static std::atomic<long> done;
+
+    int id;
+    unsigned char state[STATE_SIZE];
+
+    int affinity() const{ return id; }
+
+    void process(){
+        unsigned sum = 0;
+        for(int i = 0; i < STATE_SIZE; i += 8){
+            sum += state[i];
+            state[i] = (unsigned char)(sum + i);
+        }
+        done.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+std::atomic<long> bench_conn::done(0);
+
+/**
+ * @brief 由一个"reactor"线程(本线程)轮流为 conns 个连接提交 total 个请求
+ * @return {double} 每秒处理的请求数
+ */
+double run_bench(POOL_MODE mode, int threads, int conns, long total){
+    bench_conn* users = new bench_conn[conns];
+    memset(users, 0, sizeof(bench_conn) * conns);
+    for(int i = 0; i < conns; i++) users[i].id = i;
+    threadpool<bench_conn>* pool = new threadpool<bench_conn>(threads, 10000, mode);
+    bench_conn::done.store(0);
+
+    auto begin = std::chrono::steady_clock::now();
+    for(long i = 0; i < total; i++){
+        while(!pool->append(users + i % conns)) sched_yield();
+    }
+    while(bench_conn::done.load(std::memory_order_relaxed) < total) sched_yield();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    // worker 为 detach 线程, 不释放 pool 与 users
+    return total / sec;
+}
+
+int main(int argc, char* argv[]){
+    long total = argc > 1 ? atol(argv[1]) : 200000;
+    int conns = argc > 2 ? atoi(argv[2]) : 256;
+
+    printf("%8s %18s %18s %8s\n", "threads", "shared(req/s)", "stealing(req/s)", "ratio");
+    for(int threads = 1; threads <= 16; threads *= 2){
+        double shared = run_bench(SHARED_QUEUE, threads, conns, total);
+        double stealing = run_bench(WORK_STEALING, threads, conns, total);
+        printf("%8d %18.0f %18.0f %7.2fx\n", threads, shared, stealing, stealing / shared);
+    }
+    return 0;
+}
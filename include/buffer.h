@@ -0,0 +1,82 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 可增长的连接缓冲区, 小数据使用内联空间, 超出时在堆上按倍数增长
+ * @Date: 2026-10-17 17:12:05
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 17:12:05
+ */
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * 连接的读/写缓冲区
+ *  - 容量从 INLINE_SIZE 开始, 按 2 倍增长, 最大为 init() 时指定的 max_size
+ *  - 复用时不清零, 已使用的长度由调用者(http_conn 的各个下标)记录
+ *  - 连接空闲时 shrink() 把数据移回内联空间并释放堆内存
+ * 解析器需要连续的内存, 因此这里不做环绕, 已处理的数据由调用者移到开头(见 http_conn::compact_read_buf)
+ * 构造函数不做任何初始化, 分配连接对象时不触碰内联空间所在的页面, 使用前必须调用 init()
+ */
+template<size_t INLINE_SIZE>
+class buffer{
+public:
+    void init(size_t max_size){
+        m_data = m_inline;
+        m_capacity = INLINE_SIZE;
+        m_max_size = max_size > INLINE_SIZE ? max_size : INLINE_SIZE;
+    }
+
+    char* data(){ return m_data; }
+    const char* data() const { return m_data; }
+    size_t capacity() const { return m_capacity; }
+    size_t max_size() const { return m_max_size; }
+
+    /**
+     * @brief 保证容量至少为 need, 前 used 字节保持不变
+     * @return {bool} 超过上限时返回 false
+     */
+    bool reserve(size_t used, size_t need){
+        if(need <= m_capacity) return true;
+        if(need > m_max_size) return false;
+        size_t capacity = m_capacity;
+        while(capacity < need) capacity *= 2;
+        if(capacity > m_max_size) capacity = m_max_size;
+        char* data = (char*)malloc(capacity);
+        if(!data) return false;
+        memcpy(data, m_data, used);
+        if(m_data != m_inline) free(m_data);
+        m_data = data;
+        m_capacity = capacity;
+        return true;
+    }
+
+    /**
+     * @brief 数据能放入内联空间时释放堆内存
+     * @param {size_t} used 当前数据长度
+     */
+    void shrink(size_t used){
+        if(m_data == m_inline || used > INLINE_SIZE) return;
+        memcpy(m_inline, m_data, used);
+        free(m_data);
+        m_data = m_inline;
+        m_capacity = INLINE_SIZE;
+    }
+
+    void release(){
+        if(m_data != m_inline) free(m_data);
+        m_data = m_inline;
+        m_capacity = INLINE_SIZE;
+    }
+
+private:
+    char* m_data;
+    size_t m_capacity;
+    size_t m_max_size;
+    char m_inline[INLINE_SIZE];
+};
+
+#endif // BUFFER_H
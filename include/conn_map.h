@@ -0,0 +1,70 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 描述符到连接对象的映射
+ * @Date: 2026-10-17 23:05:40
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 23:05:40
+ */
+#ifndef CONN_MAP_H
+#define CONN_MAP_H
+
+#include <cstdlib>
+
+class http_conn;
+
+/**
+ * 两级表: 第一级按 fd 的高位分页, 每页 PAGE_SIZE 个指针, 页在第一次插入时分配
+ * 描述符由内核从小到大复用, 实际只会分配少数几页; 页不回收, 最多 max_fd / PAGE_SIZE 页
+ * 非线程安全, 每个 eventloop 一个, 只记录自己 accept 的连接
+ */
+class conn_map{
+public:
+    explicit conn_map(int max_fd)
+            : m_max_fd(max_fd), m_pages((http_conn***)calloc((max_fd + PAGE_SIZE - 1) / PAGE_SIZE, sizeof(http_conn**))){
+    }
+
+    ~conn_map(){
+        for(int i = 0; i < (m_max_fd + PAGE_SIZE - 1) / PAGE_SIZE; i++) free(m_pages[i]);
+        free(m_pages);
+    }
+
+    conn_map(const conn_map&) = delete;
+    conn_map& operator=(const conn_map&) = delete;
+
+    http_conn* find(int fd) const{
+        if((unsigned)fd >= (unsigned)m_max_fd) return nullptr;
+        http_conn** page = m_pages[fd >> PAGE_BITS];
+        return page ? page[fd & (PAGE_SIZE - 1)] : nullptr;
+    }
+
+    /**
+     * @brief 记录 fd 对应的连接
+     * @return {bool} fd 超出范围或内存不足时返回 false
+     */
+    bool insert(int fd, http_conn* conn){
+        if(!m_pages || (unsigned)fd >= (unsigned)m_max_fd) return false;
+        http_conn**& page = m_pages[fd >> PAGE_BITS];
+        if(!page){
+            page = (http_conn**)calloc(PAGE_SIZE, sizeof(http_conn*));
+            if(!page) return false;
+        }
+        page[fd & (PAGE_SIZE - 1)] = conn;
+        return true;
+    }
+
+    void erase(int fd){
+        if((unsigned)fd >= (unsigned)m_max_fd) return;
+        http_conn** page = m_pages[fd >> PAGE_BITS];
+        if(page) page[fd & (PAGE_SIZE - 1)] = nullptr;
+    }
+
+private:
+    static const int PAGE_BITS = 10;
+    static const int PAGE_SIZE = 1 << PAGE_BITS;
+
+    int m_max_fd;
+    http_conn*** m_pages;
+};
+
+#endif // CONN_MAP_H
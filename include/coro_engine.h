@@ -0,0 +1,79 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 协程事件引擎: epoll 边沿触发, 每个连接一个 C++20 协程, 在 reactor 线程中接收、处理、发送
+ * @Date: 2026-10-17 23:48:12
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 23:48:12
+ */
+#ifndef CORO_ENGINE_H
+#define CORO_ENGINE_H
+
+#ifdef NK_COROUTINE
+
+#include "epoll_engine.h"
+#include "http_conn.h"
+#include <coroutine>
+#include <exception>
+#include <vector>
+
+/**
+ * 连接的整个生命周期写成一个顺序执行的协程(serve), 不再拆成 reactor 读 -> 线程池处理 -> reactor 写三段:
+ *  - 连接以 EPOLLIN | EPOLLOUT | EPOLLET 注册一次, 之后不再 epoll_ctl 修改
+ *  - recv/sendmsg/sendfile 是可等待的操作: 先直接调用, EAGAIN 时挂起协程, 对应方向的边沿到达后恢复重试
+ *  - 请求在 reactor 线程中直接解析并生成响应, 没有线程池的入队、唤醒与交还
+ * 适合处理开销小的静态文件请求; 慢请求(如首次 gzip 压缩)会阻塞同一 reactor 上的其他连接.
+ * 与 http_conn::write() 一样, 一轮最多发送 SEND_WINDOW 字节, 之后协程让出, 本轮其他事件处理完后再继续
+ *
+ * 协程只在等待 I/O 时挂起, 超时关闭连接时直接销毁挂起的协程帧;
+ * 协程出错或对端关闭时结束并停在 final_suspend, 由恢复它的引擎关闭连接, 协程不会销毁正在执行的自己
+ */
+class coro_engine : public epoll_engine{
+public:
+    explicit coro_engine(eventloop* loop);
+    ~coro_engine();
+
+    bool init(int listenfd, bool shared) override;
+    void add(http_conn* conn) override;
+    void close(http_conn* conn) override;
+    void resume(http_conn* conn) override;
+    int wait(int timeout_ms) override;
+    void handle_events() override;
+
+private:
+    // 连接的协程, 创建后挂起, 第一次事件到达时开始执行; 结束后停在 final_suspend 等待销毁
+    struct task{
+        struct promise_type{
+            task get_return_object(){ return task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+            std::suspend_always initial_suspend() noexcept{ return {}; }
+            std::suspend_always final_suspend() noexcept{ return {}; }
+            void return_void(){}
+            void unhandled_exception(){ std::terminate(); }
+        };
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    // 连接在引擎中的状态, 以 fd 为下标
+    struct conn_state{
+        std::coroutine_handle<task::promise_type> coro;     // 连接的协程, 连接关闭时销毁
+        std::coroutine_handle<> waiter;             // 挂起等待 I/O 的协程, 为空表示正在执行或已结束
+        unsigned events;                            // 等待的事件, EPOLLIN 或 EPOLLOUT; 0 表示主动让出, 在 m_ready 中
+    };
+
+    template<typename OP> struct io_awaitable;
+    template<typename OP> static io_awaitable<OP> make_io(conn_state& st, unsigned events, OP op);
+    struct yield_awaitable;
+
+    task serve(http_conn* conn);
+    void run(http_conn* conn, conn_state& st);      // 恢复协程, 协程结束时关闭连接
+    void run_ready();                               // 恢复上一轮让出的协程
+
+private:
+    conn_state* m_states;
+    std::vector<int> m_ready;                       // 用完发送窗口而让出的连接
+    std::vector<int> m_running;                     // run_ready() 正在恢复的一批
+};
+
+#endif // NK_COROUTINE
+
+#endif // CORO_ENGINE_H
@@ -0,0 +1,40 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: epoll 事件引擎: EPOLLONESHOT 就绪通知, 由 http_conn::read()/write() 完成非阻塞读写
+ * @Date: 2026-10-17 22:31:05
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 22:31:05
+ */
+#ifndef EPOLL_ENGINE_H
+#define EPOLL_ENGINE_H
+
+#include "event_engine.h"
+#include <sys/epoll.h>
+
+#define MAX_EVENT_NUMBER 10000      // 监听的最大数量
+
+class epoll_engine : public event_engine{
+public:
+    explicit epoll_engine(eventloop* loop);
+    ~epoll_engine();
+
+    bool init(int listenfd, bool shared) override;
+    void add(http_conn* conn) override;
+    void close(http_conn* conn) override;
+    void resume(http_conn* conn) override;
+    int wait(int timeout_ms) override;
+    void handle_events() override;
+
+protected:
+    void handle_accept();
+    void handle_write(http_conn* conn);
+
+protected:
+    int m_epollfd;
+    int m_listenfd;
+    int m_event_number;                         // 上次 wait() 得到的事件数
+    epoll_event m_events[MAX_EVENT_NUMBER];
+};
+
+#endif // EPOLL_ENGINE_H
@@ -0,0 +1,50 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 事件引擎接口: eventloop 的 I/O 部分, epoll(就绪通知)、io_uring(完成通知)与 epoll 上的协程三种实现
+ * @Date: 2026-10-17 22:31:05
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 22:31:05
+ */
+#ifndef EVENT_ENGINE_H
+#define EVENT_ENGINE_H
+
+class eventloop;
+class http_conn;
+
+enum ENGINE_TYPE{
+    ENGINE_EPOLL = 0,                           // epoll + recv/sendmsg/sendfile, 默认
+    ENGINE_URING,                               // io_uring: multishot accept/recv, 批量提交发送
+    ENGINE_CORO                                 // epoll 边沿触发 + 每个连接一个协程, 请求在 reactor 线程中处理, 需要 NK_COROUTINE
+};
+
+/**
+ * 每个 eventloop 一个引擎, 除 resume() 外都只在所属 eventloop 线程中调用
+ * 引擎负责连接上的所有 I/O, 通过 eventloop 的 add_conn/dispatch/close_conn/refresh_timer 回到公共逻辑:
+ *  - 新连接: add_conn(), 之后 eventloop 调用 add()
+ *  - 收到请求数据: dispatch() 交给线程池
+ *  - 线程池处理完: 工作线程调用 resume(), 引擎发送响应或继续接收
+ *  - 出错或对端关闭: close_conn(), 之后 eventloop 调用 close()
+ * 协程引擎不使用线程池: 连接的协程在 reactor 线程中依次接收、处理、发送, 不调用 dispatch()/resume()
+ */
+class event_engine{
+public:
+    static event_engine* create(ENGINE_TYPE type, eventloop* loop);
+    static const char* name(ENGINE_TYPE type);
+
+    virtual ~event_engine(){}
+
+    virtual bool init(int listenfd, bool shared) = 0;  // 开始接受 listenfd 上的连接, shared 表示与其他引擎共享
+    virtual void add(http_conn* conn) = 0;      // 新连接开始接收请求
+    virtual void close(http_conn* conn) = 0;    // 关闭连接, 连接上仍有未完成的操作时推迟到操作结束
+    virtual void resume(http_conn* conn) = 0;   // 线程池处理完成, 在工作线程中调用
+    virtual int wait(int timeout_ms) = 0;       // 等待事件, 返回事件数, 失败返回 -1
+    virtual void handle_events() = 0;           // 处理 wait() 得到的事件
+
+protected:
+    explicit event_engine(eventloop* loop) : m_loop(loop){}
+
+    eventloop* m_loop;
+};
+
+#endif // EVENT_ENGINE_H
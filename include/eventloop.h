@@ -0,0 +1,90 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: Reactor 事件循环，每个循环拥有独立的监听 socket 与 epoll
+ * @Date: 2026-10-17 10:02:11
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 10:02:11
+ */
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include "threadpool.h"
+#include "http_conn.h"
+#include "timer_wheel.h"
+#include "event_engine.h"
+#include "slab_pool.h"
+#include "conn_map.h"
+#include <pthread.h>
+
+#define MAX_FD 65535                // 最大描述符个数, 即最大服务客户端数量
+#define TIMER_TICK_MS 100           // 时间轮精度
+#define DEFAULT_BACKLOG 1024        // 监听队列长度, 实际不超过 net.core.somaxconn
+
+// 默认超时时间(ms), 依次对应 http_conn::TIMEOUT_TYPE
+#define DEFAULT_IDLE_TIMEOUT 60000
+#define DEFAULT_HEADER_TIMEOUT 10000
+#define DEFAULT_BODY_TIMEOUT 30000
+#define DEFAULT_WRITE_TIMEOUT 30000
+
+/**
+ * 一个 eventloop 对应一个 reactor:
+ *  - 监听 socket: 多 reactor 时默认各自一个(SO_REUSEPORT, 由内核按四元组哈希分发连接),
+ *    也可以共享同一个, 以 EPOLLEXCLUSIVE 注册, 每个新连接只唤醒一个 reactor
+ *  - 独立的事件引擎(epoll 或 io_uring), 负责连接上的 I/O
+ *  - 只处理自己 accept 的连接, 连接对象从自己的 slab_pool 分配, 由自己的 conn_map 按 fd 查找
+ *  - 独立的时间轮, 由 epoll_wait 的超时时间驱动, 关闭超时的连接
+ * 连接的业务处理仍然交给共享的线程池; 协程引擎例外, 请求直接在本循环的线程中处理
+ */
+class eventloop{
+public:
+    /**
+     * @param {int} listenfd 监听 socket, 见 open_listener()
+     * @param {bool} shared 监听 socket 是否与其他循环共享, 共享时由调用者关闭
+     * @param {threadpool<http_conn>*} pool 线程池
+     * @param {int*} timeouts 各阶段超时时间(ms), 下标为 http_conn::TIMEOUT_TYPE, <= 0 表示不超时
+     * @param {ENGINE_TYPE} engine 事件引擎
+     */
+    eventloop(int listenfd, bool shared, threadpool<http_conn>* pool, const int* timeouts,
+              ENGINE_TYPE engine = ENGINE_EPOLL);
+    ~eventloop();
+
+    static int open_listener(int port, int backlog, bool reuse_port);  // 创建非阻塞的监听 socket, 失败返回 -1
+    bool init();                                // 创建事件引擎
+    void loop();                                // 事件循环, 阻塞运行
+    bool start();                               // 在新线程中运行 loop()
+    void join();                                // 等待线程结束
+    size_t conn_bytes() const{ return m_conns.bytes(); }   // 连接对象占用的内存, 可在其他线程中读取
+
+    friend class epoll_engine;
+    friend class uring_engine;
+    friend class coro_engine;
+
+private:
+    static void* worker(void* arg);
+    void add_conn(int connfd, const sockaddr_in& addr);    // 引擎接受了新连接
+    bool dispatch(http_conn* conn);             // 交给线程池处理, 队列满时关闭连接并返回 false
+    void close_conn(http_conn* conn);           // 移除定时器并关闭连接
+    http_conn* find_conn(int fd) const{ return m_fds.find(fd); }
+    void free_conn(http_conn* conn);            // 引擎关闭连接的最后一步: 释放资源并归还连接对象
+    void refresh_timer(http_conn* conn);        // 根据连接所处阶段重置定时器
+    void arm_timer(http_conn* conn, http_conn::TIMEOUT_TYPE type);
+    void handle_timeout();
+    static uint64_t now_ms();
+
+private:
+    int m_listenfd;
+    bool m_shared;                              // 监听 socket 由多个循环共享
+    ENGINE_TYPE m_engine_type;
+    event_engine* m_engine;
+    slab_pool<http_conn> m_conns;               // 本循环的连接对象
+    conn_map m_fds;                             // fd 到连接对象
+    threadpool<http_conn>* m_pool;
+    pthread_t m_thread;
+    bool m_started;
+    int m_timeouts[http_conn::TIMEOUT_NUMBER];
+    timer_wheel m_timers;
+    locker m_timeout_lock;                      // 超时关闭与 epoll_engine::resume() 互斥, 避免 fd 在重新注册事件前被复用
+};
+
+#endif // EVENTLOOP_H
@@ -0,0 +1,112 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 静态文件缓存: 缓存 stat 结果、打开的描述符/内存映射与预先生成的响应头, inotify 失效
+ * @Date: 2026-10-17 15:40:12
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 15:40:12
+ */
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include "locker.h"
+#include <pthread.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * 文件的预压缩版本, 与原文件一样可以用 sendfile(fd) 或 writev(address) 发送
+ */
+struct file_variant{
+    int fd;                         // memfd, 映射模式下为 -1
+    char* address;                  // 映射模式下的内容, 否则为 nullptr
+    off_t size;
+    std::string headers;            // 含 Content-Encoding 与 Vary 的响应头
+    std::string validators;         // 304 响应使用的 ETag 等头部, ETag 与原文件不同
+};
+
+/**
+ * 一个已打开的文件, 引用计数为 0 时关闭描述符并解除映射
+ * 缓存本身持有一个引用, 每个正在发送它的连接各持有一个引用,
+ * 因此被淘汰或失效的条目在发送结束前仍然有效
+ */
+struct file_entry{
+    std::string path;               // 完整路径, 缓存的 key
+    struct stat st;                 // 打开后 fstat 的结果
+    int fd;                         // sendfile 使用的描述符, 映射模式下为 -1
+    char* address;                  // 映射模式下的文件内容, 否则为 nullptr
+    std::string mime;               // Content-Type
+    std::string headers;            // 预先生成的 Content-Length、Content-Type 与 validators
+    std::string validators;         // ETag、Last-Modified、Cache-Control 与 Vary, 304 响应只发送这些
+    std::atomic<int> refcount;
+
+    bool compressible;              // 文本类文件, 可以提供 gzip 版本
+    bool cached;                    // 是否在缓存中, 只为缓存中的文件生成 gzip 版本
+    std::once_flag gzip_once;
+    file_variant* gzip;             // gzip 版本, 未生成或压缩后不更小时为 nullptr
+};
+
+class file_cache{
+public:
+    static const int MAX_ETAG_LEN = 64;                     // format_etag 输出的最大长度
+    static int m_max_age;                                   // Cache-Control 的 max-age, 0 时为 no-cache
+
+    /**
+     * @param {size_t} max_entries 最多缓存的文件数
+     * @param {size_t} max_bytes 最多缓存的文件总大小
+     * @param {bool} map_files true 时映射文件内容(mmap + writev 发送), 否则保留描述符(sendfile 发送)
+     */
+    file_cache(size_t max_entries, size_t max_bytes, bool map_files);
+    ~file_cache();
+
+    bool watch(const char* root);                               // 用 inotify 监听 root 下所有目录
+    file_entry* acquire(const char* path, int& err);            // 查找或打开文件, 失败返回 nullptr, err 为 errno
+    void invalidate(const std::string& path);
+    void clear();
+
+    static file_entry* load(const char* path, bool map_file, int& err);    // 打开文件, 不经过缓存
+    static void release(file_entry* entry);
+    static const char* content_type(const char* path);
+    static const file_variant* gzip_variant(file_entry* entry);           // 获取 gzip 版本, 首次调用时生成
+    static char* format_etag(char* out, const struct stat& st);           // 原文件的强 ETag(含引号), 不写 '\0'
+    static std::string validators(const struct stat& st, const char* mime, bool gzip);
+
+private:
+    static const int SHARD_NUMBER = 16;
+    static const off_t MAX_GZIP_SIZE = 8 * 1024 * 1024;     // 超过该大小的文件不压缩
+
+    struct shard{
+        locker mutex;
+        std::list<file_entry*> lru;                 // 队头为最近使用
+        std::unordered_map<std::string, std::list<file_entry*>::iterator> index;
+        size_t bytes;
+        unsigned long generation;                   // 每次失效加一, 避免插入加载期间已失效的旧文件
+    };
+
+    shard& shard_of(const std::string& path);
+    file_entry* insert(const std::string& key, file_entry* entry, unsigned long generation);
+    void evict(shard& s);                           // 调用时持有 s.mutex
+    static bool compressible(const char* mime);
+    static file_variant* compress(file_entry* entry);
+    static void* watcher(void* arg);
+    void watch_loop();
+    bool add_watch(const std::string& dir);
+
+private:
+    size_t m_max_entries;                           // 每个分片的上限
+    size_t m_max_bytes;
+    bool m_map_files;
+    shard m_shards[SHARD_NUMBER];
+
+    int m_inotifyfd;
+    pthread_t m_watcher;
+    std::unordered_map<int, std::string> m_watch_dirs;     // wd -> 目录, 只由 watcher 线程修改
+
+    friend struct file_cache_probe;                         // 测试检查分片内容, 模拟加载期间失效
+};
+
+#endif // FILE_CACHE_H
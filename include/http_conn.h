@@ -6,6 +6,16 @@
 #define HTTP_COND_H
 
 #include "locker.h"
+#include "timer_wheel.h"
+#include "file_cache.h"
+#include "buffer.h"
+#include "http_scan.h"
+#include "http_headers.h"
+#include "http_response.h"
+#include "log.h"
+#include "metrics.h"
+#include "event_engine.h"
+#include "router.h"
 #include <iostream>
 #include <unistd.h>
 #include <csignal>
@@ -25,14 +35,35 @@
 #include <cstdarg>
 #include <cerrno>
 #include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <atomic>
+#include <limits>
+
+extern const char* DOC_ROOT;                     // 静态文件根目录, 启动时由 -r 指定
+
+#define UPLOAD_URL "/upload"                     // 内置路由, 接收 POST/PUT 请求体并返回收到的字节数
+#define HEALTH_URL "/healthz"                    // 内置路由, 存活检查
 
 class http_conn{
 public:
-    static int m_epollfd;                       // 用一个 epoll 管理 socket
-    static int m_usercount;                     // 用户数量
-    static const int READ_BUFFER_SIZE = 2048;
-    static const int WRITE_BUFFER_SIZE = 1024;
+    static std::atomic<int> m_usercount;        // 用户数量, 多个 reactor 线程共同修改
+    static bool m_use_sendfile;                 // 文件使用 sendfile 零拷贝发送, false 时使用 mmap + writev
+    static file_cache* m_file_cache;            // 静态文件缓存, nullptr 时每次请求都打开文件
+    static const int READ_BUFFER_SIZE = 1024;   // 读缓冲区内联大小, 更大的请求头在堆上增长
+    static const int WRITE_BUFFER_SIZE = 512;   // 写缓冲区内联大小
+    static int m_read_buffer_max;               // 读缓冲区上限, 即请求头(含流水线中未处理的请求)最大长度
+    static int m_write_buffer_max;              // 写缓冲区上限
     static const int FILENAME_LEN = 200;        // 文件名最大长度
+    static const int MAX_PIPELINE = 16;         // 一次最多处理的流水线请求数
+    static const int PIPELINE_RESERVE = 512;    // 写缓冲区剩余空间不足时不再解析下一个流水线请求
+    static const int MAX_RANGES = 8;            // Range 最多的范围数, 超过时忽略 Range 返回整个文件
+    static constexpr off_t SEND_WINDOW = 1024 * 1024;   // 一轮发送(一次 write() 或一个 sendmsg)最多发送的字节数
+    static const int SPLICE_CHUNK = 64 * 1024;  // 请求体一次 splice 的最大字节数, 即管道默认容量
+
+    static long m_max_body;                     // 请求体上限, 超过时返回 413
+    static long m_spill_threshold;              // 没有 route::body 的路由, 超过该长度的请求体写入临时文件
+    static long m_body_chunk;                   // 交给 route::body 的每块长度, 不超过读缓冲区中头部之后的空间
+    static const char* m_spill_dir;             // 临时文件所在目录
 
     enum METHOD{
         GET = 0,
@@ -64,72 +95,186 @@ public:
         NO_RESOURCE,
         FORBIDDEN_REQUEST,
         FILE_REQUEST,
+        HANDLER_REQUEST,                        // 命中路由, 由处理函数生成响应
+        PARTIAL_REQUEST,                        // 文件的部分内容(Range)
+        RANGE_NOT_SATISFIABLE,                  // Range 中没有可满足的范围
+        NOT_MODIFIED,                           // 条件请求的验证器与文件一致
+        METHOD_NOT_ALLOWED,                     // 路由不接受该方法, 或对静态文件使用了 GET 以外的方法
+        LENGTH_REQUIRED,                        // 请求体没有 Content-Length(不支持 chunked)
+        PAYLOAD_TOO_LARGE,                      // 请求体超过 m_max_body
+        HEADER_TOO_LARGE,                       // 请求行与头部填满了读缓冲区上限, 或头部数超过 MAX_HEADERS
         INTERNAL_ERROR,
         CLOSED_CONNECTION
     };
 
+    // 连接超时类型, 由 eventloop 根据连接所处阶段选择
+    enum TIMEOUT_TYPE{
+        TIMEOUT_IDLE = 0,                       // keep-alive 空闲, 等待下一个请求
+        TIMEOUT_HEADER,                         // 读取请求行与头部
+        TIMEOUT_BODY,                           // 读取请求体
+        TIMEOUT_WRITE,                          // 发送响应, 每次有进展时重置
+        TIMEOUT_NUMBER
+    };
+
     http_conn(){}
     ~http_conn(){}
 
-    void init(int sockfd, const sockaddr_in &addr); // 初始化连接
+    void init(int sockfd, const sockaddr_in &addr, event_engine* engine); // 初始化连接
     void close_conn();                                   // 关闭连接
     void process();                                 // 处理 client 请求
     bool read();                                    // 非阻塞读
-    bool write();                                   // 非阻塞写
+    bool write();                                   // 非阻塞写, epoll 引擎使用
+    TIMEOUT_TYPE timeout_type() const;              // 当前阶段对应的超时类型
+    bool has_pending_request() const;               // 响应已发完, 读缓冲区中还有未处理的流水线请求
+    int affinity() const{ return m_sockfd; }        // 线程池窃取模式按连接 fd 选择 worker
+    bool body_streaming() const;                    // 请求体正在直接写入临时文件, 读缓冲区中没有未处理的部分
+    ssize_t splice_body();                          // 从 socket 经管道 splice 一段请求体到临时文件
+    const header_table& headers() const{ return m_headers; }    // 当前请求的全部头部
+
+    /* 当前请求, 供路由的处理函数读取 */
+    METHOD method() const{ return m_method; }
+    const char* path() const{ return m_url; }                   // 不含查询串
+    const char* query() const{ return m_query; }                // '?' 之后的部分, 没有时为 nullptr
+    long body_length() const{ return m_body_received; }
+    const char* body() const;                       // 留在读缓冲区中的请求体, 写入临时文件或交给 route::body 时为 nullptr
+    int body_fd() const{ return m_body_fd; }        // 请求体临时文件, 没有时为 -1
+
+    friend class eventloop;
+    friend class epoll_engine;
+    friend class uring_engine;
+    friend class coro_engine;
+    friend struct http_conn_probe;                  // 测试与基准程序直接调用解析、生成响应等内部步骤
 
 private:
+    // 一个已生成、等待发送的响应, 流水线请求的响应按请求顺序排队
+    struct response{
+        int header_offset;                          // 响应头(错误响应含页面内容)在写缓冲区中的位置
+        int header_len;
+        file_entry* file;                           // 文件实体, 持有一个引用, 可为 nullptr
+        char* body_address;                         // 内存中的实体
+        int body_fd;                                // sendfile 发送的实体, 不为 -1 时忽略 body_address
+        off_t body_offset;                          // sendfile 发送的实体在文件中的起始位置
+        off_t body_size;
+        bool close;                                 // 发送完成后关闭连接
+        bool part;                                  // 多段范围响应中除最后一项外的部分, 不单独统计
+        uint64_t ready_ns;                          // 生成响应的时间, 用于统计发送耗时
+    };
+
+    // 下一次发送的内容: 一组内存数据, 或 sendfile 发送的文件实体
+    struct send_op{
+        struct iovec iov[MAX_PIPELINE * 2];
+        int iov_count;
+        bool more;                                  // 之后是 sendfile 的文件实体, 用 MSG_MORE 合并
+        int file_fd;                                // 不为 -1 时发送文件实体, 忽略 iov
+        off_t file_offset;
+        off_t file_len;
+    };
+
+    // Range 中的一个范围, 闭区间, 已限制在文件长度内
+    struct byte_range{
+        off_t first;
+        off_t last;
+    };
+
 // public: // 测试临时改一下
     void init();                                    // 初始化其他信息
+    void init_request();                            // 开始解析下一个请求
 
+    bool process_requests();                        // 解析读缓冲区中的完整请求并生成响应, false 表示需要关闭连接
+    bool reserve_read();                            // 读缓冲区已满时腾出空间, 已达上限时返回 false
+    bool header_too_large() const;                  // 请求头超过读缓冲区上限, 返回 431
     HTTP_CODE process_read();                       // 解析请求
-    HTTP_CODE parse_request_line(char* text);       // 解析第一行
-    HTTP_CODE parse_header(char* text);             // 解析头部
+    HTTP_CODE parse_request_line(char* text, char* end);   // 解析第一行, end 为行尾('\0' 处)
+    HTTP_CODE parse_header(char* text, char* end);         // 解析头部
     HTTP_CODE parse_content(char* text);            // 解析body
+    HTTP_CODE start_body();                         // 头部解析完, 检查请求体长度并选择接收方式
+    void close_body();                              // 关闭请求体的临时文件与管道
+    route_body_handler body_handler() const{        // 当前路由的请求体处理函数, 没有时为 nullptr
+        return m_route ? m_route->body : nullptr;
+    }
     LINE_STATUS parse_line();                       // 解析单独一行
     char* getline(){                         // 获取当前正在解析行的起始地址
-        return m_read_buf + m_start_line;
+        return m_read_buf.data() + m_start_line;
     }
     HTTP_CODE do_request();                         // 发送 request
+    bool if_range_matches() const;                  // 没有 If-Range 或其验证器与文件一致
+    bool not_modified(bool* gzip_tag) const;        // If-None-Match / If-Modified-Since 与 m_file_stat 一致
+    static int parse_ranges(const char* value, off_t size, byte_range* ranges, int max);
 
 
-    bool process_write(HTTP_CODE ret);              //填充HTTP应答
+    bool process_write(HTTP_CODE ret);              //填充HTTP应答, 加入响应队列
+    response& start_response();                     // 在响应队列末尾开始一个新响应
+    void set_slice(response& r, off_t first, off_t len);   // 响应实体为当前文件的一段
+    bool advance(ssize_t len);                      // 记录已发送的字节, 返回 false 表示需要关闭连接
+    bool prepare_send(send_op& op);                 // 从发送进度开始的下一段数据, 已发完返回 false
+    void finish_write();                            // 响应队列发送完成
+    void release();                                 // 释放文件与缓冲区, 不关闭描述符
+    void clear_responses();
+    void compact_read_buf();                        // 丢弃已处理完的请求, 为后续数据腾出空间
+    bool grow_read_buf();                           // 扩大读缓冲区, 已解析出的指针随之移动
     void unmap();
     bool add_response(const char* format, ...);
-    bool add_content(const char* content);
+    bool add_raw(const char* data, size_t len);
+    bool add_status_line(int status);
+    bool add_date();
+    bool add_content_length(off_t content_length);
     bool add_content_type();
-    bool add_status_line(int status, const char* title);
-    bool add_headers(int content_length);
-    bool add_content_length(int content_length);
+    bool add_content_range(off_t first, off_t last, off_t size);
+    bool add_multipart();                           // multipart/byteranges 的实体, 每段占用响应队列中的一项
     bool add_linger();
     bool add_blank_line();
+    bool add_error(int status);                     // 完整的错误响应, 除 Date 外都是预先生成的
 // private:
+    /*
+     * 成员按访问频率排列: 开头是 reactor 处理每个事件都要访问的字段, 集中在对象的前两个缓存行;
+     * 之后是工作线程解析请求、生成响应时使用的状态; 最后是内联缓冲区、头部表、响应队列等大块数据.
+     * 连接对象由 eventloop 的 slab_pool 在 accept 时分配、关闭时归还, 这些内联空间只属于活跃连接
+     */
+    event_engine* m_engine;                         // 连接所属 reactor 的事件引擎
     int m_sockfd;                                   // 用于连接的 sock
-    sockaddr_in m_addr;                             // client 地址
+    TIMEOUT_TYPE m_timeout_type;                    // 定时器当前对应的超时类型
+    std::atomic<bool> m_in_pool;                    // 是否正在线程池中处理, 此时不能被超时关闭
+    int m_read_idx;                                 // 读指针，指向读入如最后一个字节的下标
+    int m_request_start;                            // 当前请求的起始位置, 之前的数据已处理完
+    int m_response_count;                           // 队列中的响应数
+    int m_send_idx;                                 // 正在发送的响应
+    off_t m_send_pos;                               // 正在发送的响应已发送的字节数(含响应头)
+    uint64_t m_enqueue_ns;                          // 放入线程池的时间, 用于统计排队耗时
+    timer_node m_timer;                             // 超时定时器, 只由所属 eventloop 操作
+
+    /*解析状态*/
     CHECK_STATE m_check_state;                      // 当前主机状态
     METHOD m_method;                                // 请求method
-
-    char m_read_buf[READ_BUFFER_SIZE];              // 读缓冲区
-    int m_read_idx;                                 // 读指针，指向读入如最后一个字节的下标
     int m_checked_idx;                              // 解析报文时，正在读的字符位置
     int m_start_line;                               // 当前正在解析行的起始位置
-    
-    /*解析得到的信息*/
-    char m_real_file[FILENAME_LEN];                 // 客户请求文件的绝对路径
     char* m_url;                                    // 解析得到的 url
+    char* m_query;                                  // url 中 '?' 之后的查询串
+    const route* m_route;                           // 头部解析完时查到的路由, nullptr 表示静态文件
     char* m_version;                                // 协议版本号(1.1)
-    char* m_host;                                   // client端 host
     long m_content_length;                          // 请求总长度
+    long m_body_received;                           // 已交给处理函数或写入临时文件的请求体字节数
+    int m_body_fd;                                  // 请求体临时文件, -1 表示请求体留在读缓冲区(或交给 route::body)
+    int m_body_pipe[2];                             // splice 使用的管道, 第一次 splice 时创建
     bool m_linger;                                  // ?是否 keep alive
-
-
-    char m_write_buf[WRITE_BUFFER_SIZE];            // 写缓冲区
+    bool m_accept_gzip;                             // client 是否接受 gzip 编码
     int m_write_idx;                                // 写缓冲区中待发送字节数
+
+    /*当前请求的文件, 生成响应时移入响应队列*/
+    file_entry* m_file;                             // 请求的文件, 持有一个引用
     char* m_file_address;                           // 客户请求文件读取到内存中的起始位置
+    int m_file_fd;                                  // sendfile 模式下打开的请求文件
+    off_t m_file_size;                              // 发送的实体长度, gzip 时为压缩后的长度
+    const std::string* m_file_headers;              // 预先生成的实体相关响应头, 304 时为 validators(nullptr 时按 m_file_stat 生成)
+    int m_range_count;                              // 要发送的范围数, 0 表示整个文件
+    byte_range m_ranges[MAX_RANGES];
+
+    buffer<READ_BUFFER_SIZE> m_read_buf;            // 读缓冲区
+    buffer<WRITE_BUFFER_SIZE> m_write_buf;          // 写缓冲区
+    header_table m_headers;                         // 当前请求的头部, 指向读缓冲区
+    response m_responses[MAX_PIPELINE];             // 响应队列
+    char m_real_file[FILENAME_LEN];                 // 客户请求文件的绝对路径
     struct stat m_file_stat;                        // 目标文件状态
-    struct iovec m_iv[2];                           // 使用writev
-    int m_iv_count;                                 // 需要写的数量
-    int bytes_to_send;
-    int bytes_have_send;
+    sockaddr_in m_addr;                             // client 地址
 };
 
 #endif // HTTP_COND_H
@@ -0,0 +1,96 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 请求头部表: 名字与值都指向读缓冲区, 已知头部按 HEADER_NAME 建立下标
+ * @Date: 2026-10-17 18:47:31
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 18:47:31
+ */
+#ifndef HTTP_HEADERS_H
+#define HTTP_HEADERS_H
+
+#include "http_scan.h"
+#include <cstddef>
+#include <cstring>
+#include <strings.h>
+
+/**
+ * 一个请求头部, name 与 value 都以 '\0' 结尾, 指向连接的读缓冲区
+ * 只在当前请求处理完之前有效
+ */
+struct header_view{
+    const char* name;
+    const char* value;
+    unsigned int name_len;
+    unsigned int value_len;
+    HEADER_NAME id;
+};
+
+class header_table{
+public:
+    static const int MAX_HEADERS = 32;      // 单个请求最多的头部数
+
+    void clear(){
+        m_count = 0;
+        memset(m_index, -1, sizeof(m_index));
+    }
+
+    /**
+     * @brief 登记一个头部, 同名的已知头部只为第一个建立下标
+     * @return {bool} 超过 MAX_HEADERS 时返回 false
+     */
+    bool add(const char* name, size_t name_len, const char* value, size_t value_len, HEADER_NAME id){
+        if(m_count == MAX_HEADERS) return false;
+        header_view& h = m_headers[m_count];
+        h.name = name;
+        h.value = value;
+        h.name_len = (unsigned int)name_len;
+        h.value_len = (unsigned int)value_len;
+        h.id = id;
+        if(id != HEADER_UNKNOWN && m_index[id] < 0) m_index[id] = (signed char)m_count;
+        m_count++;
+        return true;
+    }
+
+    /**
+     * @brief 已知头部, O(1)
+     * @return {header_view*} 请求中没有时返回 nullptr
+     */
+    const header_view* get(HEADER_NAME id) const{
+        return m_index[id] < 0 ? nullptr : &m_headers[(int)m_index[id]];
+    }
+
+    /**
+     * @brief 按名字查找任意头部, 不区分大小写, 逐个比较
+     */
+    const header_view* find(const char* name) const{
+        size_t len = strlen(name);
+        for(int i = 0; i < m_count; i++){
+            if(m_headers[i].name_len == len && strncasecmp(m_headers[i].name, name, len) == 0){
+                return &m_headers[i];
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief 读缓冲区移动(压缩或扩容)后修正指针
+     * @param {ptrdiff_t} shift 新地址 - 旧地址
+     */
+    void rebase(ptrdiff_t shift){
+        for(int i = 0; i < m_count; i++){
+            m_headers[i].name += shift;
+            m_headers[i].value += shift;
+        }
+    }
+
+    int size() const{ return m_count; }
+    const header_view& operator[](int i) const{ return m_headers[i]; }
+
+private:
+    int m_count;
+    signed char m_index[HEADER_NAME_NUMBER];
+    header_view m_headers[MAX_HEADERS];
+};
+
+#endif // HTTP_HEADERS_H
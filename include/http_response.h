@@ -0,0 +1,92 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 响应头生成: 预先生成的状态行与错误响应, 每秒更新一次的 Date 头, 整数格式化
+ * @Date: 2026-10-17 19:10:26
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 19:10:26
+ */
+#ifndef HTTP_RESPONSE_H
+#define HTTP_RESPONSE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+/**
+ * 一段预先生成的响应数据
+ */
+struct response_blob{
+    const char* data;
+    size_t len;
+};
+
+class http_response{
+public:
+    static const int MAX_UINT_LEN = 20;     // uint64_t 的最大位数
+    static const int MAX_DATE_LEN = 29;     // IMF-fixdate 的长度
+
+    /**
+     * @brief 状态行, 如 "HTTP/1.1 404 Not Found\r\n"
+     *        不认识的状态码返回 500 的状态行
+     */
+    static const response_blob& status_line(int status);
+
+    /**
+     * @brief 实际发送的状态码: 状态表中有的原样返回, 不认识的为 500, 与 status_line() 一致
+     */
+    static int known_status(int status);
+
+    /**
+     * @brief "Date: Sat, 17 Oct 2026 11:10:26 GMT\r\n"
+     *        每个线程各自缓存, 同一秒内不再重新格式化
+     */
+    static const response_blob& date_header();
+
+    /**
+     * @brief 错误响应中状态行与 Date 之后的部分: 固定的头部、空行与页面内容
+     * @param {int} status 400/403/404/500 等, 其余按 500 处理
+     * @param {bool} keep_alive Connection 头
+     */
+    static response_blob error_tail(int status, bool keep_alive);
+
+    /**
+     * @brief 十进制格式化, out 至少 MAX_UINT_LEN 字节, 不写 '\0'
+     * @return {char*} 写入的结尾
+     */
+    static char* format_uint(char* out, uint64_t value);
+
+    /**
+     * @brief IMF-fixdate 格式的 HTTP 日期, out 至少 MAX_DATE_LEN 字节, 不写 '\0'
+     * @return {char*} 写入的结尾
+     */
+    static char* format_date(char* out, time_t t);
+
+    /**
+     * @brief 解析 IMF-fixdate 格式的 HTTP 日期, 如 "Sat, 17 Oct 2026 11:10:26 GMT"
+     * @return {bool} 格式不对时返回 false
+     */
+    static bool parse_date(const char* value, time_t& t);
+
+    /**
+     * @brief multipart/byteranges 的分隔字符串, 进程启动时随机生成
+     */
+    static const response_blob& boundary();
+
+private:
+    struct status_entry{
+        int status;
+        response_blob line;
+        const char* form;               // 错误页面内容, 非错误状态为 nullptr
+        std::string tails[2];           // 错误响应的尾部: [0] close, [1] keep-alive
+    };
+
+    static status_entry* entry(int status);
+    static status_entry s_status[];
+    static const int s_status_number;
+
+    friend struct error_tails_init;
+};
+
+#endif // HTTP_RESPONSE_H
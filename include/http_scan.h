@@ -0,0 +1,80 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 请求解析用的字符扫描(SSE2/AVX2, 运行时按 CPU 选择)与已知头部名查表
+ * @Date: 2026-10-17 17:58:20
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 17:58:20
+ */
+#ifndef HTTP_SCAN_H
+#define HTTP_SCAN_H
+
+#include <cstddef>
+
+/**
+ * 预先建立下标的头部, 其余的为 HEADER_UNKNOWN, 仍可以按名字查找
+ */
+enum HEADER_NAME{
+    HEADER_UNKNOWN = 0,
+    HEADER_HOST,
+    HEADER_RANGE,
+    HEADER_ACCEPT,
+    HEADER_COOKIE,
+    HEADER_EXPECT,
+    HEADER_IF_RANGE,
+    HEADER_CONNECTION,
+    HEADER_USER_AGENT,
+    HEADER_CONTENT_TYPE,
+    HEADER_IF_NONE_MATCH,
+    HEADER_CONTENT_LENGTH,
+    HEADER_ACCEPT_ENCODING,
+    HEADER_IF_MODIFIED_SINCE,
+    HEADER_TRANSFER_ENCODING,
+    HEADER_NAME_NUMBER
+};
+
+class http_scan{
+public:
+    enum ISA{
+        SCALAR = 0,     // 逐字节
+        SSE2,           // 每次 16 字节
+        AVX2            // 每次 32 字节
+    };
+
+    /**
+     * @brief 在 [begin, end) 中查找字符 c
+     * @return {char*} 第一个 c 的位置, 没有时返回 end
+     */
+    static char* find(char* begin, char* end, char c){
+        return const_cast<char*>(s_find(begin, end, c));
+    }
+    static const char* find(const char* begin, const char* end, char c){
+        return s_find(begin, end, c);
+    }
+
+    /**
+     * @brief 识别头部名(不含 ':'), 不区分大小写
+     *        先按长度分桶, 同长度的名字再逐个比较, 每个桶最多只有几项
+     */
+    static HEADER_NAME header_name(const char* name, size_t len);
+
+    /**
+     * @brief 当前使用的指令集, 启动时按 CPU 自动选择
+     */
+    static ISA isa(){ return s_isa; }
+
+    /**
+     * @brief 强制使用某个指令集, CPU 不支持时返回 false; 用于测试与基准
+     */
+    static bool select(ISA isa);
+
+    static const char* isa_name(ISA isa);
+
+    typedef const char* (*find_func)(const char*, const char*, char);
+
+private:
+    static find_func s_find;
+    static ISA s_isa;
+};
+
+#endif // HTTP_SCAN_H
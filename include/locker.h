@@ -76,7 +76,7 @@ private:
 
 class sem{
 public:
-    sem(){ sem(0); }
+    sem() : sem(0){}
 
     sem(int value){
         if(sem_init(&m_sem, 0, value) != 0){
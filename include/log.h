@@ -0,0 +1,185 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 异步日志: 编译期按级别过滤, 每个线程一个无锁环形缓冲区, 后台线程格式化并批量写入
+ * @Date: 2026-10-17 19:42:15
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 19:42:15
+ */
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_OFF   4
+
+// 低于 LOG_LEVEL 的日志在编译期被去掉, 参数也不会求值; 由 CMake 的 LOG_LEVEL 选项设置
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+/**
+ * 调用线程只把格式串指针、时间与参数的二进制值写入自己的环形缓冲区,
+ * 格式化(snprintf)与 write 都在后台线程中进行
+ *  - 格式串必须是字符串常量, 只保存指针
+ *  - 字符串参数在调用时复制, 最长 MAX_STRING 字节
+ *  - 缓冲区满时丢弃日志并计数, 调用线程从不阻塞
+ */
+class logger{
+public:
+    static const size_t RING_SIZE = 256 * 1024;     // 每个线程的缓冲区大小, 2 的幂
+    static const size_t MAX_STRING = 1024;
+
+    enum ARG_TYPE : uint8_t{
+        ARG_INT = 0,
+        ARG_UINT,
+        ARG_DOUBLE,
+        ARG_STRING,
+        ARG_POINTER
+    };
+
+    /**
+     * @brief 启动后台线程
+     * @param {char*} path 日志文件, nullptr 时写到标准输出
+     * @return {bool} 文件无法打开或线程创建失败时返回 false
+     */
+    static bool init(const char* path);
+
+    /**
+     * @brief 写出缓冲区中剩余的日志并停止后台线程
+     */
+    static void stop();
+
+    /**
+     * @brief 因缓冲区满而丢弃的日志条数
+     */
+    static uint64_t dropped();
+
+    template<typename... Args>
+    static void log(int level, const char* fmt, const Args&... args){
+        size_t size = sizeof(record) + (arg_size(args) + ... + 0);
+        size = (size + 7) & ~(size_t)7;
+        char* p = begin(size);
+        if(!p) return;
+        record* r = (record*)p;
+        r->size = (uint32_t)size;
+        r->level = (uint8_t)level;
+        r->argc = (uint8_t)sizeof...(Args);
+        r->fmt = fmt;
+        stamp(r);
+        p += sizeof(record);
+        ((p = put(p, args)), ...);
+        commit(size);
+    }
+
+    // 以下供实现使用
+    struct record{
+        uint32_t size;                  // 含参数与对齐, 8 的倍数
+        uint8_t level;                  // 0xff 表示缓冲区末尾的填充
+        uint8_t argc;
+        uint16_t reserved;
+        uint32_t nsec;
+        int64_t sec;
+        const char* fmt;
+    };
+
+private:
+    static char* begin(size_t size);
+    static void commit(size_t size);
+    static void stamp(record* r);
+
+    // 每个参数: 1 字节类型 + 8 字节值, 字符串为 1 字节类型 + 2 字节长度 + 内容 + '\0'
+    static size_t str_len(const char* s){ return s ? strnlen(s, MAX_STRING) : 6; }
+    static size_t arg_size(const char* s){ return 3 + str_len(s) + 1; }
+    static size_t arg_size(char* s){ return arg_size((const char*)s); }
+    static size_t arg_size(const std::string& s){ return 3 + (s.size() < MAX_STRING ? s.size() : MAX_STRING) + 1; }
+    template<size_t N>
+    static size_t arg_size(const char (&s)[N]){ return arg_size((const char*)s); }
+    template<typename T>
+    static size_t arg_size(const T&){ return 9; }
+
+    static char* put_string(char* p, const char* s, size_t len){
+        *p = ARG_STRING;
+        uint16_t n = (uint16_t)len;
+        memcpy(p + 1, &n, 2);
+        memcpy(p + 3, s, len);
+        p[3 + len] = '\0';
+        return p + 4 + len;
+    }
+    static char* put(char* p, const char* s){
+        return s ? put_string(p, s, str_len(s)) : put_string(p, "(null)", 6);
+    }
+    static char* put(char* p, char* s){ return put(p, (const char*)s); }
+    static char* put(char* p, const std::string& s){
+        return put_string(p, s.data(), s.size() < MAX_STRING ? s.size() : MAX_STRING);
+    }
+    template<size_t N>
+    static char* put(char* p, const char (&s)[N]){ return put(p, (const char*)s); }
+    template<typename T>
+    static char* put(char* p, const T& v){
+        if constexpr(std::is_floating_point<T>::value){
+            double d = v;
+            *p = ARG_DOUBLE;
+            memcpy(p + 1, &d, 8);
+        }else if constexpr(std::is_pointer<T>::value){
+            const void* ptr = v;
+            *p = ARG_POINTER;
+            memcpy(p + 1, &ptr, 8);
+        }else if constexpr(std::is_signed<T>::value || std::is_enum<T>::value){
+            int64_t i = (int64_t)v;
+            *p = ARG_INT;
+            memcpy(p + 1, &i, 8);
+        }else{
+            uint64_t u = (uint64_t)v;
+            *p = ARG_UINT;
+            memcpy(p + 1, &u, 8);
+        }
+        return p + 9;
+    }
+};
+
+/**
+ * 只用于让编译器检查格式串与参数, 从不调用
+ */
+static inline void log_check_format(const char*, ...) __attribute__((format(printf, 1, 2)));
+static inline void log_check_format(const char*, ...){}
+
+#define LOG_WRITE(level, fmt, ...) \
+    do{ if(0) log_check_format(fmt, ##__VA_ARGS__); logger::log(level, fmt, ##__VA_ARGS__); }while(0)
+#define LOG_DISCARD(fmt, ...) \
+    do{ if(0) log_check_format(fmt, ##__VA_ARGS__); }while(0)
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) LOG_WRITE(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) LOG_WRITE(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...) LOG_WRITE(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) LOG_WRITE(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) LOG_DISCARD(fmt, ##__VA_ARGS__)
+#endif
+
+#endif // LOG_H
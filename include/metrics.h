@@ -0,0 +1,127 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 运行指标: 每个线程独立的计数器与对数分桶直方图, 读取时合并, 以 Prometheus 文本格式输出
+ * @Date: 2026-10-17 20:48:06
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 20:48:06
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+#define METRICS_URL "/metrics"              // 内置路由, 不再映射到 DOC_ROOT 下的文件
+
+enum METRIC_COUNTER{
+    METRIC_ACCEPTS = 0,                     // accept 成功的连接数
+    METRIC_BYTES_SENT,                      // 发出的字节数(响应头 + 实体)
+    METRIC_QUEUE_FULL,                      // 请求队列满而被关闭的连接数
+    METRIC_TIMEOUTS,                        // 超时关闭的连接数
+    METRIC_SYSCALLS,                        // 连接 I/O 路径上的系统调用数(accept、epoll、recv、send、io_uring_enter 等)
+    METRIC_COUNTER_NUMBER
+};
+
+enum METRIC_HISTOGRAM{
+    METRIC_QUEUE_WAIT = 0,                  // 从放入线程池到开始处理
+    METRIC_PARSE,                           // 解析一个请求
+    METRIC_SEND,                            // 从响应生成到全部发出
+    METRIC_HISTOGRAM_NUMBER
+};
+
+/**
+ * 每个线程写自己的 metrics_shard, 只有该线程修改, 因此用 relaxed 的 load + store 而不是原子加,
+ * 不产生 lock 前缀指令, 也不与其他线程共享 cache line; 读取时把所有 shard 相加
+ *
+ * 直方图以纳秒为单位对数线性分桶: 每个 2 的幂区间再分 8 个子桶, 相对误差不超过 12.5%
+ */
+class metrics{
+public:
+    static const int SUB_BITS = 3;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKETS = 38 * SUB_BUCKETS;    // 最大约 2^40 ns(18 分钟), 更大的值计入最后一个桶
+    static const int MIN_STATUS = 100;
+    static const int MAX_STATUS = 599;
+
+    struct shard{
+        std::atomic<uint64_t> counters[METRIC_COUNTER_NUMBER];
+        std::atomic<uint64_t> status[MAX_STATUS - MIN_STATUS + 1];
+        std::atomic<uint64_t> buckets[METRIC_HISTOGRAM_NUMBER][BUCKETS];
+        std::atomic<uint64_t> sum[METRIC_HISTOGRAM_NUMBER];
+        shard* next;
+    };
+
+    static void add(METRIC_COUNTER c, uint64_t n = 1){
+        bump(local()->counters[c], n);
+    }
+
+    /**
+     * @brief 记录一个响应的状态码
+     */
+    static void status(int code){
+        if(code < MIN_STATUS || code > MAX_STATUS) return;
+        bump(local()->status[code - MIN_STATUS], 1);
+    }
+
+    /**
+     * @brief 记录一个耗时
+     * @param {uint64_t} ns 纳秒
+     */
+    static void observe(METRIC_HISTOGRAM h, uint64_t ns){
+        shard* s = local();
+        bump(s->buckets[h][bucket(ns)], 1);
+        bump(s->sum[h], ns);
+    }
+
+    static uint64_t now_ns(){
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+    static int bucket(uint64_t ns){
+        if(ns < (uint64_t)SUB_BUCKETS) return (int)ns;
+        int shift = 63 - __builtin_clzll(ns) - SUB_BITS;
+        int index = shift * SUB_BUCKETS + (int)(ns >> shift);
+        return index < BUCKETS ? index : BUCKETS - 1;
+    }
+
+    /**
+     * @brief 桶的上界(不含)
+     */
+    static uint64_t bucket_upper(int index){
+        if(index < SUB_BUCKETS) return index + 1;
+        int shift = index / SUB_BUCKETS - 1;
+        return (uint64_t)(index % SUB_BUCKETS + SUB_BUCKETS + 1) << shift;
+    }
+
+    /**
+     * 读取时计算的指标, 如队列长度、当前连接数, 在启动阶段注册
+     */
+    typedef long (*gauge_func)(void* arg);
+    static void add_gauge(const char* name, const char* help, gauge_func fn, void* arg);
+
+    /**
+     * @brief 合并所有线程的数据, 生成 Prometheus 文本格式
+     */
+    static void render(std::string& out);
+
+private:
+    static void bump(std::atomic<uint64_t>& v, uint64_t n){
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static shard* local(){
+        shard* s = t_shard;
+        return s ? s : create();
+    }
+
+    static shard* create();
+    static thread_local shard* t_shard;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,127 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 有界无锁多生产者多消费者环形队列
+ * @Date: 2026-10-17 11:20:40
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 11:20:40
+ */
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+#define CACHE_LINE_SIZE 64
+
+/**
+ * 基于每个槽位序号(sequence)的有界 MPMC 队列 (Dmitry Vyukov 算法)
+ *  - 预先分配全部槽位, 入队/出队不分配内存
+ *  - 生产者、消费者各自只 CAS 自己的位置计数, 两个计数分别独占一个 cache line
+ *  - 每个槽位同样按 cache line 对齐, 相邻槽位的读写不会互相干扰
+ * 容量即构造时传入的值, 不要求是 2 的幂
+ */
+template<typename T>
+class mpmc_queue{
+public:
+    explicit mpmc_queue(size_t capacity);
+    ~mpmc_queue();
+
+    mpmc_queue(const mpmc_queue&) = delete;
+    mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+    bool push(const T& data);                   // 队列满返回 false
+    bool pop(T& data);                          // 队列空返回 false
+    size_t capacity() const { return m_capacity; }
+    size_t size() const;                        // 近似长度, 仅用于统计
+
+private:
+    struct alignas(CACHE_LINE_SIZE) cell{
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    cell* const m_buffer;
+    size_t const m_capacity;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_enqueue_pos;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_dequeue_pos;
+    char m_pad[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+};
+
+template<typename T>
+mpmc_queue<T>::mpmc_queue(size_t capacity)
+        : m_buffer(capacity > 0 ? new cell[capacity] : nullptr), m_capacity(capacity),
+          m_enqueue_pos(0), m_dequeue_pos(0){
+    if(m_capacity == 0){
+        throw std::exception();
+    }
+    for(size_t i = 0; i < m_capacity; i++){
+        m_buffer[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template<typename T>
+mpmc_queue<T>::~mpmc_queue(){
+    delete [] m_buffer;
+}
+
+template<typename T>
+bool mpmc_queue<T>::push(const T& data){
+    cell* c;
+    size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    while(true){
+        c = &m_buffer[pos % m_capacity];
+        size_t seq = c->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if(diff == 0){
+            // 槽位空闲, 抢占入队位置
+            if(m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                break;
+            }
+        }else if(diff < 0){
+            // 槽位仍被上一轮数据占用, 队列已满
+            return false;
+        }else{
+            pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    c->data = data;
+    c->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T>
+bool mpmc_queue<T>::pop(T& data){
+    cell* c;
+    size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    while(true){
+        c = &m_buffer[pos % m_capacity];
+        size_t seq = c->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if(diff == 0){
+            if(m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                break;
+            }
+        }else if(diff < 0){
+            // 槽位尚未写入, 队列为空
+            return false;
+        }else{
+            pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    data = c->data;
+    // 标记槽位可被下一轮生产者使用
+    c->sequence.store(pos + m_capacity, std::memory_order_release);
+    return true;
+}
+
+template<typename T>
+size_t mpmc_queue<T>::size() const{
+    size_t enq = m_enqueue_pos.load(std::memory_order_relaxed);
+    size_t deq = m_dequeue_pos.load(std::memory_order_relaxed);
+    return enq > deq ? enq - deq : 0;
+}
+
+#endif // MPMC_QUEUE_H
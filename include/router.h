@@ -0,0 +1,145 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 动态处理函数的路由: 编译期路由表(constexpr 生成的完美哈希)与启动时注册的路由, 都没有命中时由静态文件处理
+ * @Date: 2026-10-17 23:58:40
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 23:58:40
+ */
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+class http_conn;
+
+// 路由接受的方法, 第 n 位对应 http_conn::METHOD 中值为 n 的方法
+enum ROUTE_METHOD{
+    ROUTE_GET = 1u << 0,
+    ROUTE_POST = 1u << 1,
+    ROUTE_PUT = 1u << 3
+};
+
+/**
+ * 处理函数的应答, 由 http_conn 补上 Date、Content-Length、Connection 后写成完整响应;
+ * status 需要在 http_response 的状态表中(否则按 500 发送并统计), body 为空且 status >= 400 时使用预先生成的错误页面
+ */
+struct route_reply{
+    int status;                                 // 默认 200
+    const char* content_type;                   // 默认 "text/plain"
+    std::string body;                           // 每个线程复用同一个对象, 处理函数只需追加内容
+};
+
+/**
+ * 处理函数在头部与请求体都接收完后调用, 与静态文件请求一样在工作线程(协程引擎为 reactor 线程)中执行;
+ * 通过 conn 的 method()、path()、query()、headers()、body() 等读取请求
+ */
+typedef void (*route_handler)(const http_conn& conn, route_reply& reply);
+
+/**
+ * 请求体的处理函数: 请求体按到达顺序以 http_conn::m_body_chunk 字节一块调用(最后一块可能不足), 最后以 len 为 0 调用一次;
+ * 返回 false 时以 500 结束请求. 与 route_handler 在同一线程中调用, 之后才调用 route_handler
+ */
+typedef bool (*route_body_handler)(http_conn* conn, const char* data, size_t len);
+
+struct route{
+    const char* path;                           // 不含查询串, 完全匹配
+    unsigned methods;                           // ROUTE_METHOD 的组合, 其他方法返回 405
+    route_handler handler;
+    route_body_handler body;                    // nullptr 时请求体留在读缓冲区或写入临时文件
+};
+
+/**
+ * 编译期路由表: 在 constexpr 中搜索一个种子, 使所有路径的哈希落在互不相同的槽中(完美哈希),
+ * 查找只需计算一次哈希、比较一次长度和一次内容; 路径重复或找不到种子时编译失败
+ */
+template<size_t N>
+struct route_table{
+    static constexpr size_t SIZE = N * 2 <= 8 ? 8 : (size_t)1 << (64 - __builtin_clzll(N * 2 - 1));   // 不小于 2N 的 2 的幂
+    static const int MAX_SEED = 1 << 16;
+
+    route routes[N];
+    size_t lens[N];
+    int slots[SIZE];                            // 路由下标, -1 为空
+    uint32_t seed;
+
+    /**
+     * @brief 带种子的 FNV-1a
+     */
+    static constexpr uint32_t hash(const char* s, size_t len, uint32_t seed){
+        uint32_t h = 2166136261u ^ seed;
+        for(size_t i = 0; i < len; i++){
+            h = (h ^ (unsigned char)s[i]) * 16777619u;
+        }
+        return h ^ (h >> 15);
+    }
+
+    static constexpr size_t length(const char* s){
+        size_t len = 0;
+        while(s[len]) len++;
+        return len;
+    }
+
+    constexpr explicit route_table(const route (&r)[N]) : routes(), lens(), slots(), seed(0){
+        for(size_t i = 0; i < N; i++){
+            routes[i] = r[i];
+            lens[i] = length(r[i].path);
+            for(size_t j = 0; j < i; j++){
+                bool same = lens[i] == lens[j];
+                for(size_t k = 0; same && k < lens[i]; k++) same = r[i].path[k] == r[j].path[k];
+                if(same) throw "duplicate route";
+            }
+        }
+        for(int s = 0; s < MAX_SEED; s++){
+            for(size_t i = 0; i < SIZE; i++) slots[i] = -1;
+            bool ok = true;
+            for(size_t i = 0; ok && i < N; i++){
+                size_t slot = hash(r[i].path, lens[i], s) & (SIZE - 1);
+                if(slots[slot] != -1) ok = false;
+                else slots[slot] = (int)i;
+            }
+            if(ok){
+                seed = s;
+                return;
+            }
+        }
+        throw "no perfect hash seed for routes";
+    }
+
+    const route* find(const char* path, size_t len) const{
+        int i = slots[hash(path, len, seed) & (SIZE - 1)];
+        if(i < 0 || lens[i] != len || memcmp(routes[i].path, path, len) != 0) return nullptr;
+        return &routes[i];
+    }
+};
+
+class router{
+public:
+    /**
+     * @brief 查找路径对应的路由, 先查编译期路由表, 再查启动时注册的路由
+     * @return {const route*} 没有时返回 nullptr, 由静态文件处理
+     */
+    static const route* find(const char* path, size_t len);
+
+    /**
+     * @brief 注册一个路由, 必须在事件循环启动前调用(查找时不加锁)
+     * @return {bool} 路径已存在或不以 '/' 开头时返回 false
+     */
+    static bool add(const char* path, unsigned methods, route_handler handler, route_body_handler body = nullptr);
+
+    /**
+     * @brief 写入 "Allow: GET, POST\r\n" 形式的头部
+     * @return {char*} 写入后的位置, out 至少需要 MAX_ALLOW_LEN 字节
+     */
+    static char* format_allow(char* out, unsigned methods);
+    static const int MAX_ALLOW_LEN = 32;
+
+private:
+    static std::vector<route> m_routes;         // 启动时注册的路由, 通常只有几项, 顺序比较
+};
+
+#endif // ROUTER_H
@@ -0,0 +1,136 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 定长对象的 slab 分配器, 用于连接对象
+ * @Date: 2026-10-17 23:05:40
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 23:05:40
+ */
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+/**
+ * 每个 slab 是按 SLAB_SIZE 对齐的一块内存, 开头是 slab 头, 之后是对象槽位;
+ * 对象地址按 SLAB_SIZE 向下取整即得到所属 slab, 释放时不需要查找
+ *  - 有空闲槽位的 slab 组成双向链表, 分配总是从链表头取
+ *  - slab 全部空闲时归还给系统, 只保留一个备用, 避免连接数在边界附近抖动时反复申请
+ *  - 内存随活跃对象数增减, 不再按最大连接数预先分配
+ * 对象在 create() 时构造、destroy() 时析构, 槽位复用不清零
+ * 非线程安全, 每个 eventloop 一个, 只在所属线程中分配与释放
+ */
+template<typename T, size_t SLAB_SIZE = 64 * 1024>
+class slab_pool{
+public:
+    slab_pool() : m_partial(nullptr), m_spare(nullptr), m_live(0), m_slabs(0){}
+    ~slab_pool(){
+        // 对象应已全部释放, 这里只归还内存
+        while(m_partial){
+            slab* next = m_partial->next;
+            free(m_partial);
+            m_partial = next;
+        }
+        free(m_spare);
+    }
+
+    slab_pool(const slab_pool&) = delete;
+    slab_pool& operator=(const slab_pool&) = delete;
+
+    /**
+     * @brief 分配并默认构造一个对象
+     * @return {T*} 内存不足时返回 nullptr
+     */
+    T* create(){
+        slab* s = m_partial;
+        if(!s){
+            s = m_spare ? m_spare : new_slab();
+            if(!s) return nullptr;
+            m_spare = nullptr;
+            link(s);
+        }
+        slot* p = s->free;
+        s->free = p->next;
+        if(++s->used == PER_SLAB) unlink(s);
+        m_live++;
+        return new(p) T();
+    }
+
+    void destroy(T* obj){
+        obj->~T();
+        slab* s = (slab*)((uintptr_t)obj & ~(uintptr_t)(SLAB_SIZE - 1));
+        slot* p = (slot*)obj;
+        p->next = s->free;
+        s->free = p;
+        if(s->used-- == PER_SLAB) link(s);
+        m_live--;
+        if(s->used == 0){
+            unlink(s);
+            if(m_spare){
+                free(s);
+                m_slabs.fetch_sub(1, std::memory_order_relaxed);
+            }else{
+                m_spare = s;
+            }
+        }
+    }
+
+    size_t live() const{ return m_live; }
+    // 可在其他线程中读取, 用于统计
+    size_t bytes() const{ return m_slabs.load(std::memory_order_relaxed) * SLAB_SIZE; }
+
+private:
+    union slot{
+        slot* next;
+        alignas(T) char data[sizeof(T)];
+    };
+
+    struct slab{
+        slab* prev;
+        slab* next;
+        slot* free;                                 // 空闲槽位链表
+        size_t used;
+    };
+
+    static const size_t HEADER_SIZE = (sizeof(slab) + alignof(slot) - 1) / alignof(slot) * alignof(slot);
+    static const size_t PER_SLAB = (SLAB_SIZE - HEADER_SIZE) / sizeof(slot);
+    static_assert((SLAB_SIZE & (SLAB_SIZE - 1)) == 0, "SLAB_SIZE must be a power of 2");
+    static_assert(PER_SLAB > 0, "SLAB_SIZE is too small for the object");
+
+    slab* new_slab(){
+        slab* s = (slab*)aligned_alloc(SLAB_SIZE, SLAB_SIZE);
+        if(!s) return nullptr;
+        slot* slots = (slot*)((char*)s + HEADER_SIZE);
+        for(size_t i = 0; i + 1 < PER_SLAB; i++) slots[i].next = slots + i + 1;
+        slots[PER_SLAB - 1].next = nullptr;
+        s->free = slots;
+        s->used = 0;
+        m_slabs.fetch_add(1, std::memory_order_relaxed);
+        return s;
+    }
+
+    void link(slab* s){
+        s->prev = nullptr;
+        s->next = m_partial;
+        if(m_partial) m_partial->prev = s;
+        m_partial = s;
+    }
+
+    void unlink(slab* s){
+        if(s->prev) s->prev->next = s->next;
+        else m_partial = s->next;
+        if(s->next) s->next->prev = s->prev;
+    }
+
+private:
+    slab* m_partial;                                // 有空闲槽位的 slab
+    slab* m_spare;                                  // 全部空闲的备用 slab, 不在链表中
+    size_t m_live;
+    std::atomic<size_t> m_slabs;                    // 已申请的 slab 数(含备用)
+};
+
+#endif // SLAB_POOL_H
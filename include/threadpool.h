@@ -10,52 +10,96 @@
 #define THREADPOOL_H
 
 #include "locker.h"
+#include "mpmc_queue.h"
+#include "log.h"
 #include <pthread.h>
-#include <list>
-#include <cstdio>
+#include <atomic>
+#include <cstdint>
 #include <exception>
-#include <iostream>
 
+// 线程池调度方式
+enum POOL_MODE{
+    SHARED_QUEUE = 0,           // 所有 worker 共享一个请求队列
+    WORK_STEALING               // 每个 worker 一个队列, 空闲时从其他 worker 窃取
+};
+
+/**
+ * T 需要提供 process() 与 affinity(): process() 在 worker 中处理请求,
+ * affinity() 返回请求所属连接的标识(如 socket fd), 窃取模式下按它选择 worker
+ */
 template<typename T>
 class threadpool{
 public:
     /**
      * @brief 
      * @param {int} thread_number
-     * @param {int} max_requests
+     * @param {int} max_requests 请求队列容量, 队列满时 append 返回 false
+     * @param {POOL_MODE} mode 调度方式, WORK_STEALING 时同一连接的请求优先交给同一个 worker
      * @return {*}
      */    
-    threadpool(int thread_number=8, int max_requests=10000);
+    threadpool(int thread_number=8, int max_requests=10000, POOL_MODE mode=SHARED_QUEUE);
     ~threadpool();
     bool append(T* request);
+    size_t queue_depth() const;     // 排队中的请求数, 近似值, 用于统计
 
 private:
+    // 每个 worker 的私有数据, 独占 cache line
+    struct alignas(CACHE_LINE_SIZE) worker_slot{
+        threadpool* pool;
+        int index;
+        mpmc_queue<T*>* queue;          // 共享模式下指向同一个队列
+        sem wakeup;                     // 唤醒该 worker
+        std::atomic<bool> sleeping;     // 是否在(或准备)睡眠
+    };
+
     static void* worker(void* arg);
-    void run();
+    void run(worker_slot* self);
+    T* take(worker_slot* self);         // 取出一个请求, 无请求时睡眠
+    bool try_pop(worker_slot* self, T*& request);
+    bool wake(worker_slot* slot);
+    void wake_one();
 
 private:
+    static const int SPIN_COUNT = 64;   // 睡眠前的自旋次数
+
     int m_thread_number;        // 线程池数量
     pthread_t* m_threads;       // 线程池列表
     int m_max_requests;         // 最大请求数
-    std::list<T*> m_workqueue;  // 请求列表
-    locker m_queuelocker;       // 请求列表锁
-    sem m_queuesem;             // 请求信号量，判断是否有请求待处理 
-    bool m_run;                // 是否需要结束任务
+    POOL_MODE m_mode;           // 调度方式
+    mpmc_queue<T*>* m_workqueue;    // 共享模式下的请求队列, 无锁环形队列
+    worker_slot* m_slots;       // worker 私有数据
+    std::atomic<int> m_sleepers;    // 正在(或准备)睡眠的 worker 数量
+    std::atomic<bool> m_run;    // 是否需要结束任务
 };
 
 template<typename T>
-threadpool<T>::threadpool(int thread_number, int max_requests)
-        : m_thread_number(thread_number), m_max_requests(max_requests), m_run(true), m_threads(nullptr){
+threadpool<T>::threadpool(int thread_number, int max_requests, POOL_MODE mode)
+        : m_thread_number(thread_number), m_threads(nullptr), m_max_requests(max_requests), m_mode(mode),
+          m_workqueue(nullptr), m_slots(nullptr), m_sleepers(0), m_run(true){
     if(m_thread_number <= 0 || m_max_requests <=0){
         throw std::exception();
     }
+    m_slots = new worker_slot[m_thread_number];
+    if(m_mode == SHARED_QUEUE){
+        m_workqueue = new mpmc_queue<T*>(m_max_requests);
+    }
+    // 窃取模式下总容量仍为 max_requests, 平均分给每个 worker
+    int per_worker = m_max_requests / m_thread_number;
+    if(per_worker <= 0) per_worker = 1;
+    for(int i = 0; i < m_thread_number; i++){
+        m_slots[i].pool = this;
+        m_slots[i].index = i;
+        m_slots[i].queue = m_mode == SHARED_QUEUE ? m_workqueue : new mpmc_queue<T*>(per_worker);
+        m_slots[i].sleeping.store(false, std::memory_order_relaxed);
+    }
+
     m_threads = new pthread_t[m_thread_number];
     if(!m_threads){
         throw std::exception();
     }
     for(int i = 0; i < m_thread_number; i++){
-        std::cout << "Create Thread " << i + 1 << std::endl;
-        if(pthread_create(m_threads + i, nullptr, worker, this) != 0){
+        LOG_INFO("Create Thread %d", i + 1);
+        if(pthread_create(m_threads + i, nullptr, worker, m_slots + i) != 0){
             delete [] m_threads;
             throw std::exception();
         }
@@ -71,42 +115,135 @@ template<typename T>
 threadpool<T>::~threadpool(){
     delete [] m_threads;    // 必须使用 [] 删除，否则会内存泄漏
     m_run = false;
+    // worker 为 detach 线程, 退出前仍可能访问 m_slots 与队列, 因此这里只唤醒不释放
+    for(int i = 0; i < m_thread_number; i++){
+        m_slots[i].wakeup.post();
+    }
 }
 
+/**
+ * @brief 添加请求, 不分配内存
+ *        窃取模式下按 request->affinity()(连接 fd)选择 worker, 同一连接落在同一个 worker 上
+ * @param {T*} request
+ * @return {bool} 队列已满返回 false
+ */
 template<typename T>
 bool threadpool<T>::append(T* request){
-    printf("Put new events into the thread pool\n");
-    m_queuelocker.lock();
-    if(m_workqueue.size() > m_max_requests){
-        m_queuelocker.unlock();
-        return false;
+    worker_slot* target = nullptr;
+    if(m_mode == SHARED_QUEUE){
+        if(!m_workqueue->push(request)){
+            return false;
+        }
+    }else{
+        int home = (int)((unsigned)request->affinity() % m_thread_number);
+        // 目标 worker 队列满时依次尝试其他 worker
+        for(int i = 0; i < m_thread_number && !target; i++){
+            worker_slot* slot = m_slots + (home + i) % m_thread_number;
+            if(slot->queue->push(request)) target = slot;
+        }
+        if(!target){
+            return false;
+        }
     }
-    m_workqueue.push_back(request);
-    m_queuelocker.unlock();
-    m_queuesem.post();
-    printf("新事件成功放入线程池\n");
+    // 与 take() 中的屏障配对: 要么这里看到睡眠者, 要么睡眠者能看到新请求
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_sleepers.load(std::memory_order_acquire) > 0){
+        // 优先唤醒目标 worker, 它正忙时唤醒任意空闲 worker 来窃取
+        if(!target || !wake(target)){
+            wake_one();
+        }
+    }
+    LOG_DEBUG("新事件成功放入线程池");
     return true;
 }
 
+/**
+ * @brief 排队中的请求数, 各队列的近似值之和, 用于统计
+ */
+template<typename T>
+size_t threadpool<T>::queue_depth() const{
+    if(m_mode == SHARED_QUEUE) return m_workqueue->size();
+    size_t depth = 0;
+    for(int i = 0; i < m_thread_number; i++){
+        depth += m_slots[i].queue->size();
+    }
+    return depth;
+}
+
+/**
+ * @brief 唤醒指定 worker
+ * @return {bool} 该 worker 是否处于睡眠
+ */
+template<typename T>
+bool threadpool<T>::wake(worker_slot* slot){
+    if(slot->sleeping.load(std::memory_order_relaxed) && slot->sleeping.exchange(false)){
+        slot->wakeup.post();
+        return true;
+    }
+    return false;
+}
+
+template<typename T>
+void threadpool<T>::wake_one(){
+    for(int i = 0; i < m_thread_number; i++){
+        if(wake(m_slots + i)) return;
+    }
+}
+
 template<typename T>
 void* threadpool<T>::worker(void* arg){
-    threadpool* pool = (threadpool*) arg;
-    pool->run();
-    return pool;
+    worker_slot* self = (worker_slot*) arg;
+    self->pool->run(self);
+    return self->pool;
 }
 
+/**
+ * @brief 先取自己的队列, 窃取模式下再依次从其他 worker 的队列窃取
+ * @return {bool} 是否取到请求
+ */
 template<typename T>
-void threadpool<T>::run(){
-    while(m_run){
-        m_queuesem.wait();
-        m_queuelocker.lock();
-        if(m_workqueue.empty()){
-            m_queuelocker.unlock();
-            continue;
+bool threadpool<T>::try_pop(worker_slot* self, T*& request){
+    if(self->queue->pop(request)) return true;
+    if(m_mode != WORK_STEALING) return false;
+    for(int i = 1; i < m_thread_number; i++){
+        worker_slot* victim = m_slots + (self->index + i) % m_thread_number;
+        if(victim->queue->pop(request)) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 先自旋, 仍没有请求再登记为睡眠者并等待信号量
+ *        登记后必须再检查一次队列, 避免与 append() 之间丢失唤醒
+ * @return {T*} 请求, 线程池停止时返回 nullptr
+ */
+template<typename T>
+T* threadpool<T>::take(worker_slot* self){
+    T* request = nullptr;
+    while(m_run.load(std::memory_order_relaxed)){
+        for(int i = 0; i < SPIN_COUNT; i++){
+            if(try_pop(self, request)) return request;
+        }
+        self->sleeping.store(true, std::memory_order_relaxed);
+        m_sleepers.fetch_add(1, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(try_pop(self, request)){
+            // 若已被唤醒者抢先清除标记, 多出的一次 post 只会造成一次空转
+            self->sleeping.store(false, std::memory_order_relaxed);
+            m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+            return request;
         }
-        T* request = m_workqueue.front();
-        m_workqueue.pop_front();
-        m_queuelocker.unlock();
+        self->wakeup.wait();
+        self->sleeping.store(false, std::memory_order_relaxed);
+        m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return nullptr;
+}
+
+template<typename T>
+void threadpool<T>::run(worker_slot* self){
+    while(m_run){
+        T* request = take(self);
         if(!request) continue;
         request->process();
     }
@@ -0,0 +1,63 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 分层时间轮, 用于连接超时管理
+ * @Date: 2026-10-17 14:10:37
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 14:10:37
+ */
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstdint>
+
+/**
+ * 侵入式定时器节点, 由使用者(如 http_conn)持有, 时间轮不分配内存
+ */
+struct timer_node{
+    timer_node* prev;
+    timer_node* next;
+    uint64_t expire;                // 到期的 tick
+    void* data;                     // 使用者数据
+
+    bool linked() const { return prev != nullptr; }
+};
+
+/**
+ * 四层时间轮: 第 0 层 256 个槽, 其余每层 64 个槽
+ * tick 为 100ms 时第 0 层覆盖 25.6s, 四层共覆盖约 77 天, 更长的超时按最大值处理
+ * 添加、删除均为 O(1), 推进时只在跨越上层槽位时把该槽位的节点重新分配到下层
+ * 非线程安全, 只能在所属 eventloop 线程中使用
+ */
+class timer_wheel{
+public:
+    timer_wheel(int tick_ms, uint64_t now_ms);
+
+    void add(timer_node* node, uint64_t timeout_ms);    // 添加或重置定时器
+    void del(timer_node* node);                         // 删除定时器, 未添加时无操作
+    timer_node* expire(uint64_t now_ms);                // 推进到 now_ms, 返回到期节点组成的单链表(以 next 相连)
+    int next_timeout(uint64_t now_ms) const;            // 到最近一个到期或下沉的 tick 的毫秒数, 无定时器时返回 -1
+    int size() const { return m_size; }
+
+private:
+    static const int LEVELS = 4;
+    static const int ROOT_BITS = 8;
+    static const int LEVEL_BITS = 6;
+    static const int ROOT_SIZE = 1 << ROOT_BITS;
+    static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+    static const uint64_t MAX_TICKS = (uint64_t)1 << (ROOT_BITS + (LEVELS - 1) * LEVEL_BITS);
+
+    void insert(timer_node* node);
+    void cascade(int level, int index);
+    static void list_init(timer_node* head);
+    static void list_append(timer_node* head, timer_node* node);
+
+private:
+    int m_tick_ms;
+    uint64_t m_current;                             // 当前 tick
+    int m_size;                                     // 定时器数量
+    timer_node m_root[ROOT_SIZE];                   // 第 0 层, 哨兵节点
+    timer_node m_levels[LEVELS - 1][LEVEL_SIZE];    // 第 1 ~ 3 层, 哨兵节点
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,133 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: io_uring 事件引擎: multishot accept、使用提供缓冲区环的 multishot recv、批量提交的 sendmsg,
+ *               直接使用系统调用, 不依赖 liburing
+ * @Date: 2026-10-17 22:31:05
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 22:31:05
+ */
+#ifndef URING_ENGINE_H
+#define URING_ENGINE_H
+
+#include "event_engine.h"
+#include "http_conn.h"
+#include "mpmc_queue.h"
+#include <linux/io_uring.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * 一次 io_uring_enter 同时提交上一轮产生的所有操作并等待完成事件, 稳定状态下每轮只有这一个系统调用:
+ *  - 监听 socket 上一个 multishot accept, 每个新连接一个完成事件
+ *  - 每个连接一个 multishot recv, 数据由内核放入提供缓冲区环中的缓冲区, 拷贝到读缓冲区后立即归还
+ *  - 响应队列整体作为一个 sendmsg 提交
+ *  - 工作线程处理完的连接放入无锁队列, 只有 reactor 正在睡眠时才写 eventfd 唤醒
+ * io_uring 没有 sendfile 操作, 使用该引擎时文件实体改为映射后与响应头一起 sendmsg
+ *
+ * 连接上仍有未完成的 recv/sendmsg 时不关闭描述符(内核可能还在访问缓冲区),
+ * 先 shutdown 使这些操作尽快结束, 最后一个完成事件到达后再释放连接并关闭描述符, 期间 fd 不会被复用
+ */
+class uring_engine : public event_engine{
+public:
+    explicit uring_engine(eventloop* loop);
+    ~uring_engine();
+
+    bool init(int listenfd, bool shared) override;
+    void add(http_conn* conn) override;
+    void close(http_conn* conn) override;
+    void resume(http_conn* conn) override;
+    int wait(int timeout_ms) override;
+    void handle_events() override;
+
+private:
+    static const unsigned SQ_ENTRIES = 1024;
+    static const unsigned CQ_ENTRIES = 8192;
+    static const unsigned BUFFER_NUMBER = 1024;     // 提供缓冲区个数, 必须是 2 的幂
+    static const unsigned BUFFER_SIZE = 4096;
+    static const unsigned BUFFER_GROUP = 0;
+
+    // 完成事件对应的操作, 与 fd 一起编码在 user_data 中
+    enum OP{
+        OP_ACCEPT = 1,
+        OP_RECV,
+        OP_SEND,
+        OP_WAKE,                                    // 读 eventfd
+        OP_CLOSE
+    };
+
+    struct send_state{
+        http_conn::send_op op;
+        struct msghdr msg;
+        send_state* next;                           // 空闲链表
+    };
+
+    // 连接在引擎中的状态, 以 fd 为下标
+    struct conn_state{
+        int inflight;                               // 未结束的 recv 与 sendmsg
+        bool recv_armed;                            // multishot recv 仍在进行
+        bool eof;                                   // 对端关闭或接收出错, 连接回到 reactor 后关闭
+        bool closing;                               // 等待 inflight 归零后关闭
+        int stash_head;                             // 尚未拷贝到读缓冲区的接收缓冲区链表, -1 为空
+        int stash_tail;
+        unsigned stash_off;                         // 链表头缓冲区中已拷贝的字节数
+        send_state* send;                           // 进行中的 sendmsg
+    };
+
+    io_uring_sqe* get_sqe(uint64_t user_data);
+    int enter(unsigned wait_nr, int timeout_ms);
+    unsigned cq_ready() const;
+    void handle_cqe(uint64_t user_data, int res, unsigned flags);
+    void arm_accept();
+    void arm_wake();
+    void arm_recv(int fd);
+    void rearm(int fd);
+    void on_recv(int fd, int res, unsigned flags);
+    void on_send(int fd, int res);
+    void on_resume(http_conn* conn);
+    void proceed(int fd);
+    int absorb(int fd);
+    void start_send(int fd);
+    void finish_close(int fd);
+    void recycle(int bid);
+
+private:
+    int m_listenfd;
+    int m_ringfd;
+
+    // 提交队列
+    unsigned* m_sq_head;
+    unsigned* m_sq_tail;
+    unsigned m_sq_mask;
+    unsigned m_sq_entries;
+    unsigned m_sq_local_tail;                       // 已填写但尚未发布给内核的位置
+    io_uring_sqe* m_sqes;
+    // 完成队列
+    unsigned* m_cq_head;
+    unsigned* m_cq_tail;
+    unsigned m_cq_mask;
+    io_uring_cqe* m_cqes;
+    void* m_ring_mem;
+    size_t m_ring_size;
+    size_t m_sqes_size;
+
+    // 提供缓冲区环
+    io_uring_buf_ring* m_buf_ring;
+    char* m_buffers;
+    unsigned short m_buf_tail;
+    unsigned m_buf_free;                            // 环中可用的缓冲区数
+    int m_buf_next[BUFFER_NUMBER];                  // 暂存链表
+    unsigned m_buf_len[BUFFER_NUMBER];
+
+    conn_state* m_states;
+    send_state* m_free_sends;
+    std::vector<int> m_starved;                     // recv 因缓冲区耗尽而结束的连接
+
+    int m_wakefd;
+    uint64_t m_wake_value;
+    mpmc_queue<http_conn*> m_resumed;               // 工作线程处理完的连接
+    std::atomic<bool> m_sleeping;                   // reactor 是否(准备)阻塞在 io_uring_enter 中
+};
+
+#endif // URING_ENGINE_H
@@ -0,0 +1,271 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 协程事件引擎实现
+ * @Date: 2026-10-17 23:48:12
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 23:48:12
+ */
+#include "coro_engine.h"
+
+#ifdef NK_COROUTINE
+
+#include "eventloop.h"
+
+/**
+ * 一次非阻塞操作: await_ready 中直接执行, 没有返回 EAGAIN 时不挂起;
+ * 否则挂起协程等待 events, 恢复后在 await_resume 中重试一次. 重试仍可能得到 EAGAIN(事件不是这个方向的),
+ * 调用者循环 co_await 直到不是 EAGAIN. 操作自己统计系统调用次数
+ */
+template<typename OP>
+struct coro_engine::io_awaitable{
+    conn_state& st;
+    unsigned events;
+    OP op;
+    ssize_t result;
+    bool suspended;
+
+    bool await_ready(){
+        suspended = false;
+        result = op();
+        return result >= 0 || errno != EAGAIN;
+    }
+    void await_suspend(std::coroutine_handle<> h){
+        st.waiter = h;
+        st.events = events;
+        suspended = true;
+    }
+    ssize_t await_resume(){
+        if(suspended){
+            result = op();
+        }
+        return result;
+    }
+};
+
+/**
+ * 主动让出: 协程不等待事件, 放入 m_ready, 下一次 handle_events 处理完本轮事件后恢复
+ */
+struct coro_engine::yield_awaitable{
+    coro_engine& engine;
+    conn_state& st;
+    int fd;
+
+    bool await_ready(){ return false; }
+    void await_suspend(std::coroutine_handle<> h){
+        st.waiter = h;
+        st.events = 0;
+        engine.m_ready.push_back(fd);
+    }
+    void await_resume(){}
+};
+
+template<typename OP>
+coro_engine::io_awaitable<OP> coro_engine::make_io(coro_engine::conn_state& st, unsigned events, OP op){
+    return {st, events, op, 0, false};
+}
+
+coro_engine::coro_engine(eventloop* loop) : epoll_engine(loop), m_states(nullptr){
+}
+
+coro_engine::~coro_engine(){
+    if(m_states){
+        for(int fd = 0; fd < MAX_FD; fd++){
+            if(m_states[fd].coro) m_states[fd].coro.destroy();
+        }
+        free(m_states);
+    }
+}
+
+bool coro_engine::init(int listenfd, bool shared){
+    m_states = (conn_state*)calloc(MAX_FD, sizeof(conn_state));
+    if(!m_states) return false;
+    return epoll_engine::init(listenfd, shared);
+}
+
+/**
+ * @brief 创建连接的协程并以边沿触发注册读写事件; 协程等到第一个事件才开始执行,
+ *        注册时已经可读的连接会立即得到一个事件
+ */
+void coro_engine::add(http_conn* conn){
+    int fd = conn->m_sockfd;
+    conn_state& st = m_states[fd];
+    st.coro = serve(conn).handle;
+    st.waiter = st.coro;
+    st.events = EPOLLIN;
+
+    epoll_event event;
+    event.data.fd = fd;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    epoll_ctl(m_epollfd, EPOLL_CTL_ADD, fd, &event);
+    metrics::add(METRIC_SYSCALLS);
+}
+
+/**
+ * @brief 销毁连接的协程(挂起中或已结束), 之后与 epoll 引擎相同
+ */
+void coro_engine::close(http_conn* conn){
+    conn_state& st = m_states[conn->m_sockfd];
+    if(st.coro){
+        st.coro.destroy();
+        st.coro = nullptr;
+    }
+    st.waiter = nullptr;
+    epoll_engine::close(conn);
+}
+
+/**
+ * @brief 协程引擎不使用线程池, 连接不会经过 process(), 不会调用到这里
+ */
+void coro_engine::resume(http_conn* conn){
+    (void)conn;
+}
+
+/**
+ * @brief 连接的协程: 接收 -> 解析并生成响应 -> 发送, 循环直到出错、对端关闭或响应要求关闭连接
+ *        每次挂起前按所处阶段重置定时器, 与线程池模式的超时规则相同
+ * @param {http_conn*} conn
+ */
+coro_engine::task coro_engine::serve(http_conn* conn){
+    int fd = conn->m_sockfd;
+    conn_state& st = m_states[fd];
+    http_conn::send_op op;
+    bool need_data = true;
+    while(true){
+        if(conn->body_streaming()){
+            // 请求体直接 splice 到临时文件, 接收完后再交给 process_requests 生成响应
+            ssize_t n;
+            do{
+                m_loop->refresh_timer(conn);
+                n = co_await make_io(st, EPOLLIN, [conn](){ return conn->splice_body(); });
+            }while(n < 0 && errno == EAGAIN);
+            if(n <= 0) co_return;
+            if(conn->body_streaming()) continue;
+        }else if(need_data){
+            // 单个请求超过读缓冲区上限
+            if(!conn->reserve_read()) co_return;
+            char* buf = conn->m_read_buf.data() + conn->m_read_idx;
+            size_t len = conn->m_read_buf.capacity() - conn->m_read_idx;
+            ssize_t n;
+            do{
+                m_loop->refresh_timer(conn);
+                n = co_await make_io(st, EPOLLIN, [fd, buf, len](){
+                    metrics::add(METRIC_SYSCALLS);
+                    return recv(fd, buf, len, 0);
+                });
+            }while(n < 0 && errno == EAGAIN);
+            if(n <= 0) co_return;
+            conn->m_read_idx += n;
+        }
+
+        if(!conn->process_requests()) co_return;
+        if(conn->m_response_count == 0){
+            // 请求还不完整
+            need_data = true;
+            continue;
+        }
+
+        off_t sent = 0;
+        while(conn->prepare_send(op)){
+            if(sent >= http_conn::SEND_WINDOW){
+                // 本轮已用完发送窗口, 让出 reactor, socket 仍可写, 恢复后直接继续发送
+                co_await yield_awaitable{*this, st, fd};
+                sent = 0;
+            }
+            m_loop->refresh_timer(conn);
+            ssize_t n;
+            if(op.file_fd != -1){
+                off_t offset = op.file_offset;
+                do{
+                    n = co_await make_io(st, EPOLLOUT, [fd, &op, &offset](){
+                        metrics::add(METRIC_SYSCALLS);
+                        return sendfile(fd, op.file_fd, &offset, op.file_len);
+                    });
+                }while(n < 0 && errno == EAGAIN);
+                // n == 0: 文件在发送过程中被截断
+                if(n <= 0) co_return;
+            }else{
+                struct msghdr msg;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = op.iov;
+                msg.msg_iovlen = op.iov_count;
+                int flags = op.more ? MSG_MORE : 0;
+                do{
+                    n = co_await make_io(st, EPOLLOUT, [fd, &msg, flags](){
+                        metrics::add(METRIC_SYSCALLS);
+                        return sendmsg(fd, &msg, flags);
+                    });
+                }while(n < 0 && errno == EAGAIN);
+                if(n < 0) co_return;
+            }
+            metrics::add(METRIC_BYTES_SENT, n);
+            sent += n;
+            if(!conn->advance(n)) co_return;
+        }
+        conn->finish_write();
+        // 读缓冲区中还有流水线请求时先处理, 不完整时再接收
+        need_data = !conn->has_pending_request();
+    }
+}
+
+/**
+ * @brief 恢复等待中的协程, 协程执行结束(出错、对端关闭或响应要求关闭)时关闭连接
+ * @param {http_conn*} conn
+ * @param {conn_state&} st
+ */
+void coro_engine::run(http_conn* conn, conn_state& st){
+    std::coroutine_handle<> h = st.waiter;
+    st.waiter = nullptr;
+    h.resume();
+    if(st.coro.done()){
+        m_loop->close_conn(conn);
+    }
+}
+
+/**
+ * @brief 有让出的协程时不阻塞等待, 处理完就绪的事件后立即恢复它们
+ */
+int coro_engine::wait(int timeout_ms){
+    return epoll_engine::wait(m_ready.empty() ? timeout_ms : 0);
+}
+
+/**
+ * @brief 恢复上一轮让出的协程; 本轮中再次让出的放入下一批.
+ *        让出期间连接可能已超时关闭, fd 甚至已被新连接复用, 只恢复仍处于让出状态的协程
+ */
+void coro_engine::run_ready(){
+    m_running.swap(m_ready);
+    for(int fd : m_running){
+        http_conn* conn = m_loop->find_conn(fd);
+        conn_state& st = m_states[fd];
+        if(conn && st.waiter && st.events == 0){
+            run(conn, st);
+        }
+    }
+    m_running.clear();
+}
+
+void coro_engine::handle_events(){
+    for(int i = 0; i < m_event_number; i++){
+        int sockfd = m_events[i].data.fd;
+        if(sockfd == m_listenfd){
+            handle_accept();
+            continue;
+        }
+        // 本轮中已被关闭的连接
+        http_conn* conn = m_loop->find_conn(sockfd);
+        if(!conn) continue;
+        conn_state& st = m_states[sockfd];
+        unsigned events = m_events[i].events;
+        if(events & (EPOLLHUP | EPOLLERR)){
+            m_loop->close_conn(conn);
+        }else if(st.waiter && st.events && (events & (st.events | EPOLLRDHUP))){
+            // 对端半关闭时仍可能有未读的请求, 由 recv 读到 EOF 后结束协程; 让出的协程由 run_ready() 恢复
+            run(conn, st);
+        }
+    }
+    m_event_number = 0;
+    run_ready();
+}
+
+#endif // NK_COROUTINE
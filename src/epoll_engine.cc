@@ -0,0 +1,187 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: epoll 事件引擎实现
+ * @Date: 2026-10-17 22:31:05
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 22:31:05
+ */
+#include "epoll_engine.h"
+#include "eventloop.h"
+
+/**
+ * @brief 添加需要监听的 socket 添加到 epoll 中; 监听 socket 与连接都在创建时设置了非阻塞
+ * @param {int} epollfd epoll标识符
+ * @param {int} socketfd 文件描述符
+ * @param {int} ev 事件标记
+ * @return {bool} 是否成功
+ */
+static bool addfd(int epollfd, int socketfd, int ev){
+    epoll_event event;
+    event.data.fd = socketfd;
+    event.events = ev;
+    metrics::add(METRIC_SYSCALLS);
+    return epoll_ctl(epollfd, EPOLL_CTL_ADD, socketfd, &event) == 0;
+}
+
+/**
+ * @brief 移除 socket 描述符
+ * @param {int} epollfd epoll标识符
+ * @param {int} socketfd socket 描述符
+ */
+static void removefd(int epollfd, int socketfd){
+    epoll_ctl(epollfd, EPOLL_CTL_DEL, socketfd, 0);
+    close(socketfd);
+    metrics::add(METRIC_SYSCALLS, 2);
+}
+
+/**
+ * @brief 修改 socket 状态标记
+ * @param {int} epollfd epoll标识符
+ * @param {int} socketfd socked 标识符
+ * @param {int} ev 状态标记
+ */
+static void modfd(int epollfd, int socketfd, int ev){
+    epoll_event event;
+    event.data.fd = socketfd;
+    event.events = ev | EPOLLET | EPOLLONESHOT | EPOLLRDHUP;
+    epoll_ctl(epollfd, EPOLL_CTL_MOD, socketfd, &event);
+    metrics::add(METRIC_SYSCALLS);
+}
+
+epoll_engine::epoll_engine(eventloop* loop)
+        : event_engine(loop), m_epollfd(-1), m_listenfd(-1), m_event_number(0){
+}
+
+epoll_engine::~epoll_engine(){
+    if(m_epollfd != -1) ::close(m_epollfd);
+}
+
+bool epoll_engine::init(int listenfd, bool shared){
+    m_epollfd = epoll_create(5);
+    if(m_epollfd < 0) return false;
+    m_listenfd = listenfd;
+    // 水平触发, 一次唤醒没有取完的连接下次 epoll_wait 继续返回;
+    // 共享的监听 socket 使用 EPOLLEXCLUSIVE, 新连接只唤醒其中一个(或少数几个)阻塞的循环, 避免惊群
+    return addfd(m_epollfd, m_listenfd, shared ? EPOLLIN | EPOLLEXCLUSIVE : EPOLLIN);
+}
+
+void epoll_engine::add(http_conn* conn){
+    // EPOLLONESHOT 保证 socket 只被一个线程处理
+    addfd(m_epollfd, conn->m_sockfd, EPOLLIN | EPOLLRDHUP | EPOLLONESHOT);
+}
+
+void epoll_engine::close(http_conn* conn){
+    int sockfd = conn->m_sockfd;
+    m_loop->free_conn(conn);
+    removefd(m_epollfd, sockfd);
+}
+
+/**
+ * @brief 有响应时等待 EPOLLOUT 发送, 否则继续等待请求数据;
+ *        先清除标记再重新注册事件, 注册后连接可能立刻再次进入线程池;
+ *        清除标记到重新注册之间持有 m_timeout_lock, 否则连接可能被超时关闭, fd 被新连接复用后 modfd 作用于新连接;
+ *        重新注册后连接可能被关闭并归还, 之后不能再访问连接对象
+ */
+void epoll_engine::resume(http_conn* conn){
+    bool write = conn->m_response_count > 0;
+    int sockfd = conn->m_sockfd;
+    m_loop->m_timeout_lock.lock();
+    conn->m_in_pool.store(false, std::memory_order_release);
+    modfd(m_epollfd, sockfd, write ? EPOLLOUT : EPOLLIN);
+    m_loop->m_timeout_lock.unlock();
+}
+
+int epoll_engine::wait(int timeout_ms){
+    // m_epollfd : epoll 描述符
+    // m_events : 记录事件的具体信息，包括描述符、结果等
+    // MAX_EVENT_NUMBER - 1 : 最大事件数量
+    // timeout : 由时间轮决定, 没有定时器时为 -1 一直等待
+    m_event_number = epoll_wait(m_epollfd, m_events, MAX_EVENT_NUMBER - 1, timeout_ms);
+    metrics::add(METRIC_SYSCALLS);
+    if(m_event_number < 0){
+        if(errno != EINTR) return -1;
+        m_event_number = 0;
+    }
+    return m_event_number;
+}
+
+/**
+ * @brief 接受队列中的所有新连接, 直到 EAGAIN; 新连接注册到本循环的 epoll 中
+ * @return None
+ */
+void epoll_engine::handle_accept(){
+    while(true){
+        struct sockaddr_in client_addr;
+        socklen_t client_addrlen = sizeof(client_addr);
+
+        // 直接得到非阻塞的连接, 不需要再 fcntl
+        int connfd = accept4(m_listenfd, (struct sockaddr*)&client_addr, &client_addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        metrics::add(METRIC_SYSCALLS);
+        if(connfd < 0){
+            // 握手完成后又被对端重置的连接直接跳过
+            if(errno == ECONNABORTED || errno == EINTR) continue;
+            // EAGAIN: 队列已取空; 其他错误(如描述符耗尽)等下一次唤醒重试
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                LOG_WARN("accept failed, errno: %d", errno);
+            }
+            return;
+        }
+        m_loop->add_conn(connfd, client_addr);
+    }
+}
+
+/**
+ * @brief 发送响应队列, 未发完时等待下一个 EPOLLOUT
+ * @param {http_conn*} conn
+ */
+void epoll_engine::handle_write(http_conn* conn){
+    if(!conn->write()){
+        m_loop->close_conn(conn);
+    }else if(conn->m_response_count > 0){
+        // TCP写缓存满了
+        // 等待下一个 EPOLLOUT 事件
+        modfd(m_epollfd, conn->m_sockfd, EPOLLOUT);
+        m_loop->refresh_timer(conn);
+    }else if(conn->has_pending_request()){
+        // 响应发完, 读缓冲区中还有流水线请求, 不等待新的 EPOLLIN 直接处理
+        m_loop->dispatch(conn);
+    }else{
+        modfd(m_epollfd, conn->m_sockfd, EPOLLIN);
+        m_loop->refresh_timer(conn);
+    }
+}
+
+void epoll_engine::handle_events(){
+    for(int i = 0; i < m_event_number; i++){
+        // client 连接的 socket
+        int sockfd = m_events[i].data.fd;
+        if(sockfd == m_listenfd){
+            handle_accept();
+            continue;
+        }
+        // 本轮中已被超时关闭的连接
+        http_conn* conn = m_loop->find_conn(sockfd);
+        if(!conn) continue;
+        if(m_events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)){
+            m_loop->close_conn(conn);
+        }else if(m_events[i].events & EPOLLIN){
+            LOG_DEBUG("发生读事件, fd %d", sockfd);
+            if(!conn->read()){
+                m_loop->close_conn(conn);
+            }else if(conn->body_streaming()){
+                // 请求体直接写入临时文件, 还未接收完, 不需要交给线程池
+                modfd(m_epollfd, sockfd, EPOLLIN);
+                m_loop->refresh_timer(conn);
+            }else{
+                // ?放入待处理队列
+                LOG_DEBUG("读事件进入待处理队列, fd %d", sockfd);
+                m_loop->dispatch(conn);
+            }
+        }else if(m_events[i].events & EPOLLOUT){
+            LOG_DEBUG("发生写事件, fd %d", sockfd);
+            handle_write(conn);
+        }
+    }
+    m_event_number = 0;
+}
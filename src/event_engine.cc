@@ -0,0 +1,30 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 事件引擎的创建
+ * @Date: 2026-10-17 22:31:05
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 22:31:05
+ */
+#include "event_engine.h"
+#include "epoll_engine.h"
+#include "uring_engine.h"
+#include "coro_engine.h"
+
+event_engine* event_engine::create(ENGINE_TYPE type, eventloop* loop){
+    switch(type){
+        case ENGINE_URING: return new uring_engine(loop);
+#ifdef NK_COROUTINE
+        case ENGINE_CORO: return new coro_engine(loop);
+#endif
+        default: return new epoll_engine(loop);
+    }
+}
+
+const char* event_engine::name(ENGINE_TYPE type){
+    switch(type){
+        case ENGINE_URING: return "io_uring";
+        case ENGINE_CORO: return "coroutine";
+        default: return "epoll";
+    }
+}
@@ -0,0 +1,245 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: Reactor 事件循环实现
+ * @Date: 2026-10-17 10:02:11
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 10:02:11
+ */
+#include "eventloop.h"
+#include <ctime>
+
+eventloop::eventloop(int listenfd, bool shared, threadpool<http_conn>* pool, const int* timeouts,
+                     ENGINE_TYPE engine)
+        : m_listenfd(listenfd), m_shared(shared), m_engine_type(engine), m_engine(nullptr),
+          m_fds(MAX_FD), m_pool(pool), m_thread(0), m_started(false),
+          m_timers(TIMER_TICK_MS, now_ms()){
+    for(int i = 0; i < http_conn::TIMEOUT_NUMBER; i++){
+        m_timeouts[i] = timeouts[i];
+    }
+}
+
+/**
+ * @brief 当前单调时间, CLOCK_MONOTONIC_COARSE 走 vDSO, 不产生系统调用
+ * @return {uint64_t} 毫秒
+ */
+uint64_t eventloop::now_ms(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+eventloop::~eventloop(){
+    delete m_engine;
+    if(m_listenfd != -1 && !m_shared) close(m_listenfd);
+}
+
+/**
+ * @brief 创建监听 socket; 非阻塞, 引擎在一次唤醒中可以接受队列中的所有连接
+ * @param {int} port 监听端口
+ * @param {int} backlog 已完成握手、等待 accept 的连接队列长度
+ * @param {bool} reuse_port 是否开启 SO_REUSEPORT, 多个循环各自 bind 同一端口
+ * @return {int} 监听 socket, 失败返回 -1
+ */
+int eventloop::open_listener(int port, int backlog, bool reuse_port){
+    // 监听 socket 描述符
+    int listenfd = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listenfd < 0) return -1;
+
+    // 绑定
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);     // host to net short
+
+    // 设置端口复用
+    int reuse = 1;
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    // 多个 reactor 各自 bind 同一端口, 由内核按四元组哈希分发新连接
+    if((reuse_port && setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) != 0)
+       || bind(listenfd, (struct sockaddr*) &address, sizeof(address)) != 0
+       || listen(listenfd, backlog) != 0){
+        int saved = errno;
+        close(listenfd);
+        errno = saved;
+        return -1;
+    }
+    return listenfd;
+}
+
+/**
+ * @brief 创建事件引擎, io_uring 不可用(内核过旧或被禁用)时退回 epoll
+ * @return {bool} 是否成功
+ */
+bool eventloop::init(){
+    m_engine = event_engine::create(m_engine_type, this);
+    if(m_engine->init(m_listenfd, m_shared)) return true;
+    delete m_engine;
+    m_engine = nullptr;
+    if(m_engine_type == ENGINE_EPOLL) return false;
+
+    LOG_WARN("Init %s engine failed, errno: %d, use epoll", event_engine::name(m_engine_type), errno);
+    m_engine_type = ENGINE_EPOLL;
+    m_engine = event_engine::create(m_engine_type, this);
+    return m_engine->init(m_listenfd, m_shared);
+}
+
+/**
+ * @brief 引擎接受的新连接, 初始化后加入本循环的引擎
+ * @param {int} connfd
+ * @param {sockaddr_in&} addr client 地址
+ * @return None
+ */
+void eventloop::add_conn(int connfd, const sockaddr_in& addr){
+    LOG_DEBUG("Client socket fd is: %d", connfd);
+    if(connfd >= MAX_FD || http_conn::m_usercount >= MAX_FD){
+        LOG_WARN("The connection pool is full and the server is busy");
+        close(connfd);
+        metrics::add(METRIC_SYSCALLS);
+        return;
+    }
+    http_conn* conn = m_conns.create();
+    if(!conn || !m_fds.insert(connfd, conn)){
+        LOG_WARN("Allocate connection failed, close fd %d", connfd);
+        if(conn) m_conns.destroy(conn);
+        close(connfd);
+        metrics::add(METRIC_SYSCALLS);
+        return;
+    }
+    metrics::add(METRIC_ACCEPTS);
+    conn->init(connfd, addr, m_engine);
+    m_engine->add(conn);
+    // 新连接从 accept 开始计算读取头部的时间, 防止连接后不发送数据
+    arm_timer(conn, http_conn::TIMEOUT_HEADER);
+}
+
+/**
+ * @brief 引擎确认连接上没有未完成的操作后调用, 之后该 fd 可以被新连接复用
+ * @param {http_conn*} conn
+ */
+void eventloop::free_conn(http_conn* conn){
+    m_fds.erase(conn->m_sockfd);
+    conn->release();
+    m_conns.destroy(conn);
+}
+
+/**
+ * @brief 把连接交给线程池处理
+ * @param {http_conn*} conn
+ * @return {bool} 请求队列已满时关闭连接并返回 false
+ */
+bool eventloop::dispatch(http_conn* conn){
+    refresh_timer(conn);
+    conn->m_in_pool.store(true, std::memory_order_relaxed);
+    conn->m_enqueue_ns = metrics::now_ns();
+    if(!m_pool->append(conn)){
+        // 请求队列已满, 连接无法被处理, 直接关闭避免其永远等待
+        LOG_WARN("The request queue is full, close fd %d", conn->m_sockfd);
+        metrics::add(METRIC_QUEUE_FULL);
+        conn->m_in_pool.store(false, std::memory_order_relaxed);
+        close_conn(conn);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 关闭连接, 所有关闭都在 reactor 线程中进行, 保证定时器与连接同步移除
+ * @param {http_conn*} conn
+ */
+void eventloop::close_conn(http_conn* conn){
+    m_timers.del(&conn->m_timer);
+    conn->close_conn();
+}
+
+void eventloop::arm_timer(http_conn* conn, http_conn::TIMEOUT_TYPE type){
+    conn->m_timeout_type = type;
+    if(m_timeouts[type] > 0){
+        m_timers.add(&conn->m_timer, m_timeouts[type]);
+    }else{
+        m_timers.del(&conn->m_timer);
+    }
+}
+
+/**
+ * @brief 连接阶段变化时重新计时;
+ *        读头部、读请求体的超时从阶段开始计算, 不因收到数据而延长;
+ *        发送阶段与写入临时文件的大请求体每次有进展都重新计时
+ * @param {http_conn*} conn
+ */
+void eventloop::refresh_timer(http_conn* conn){
+    http_conn::TIMEOUT_TYPE type = conn->timeout_type();
+    if(type != conn->m_timeout_type || type == http_conn::TIMEOUT_WRITE ||
+            (type == http_conn::TIMEOUT_BODY && conn->m_body_fd != -1)){
+        arm_timer(conn, type);
+    }
+}
+
+/**
+ * @brief 处理到期的定时器, 正在线程池中处理的连接推迟一个 tick 再检查;
+ *        检查与关闭持有 m_timeout_lock, 与工作线程交还连接(epoll_engine::resume())互斥
+ */
+void eventloop::handle_timeout(){
+    timer_node* node = m_timers.expire(now_ms());
+    if(!node) return;
+    m_timeout_lock.lock();
+    while(node){
+        timer_node* next = node->next;
+        http_conn* conn = (http_conn*) node->data;
+        if(conn->m_in_pool.load(std::memory_order_acquire)){
+            m_timers.add(node, TIMER_TICK_MS);
+        }else{
+            LOG_DEBUG("Connection timeout, close fd %d", conn->m_sockfd);
+            metrics::add(METRIC_TIMEOUTS);
+            close_conn(conn);
+        }
+        node = next;
+    }
+    m_timeout_lock.unlock();
+}
+
+/**
+ * @brief 事件循环
+ * @return None
+ */
+void eventloop::loop(){
+    while(true){
+        // 超时由时间轮决定, 没有定时器时为 -1 一直等待
+        LOG_DEBUG("Waiting Connection...");
+        if(m_engine->wait(m_timers.next_timeout(now_ms())) < 0){
+            LOG_ERROR("%s FAILURE, errno: %d", event_engine::name(m_engine_type), errno);
+            break;
+        }
+
+        // 先推进时间轮, 之后添加的定时器都以本次唤醒的时间为起点
+        handle_timeout();
+
+        m_engine->handle_events();
+    }
+}
+
+void* eventloop::worker(void* arg){
+    eventloop* el = (eventloop*) arg;
+    el->loop();
+    return el;
+}
+
+/**
+ * @brief 在独立线程中运行事件循环
+ * @return {bool} 线程是否创建成功
+ */
+bool eventloop::start(){
+    if(pthread_create(&m_thread, nullptr, worker, this) != 0){
+        return false;
+    }
+    m_started = true;
+    return true;
+}
+
+void eventloop::join(){
+    if(m_started){
+        pthread_join(m_thread, nullptr);
+        m_started = false;
+    }
+}
@@ -0,0 +1,529 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 静态文件缓存实现
+ * @Date: 2026-10-17 15:40:12
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 15:40:12
+ */
+#include "file_cache.h"
+#include "http_response.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <functional>
+#include <zlib.h>
+
+int file_cache::m_max_age = 0;
+
+file_cache::file_cache(size_t max_entries, size_t max_bytes, bool map_files)
+        : m_max_entries(max_entries / SHARD_NUMBER + 1), m_max_bytes(max_bytes / SHARD_NUMBER + 1),
+          m_map_files(map_files), m_inotifyfd(-1), m_watcher(0){
+    for(int i = 0; i < SHARD_NUMBER; i++){
+        m_shards[i].bytes = 0;
+        m_shards[i].generation = 0;
+    }
+}
+
+file_cache::~file_cache(){
+    if(m_inotifyfd != -1){
+        pthread_cancel(m_watcher);
+        pthread_join(m_watcher, nullptr);
+        close(m_inotifyfd);
+    }
+    clear();
+}
+
+/**
+ * 扩展名(小写)到 Content-Type, 按扩展名排序以便二分查找
+ */
+struct mime_type{
+    const char* extension;
+    const char* mime;
+};
+
+static const mime_type MIME_TABLE[] = {
+    {"avif",  "image/avif"},
+    {"bmp",   "image/bmp"},
+    {"css",   "text/css"},
+    {"csv",   "text/csv"},
+    {"gif",   "image/gif"},
+    {"gz",    "application/gzip"},
+    {"htm",   "text/html"},
+    {"html",  "text/html"},
+    {"ico",   "image/x-icon"},
+    {"jpeg",  "image/jpeg"},
+    {"jpg",   "image/jpeg"},
+    {"js",    "application/javascript"},
+    {"json",  "application/json"},
+    {"map",   "application/json"},
+    {"md",    "text/markdown"},
+    {"mjs",   "application/javascript"},
+    {"mp3",   "audio/mpeg"},
+    {"mp4",   "video/mp4"},
+    {"ogg",   "audio/ogg"},
+    {"otf",   "font/otf"},
+    {"pdf",   "application/pdf"},
+    {"png",   "image/png"},
+    {"svg",   "image/svg+xml"},
+    {"tar",   "application/x-tar"},
+    {"ttf",   "font/ttf"},
+    {"txt",   "text/plain"},
+    {"wasm",  "application/wasm"},
+    {"wav",   "audio/wav"},
+    {"webm",  "video/webm"},
+    {"webp",  "image/webp"},
+    {"woff",  "font/woff"},
+    {"woff2", "font/woff2"},
+    {"xml",   "application/xml"},
+    {"zip",   "application/zip"},
+};
+
+/**
+ * @brief 根据扩展名得到 Content-Type, 不认识的扩展名按二进制数据处理
+ * @param {char*} path 文件路径
+ * @return {char*} Content-Type
+ */
+const char* file_cache::content_type(const char* path){
+    const char* name = strrchr(path, '/');
+    const char* extension = strrchr(name ? name : path, '.');
+    if(extension != NULL){
+        extension++;
+        int low = 0, high = sizeof(MIME_TABLE) / sizeof(MIME_TABLE[0]) - 1;
+        while(low <= high){
+            int mid = (low + high) / 2;
+            int cmp = strcasecmp(extension, MIME_TABLE[mid].extension);
+            if(cmp == 0) return MIME_TABLE[mid].mime;
+            if(cmp < 0) high = mid - 1;
+            else low = mid + 1;
+        }
+    }
+    return "application/octet-stream";
+}
+
+file_entry* file_cache::load(const char* path, bool map_file, int& err){
+    // O_NONBLOCK: DOC_ROOT 下的 FIFO 没有写端时 open 会一直阻塞工作线程; 对普通文件的读取没有影响
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if(fd < 0){
+        err = errno == ENOENT || errno == ENOTDIR ? ENOENT : (errno == EACCES ? EACCES : errno);
+        return nullptr;
+    }
+    file_entry* entry = new file_entry();
+    if(fstat(fd, &entry->st) < 0){
+        err = errno;
+        close(fd);
+        delete entry;
+        return nullptr;
+    }
+    // 禁止访问
+    if(!(entry->st.st_mode & S_IROTH)){
+        err = EACCES;
+        close(fd);
+        delete entry;
+        return nullptr;
+    }
+    if(S_ISDIR(entry->st.st_mode)){
+        err = EISDIR;
+        close(fd);
+        delete entry;
+        return nullptr;
+    }
+    // FIFO、设备、socket 等不是静态文件
+    if(!S_ISREG(entry->st.st_mode)){
+        err = EACCES;
+        close(fd);
+        delete entry;
+        return nullptr;
+    }
+
+    entry->fd = fd;
+    entry->address = nullptr;
+    if(map_file){
+        if(entry->st.st_size > 0){
+            void* address = mmap(0, entry->st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(address == MAP_FAILED){
+                err = errno;
+                close(fd);
+                delete entry;
+                return nullptr;
+            }
+            entry->address = (char*)address;
+        }
+        close(fd);
+        entry->fd = -1;
+    }
+
+    entry->path = path;
+    entry->mime = content_type(path);
+    entry->compressible = compressible(entry->mime.c_str()) && entry->st.st_size > 0;
+    entry->cached = false;
+    entry->gzip = nullptr;
+    entry->validators = validators(entry->st, entry->mime.c_str(), false);
+    char buf[256];
+    // Range 只按原始内容计算, gzip 版本不带 Accept-Ranges
+    snprintf(buf, sizeof(buf), "Content-Length: %ld\r\nContent-Type: %s\r\nAccept-Ranges: bytes\r\n",
+             (long)entry->st.st_size, entry->mime.c_str());
+    entry->headers = buf + entry->validators;
+    entry->refcount.store(1, std::memory_order_relaxed);
+    return entry;
+}
+
+/**
+ * @brief 文本类文件才值得压缩, 图片等二进制格式本身已压缩
+ * @param {char*} mime Content-Type
+ * @return {bool}
+ */
+bool file_cache::compressible(const char* mime){
+    static const char* types[] = {
+        "application/javascript", "application/json", "application/xml", "image/svg+xml"
+    };
+    if(strncmp(mime, "text/", 5) == 0) return true;
+    for(const char* type : types){
+        if(strcmp(mime, type) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 生成 gzip 版本: 压缩后的内容放入 memfd, 可以像普通文件一样 sendfile 或 mmap
+ * @param {file_entry*} entry
+ * @return {file_variant*} 压缩失败或没有变小时返回 nullptr
+ */
+file_variant* file_cache::compress(file_entry* entry){
+    off_t size = entry->st.st_size;
+    std::string input;
+    const char* data = entry->address;
+    if(!data){
+        input.resize(size);
+        off_t done = 0;
+        while(done < size){
+            ssize_t n = pread(entry->fd, &input[done], size - done, done);
+            if(n <= 0) return nullptr;
+            done += n;
+        }
+        data = input.data();
+    }
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // windowBits 15 + 16 输出 gzip 格式
+    if(deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK){
+        return nullptr;
+    }
+    std::string output;
+    output.resize(deflateBound(&zs, size));
+    zs.next_in = (Bytef*)data;
+    zs.avail_in = size;
+    zs.next_out = (Bytef*)&output[0];
+    zs.avail_out = output.size();
+    int ret = deflate(&zs, Z_FINISH);
+    off_t gzip_size = zs.total_out;
+    deflateEnd(&zs);
+    if(ret != Z_STREAM_END || gzip_size >= size) return nullptr;
+
+    file_variant* variant = new file_variant();
+    variant->fd = -1;
+    variant->address = nullptr;
+    variant->size = gzip_size;
+    if(entry->address){
+        variant->address = (char*)malloc(gzip_size);
+        memcpy(variant->address, output.data(), gzip_size);
+    }else{
+        int fd = memfd_create("nk-gzip", MFD_CLOEXEC);
+        off_t done = 0;
+        while(fd >= 0 && done < gzip_size){
+            ssize_t n = ::write(fd, output.data() + done, gzip_size - done);
+            if(n <= 0){
+                close(fd);
+                fd = -1;
+            }
+            done += n;
+        }
+        if(fd < 0){
+            delete variant;
+            return nullptr;
+        }
+        variant->fd = fd;
+    }
+
+    variant->validators = validators(entry->st, entry->mime.c_str(), true);
+    char buf[192];
+    snprintf(buf, sizeof(buf), "Content-Length: %ld\r\nContent-Type: %s\r\nContent-Encoding: gzip\r\n",
+             (long)gzip_size, entry->mime.c_str());
+    variant->headers = buf + variant->validators;
+    return variant;
+}
+
+/**
+ * @brief 强 ETag: inode、长度与纳秒级修改时间的十六进制, 如 "\"1a2b-3e8-186f0c2d1e5a7b00\""
+ *        文件被替换或修改后至少有一项改变
+ * @param {char*} out 至少 MAX_ETAG_LEN 字节
+ * @return {char*} 写入的结尾
+ */
+char* file_cache::format_etag(char* out, const struct stat& st){
+    uint64_t mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    int len = snprintf(out, MAX_ETAG_LEN, "\"%llx-%llx-%llx\"",
+                       (unsigned long long)st.st_ino, (unsigned long long)st.st_size, (unsigned long long)mtime);
+    return out + len;
+}
+
+/**
+ * @brief 验证器相关的响应头: ETag、Last-Modified、Cache-Control, 200/206 与 304 响应都要带上;
+ *        可压缩的文件无论是否压缩发送都要带上 Vary, 使代理按 Accept-Encoding 区分缓存
+ * @param {stat&} st 文件状态
+ * @param {char*} mime Content-Type
+ * @param {bool} gzip gzip 版本, ETag 加上 "-gz" 与原文件区分
+ * @return {std::string}
+ */
+std::string file_cache::validators(const struct stat& st, const char* mime, bool gzip){
+    char etag[MAX_ETAG_LEN + 4];
+    char* end = format_etag(etag, st);
+    if(gzip){
+        memcpy(end - 1, "-gz\"", 4);
+        end += 3;
+    }
+    char date[http_response::MAX_DATE_LEN];
+    char* date_end = http_response::format_date(date, st.st_mtime);
+
+    std::string out = "ETag: ";
+    out.append(etag, end - etag);
+    out += "\r\nLast-Modified: ";
+    out.append(date, date_end - date);
+    out += "\r\n";
+    if(m_max_age > 0){
+        out += "Cache-Control: max-age=" + std::to_string(m_max_age) + "\r\n";
+    }else{
+        // 可以缓存, 但每次使用前都要用条件请求验证
+        out += "Cache-Control: no-cache\r\n";
+    }
+    if(compressible(mime)) out += "Vary: Accept-Encoding\r\n";
+    return out;
+}
+
+/**
+ * @brief 获取 gzip 版本, 每个缓存条目只压缩一次, 并发请求等待首次压缩完成
+ *        未缓存的条目每次请求都会重新打开, 为其压缩得不偿失, 直接返回 nullptr
+ * @param {file_entry*} entry
+ * @return {file_variant*} 没有可用的 gzip 版本时返回 nullptr
+ */
+const file_variant* file_cache::gzip_variant(file_entry* entry){
+    if(!entry->compressible || !entry->cached || entry->st.st_size > MAX_GZIP_SIZE) return nullptr;
+    std::call_once(entry->gzip_once, [entry](){ entry->gzip = compress(entry); });
+    return entry->gzip;
+}
+
+void file_cache::release(file_entry* entry){
+    if(entry->refcount.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    if(entry->address) munmap(entry->address, entry->st.st_size);
+    if(entry->fd != -1) close(entry->fd);
+    if(entry->gzip){
+        if(entry->gzip->fd != -1) close(entry->gzip->fd);
+        free(entry->gzip->address);
+        delete entry->gzip;
+    }
+    delete entry;
+}
+
+file_cache::shard& file_cache::shard_of(const std::string& path){
+    return m_shards[std::hash<std::string>()(path) % SHARD_NUMBER];
+}
+
+/**
+ * @brief 查找文件, 未命中时打开并加入缓存; 命中时不产生任何文件系统调用
+ * @param {char*} path 完整路径
+ * @param {int&} err 失败时的 errno
+ * @return {file_entry*} 调用者持有一个引用, 使用完后调用 release()
+ */
+file_entry* file_cache::acquire(const char* path, int& err){
+    // inotify 只能按 "目录/文件名" 使条目失效, 含 "//" "/./" "/../" 的路径不缓存
+    if(strstr(path, "//") || strstr(path, "/./") || strstr(path, "/../")){
+        return load(path, m_map_files, err);
+    }
+    std::string key(path);
+    shard& s = shard_of(key);
+
+    s.mutex.lock();
+    auto it = s.index.find(key);
+    if(it != s.index.end()){
+        file_entry* entry = *it->second;
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+        entry->refcount.fetch_add(1, std::memory_order_relaxed);
+        s.mutex.unlock();
+        return entry;
+    }
+    unsigned long generation = s.generation;
+    s.mutex.unlock();
+
+    file_entry* entry = load(path, m_map_files, err);
+    if(!entry) return nullptr;
+    return insert(key, entry, generation);
+}
+
+/**
+ * @brief 把新加载的文件加入缓存; 加载期间分片已失效(generation 变化)时不加入, 本次请求仍使用它
+ * @param {string&} key 完整路径
+ * @param {file_entry*} entry load() 的结果, 调用者持有一个引用
+ * @param {unsigned long} generation 未命中时分片的 generation
+ * @return {file_entry*} 其他线程已加入同一文件时释放 entry, 返回已缓存的条目
+ */
+file_entry* file_cache::insert(const std::string& key, file_entry* entry, unsigned long generation){
+    // 超过分片容量的大文件不缓存
+    if((size_t)entry->st.st_size > m_max_bytes) return entry;
+
+    shard& s = shard_of(key);
+    s.mutex.lock();
+    auto it = s.index.find(key);
+    if(it != s.index.end()){
+        // 其他线程已加载, 使用已缓存的条目
+        file_entry* cached = *it->second;
+        cached->refcount.fetch_add(1, std::memory_order_relaxed);
+        s.mutex.unlock();
+        release(entry);
+        return cached;
+    }
+    if(generation == s.generation){
+        entry->cached = true;
+        entry->refcount.fetch_add(1, std::memory_order_relaxed);     // 缓存持有的引用
+        s.lru.push_front(entry);
+        s.index[key] = s.lru.begin();
+        s.bytes += entry->st.st_size;
+        evict(s);
+    }
+    s.mutex.unlock();
+    return entry;
+}
+
+void file_cache::evict(shard& s){
+    while(!s.lru.empty() && (s.lru.size() > m_max_entries || s.bytes > m_max_bytes)){
+        file_entry* entry = s.lru.back();
+        s.lru.pop_back();
+        s.index.erase(entry->path);
+        s.bytes -= entry->st.st_size;
+        release(entry);
+    }
+}
+
+void file_cache::invalidate(const std::string& path){
+    shard& s = shard_of(path);
+    s.mutex.lock();
+    s.generation++;
+    auto it = s.index.find(path);
+    if(it != s.index.end()){
+        file_entry* entry = *it->second;
+        s.lru.erase(it->second);
+        s.index.erase(it);
+        s.bytes -= entry->st.st_size;
+        release(entry);
+    }
+    s.mutex.unlock();
+}
+
+void file_cache::clear(){
+    for(int i = 0; i < SHARD_NUMBER; i++){
+        shard& s = m_shards[i];
+        s.mutex.lock();
+        s.generation++;
+        for(file_entry* entry : s.lru){
+            release(entry);
+        }
+        s.lru.clear();
+        s.index.clear();
+        s.bytes = 0;
+        s.mutex.unlock();
+    }
+}
+
+/**
+ * @brief 递归监听目录
+ * @param {string&} dir 目录
+ * @return {bool} 是否成功
+ */
+bool file_cache::add_watch(const std::string& dir){
+    int wd = inotify_add_watch(m_inotifyfd, dir.c_str(),
+            IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+            IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+    if(wd < 0) return false;
+    m_watch_dirs[wd] = dir;
+
+    DIR* d = opendir(dir.c_str());
+    if(!d) return false;
+    bool ok = true;
+    struct dirent* ent;
+    while((ent = readdir(d)) != nullptr){
+        if(strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        std::string child = dir + "/" + ent->d_name;
+        struct stat st;
+        if(ent->d_type == DT_DIR || (ent->d_type == DT_UNKNOWN && stat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode))){
+            ok = add_watch(child) && ok;
+        }
+    }
+    closedir(d);
+    return ok;
+}
+
+/**
+ * @brief 监听 root 下的文件变化, 在后台线程中使对应条目失效
+ * @param {char*} root 文档根目录
+ * @return {bool} 是否成功, 失败时调用者不应使用缓存
+ */
+bool file_cache::watch(const char* root){
+    m_inotifyfd = inotify_init1(IN_CLOEXEC);
+    if(m_inotifyfd < 0) return false;
+    if(!add_watch(root) || pthread_create(&m_watcher, nullptr, watcher, this) != 0){
+        close(m_inotifyfd);
+        m_inotifyfd = -1;
+        return false;
+    }
+    return true;
+}
+
+void* file_cache::watcher(void* arg){
+    file_cache* cache = (file_cache*) arg;
+    cache->watch_loop();
+    return cache;
+}
+
+void file_cache::watch_loop(){
+    alignas(struct inotify_event) char buf[4096];
+    while(true){
+        ssize_t len = read(m_inotifyfd, buf, sizeof(buf));
+        if(len <= 0){
+            if(len < 0 && errno == EINTR) continue;
+            break;
+        }
+        for(char* p = buf; p < buf + len; ){
+            struct inotify_event* ev = (struct inotify_event*) p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if(ev->mask & IN_Q_OVERFLOW){
+                // 丢失了事件, 无法确定哪些文件变化
+                clear();
+                continue;
+            }
+            auto it = m_watch_dirs.find(ev->wd);
+            if(it == m_watch_dirs.end()) continue;
+            if(ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)){
+                if(ev->mask & IN_IGNORED) m_watch_dirs.erase(it);
+                continue;
+            }
+            if(ev->len == 0) continue;
+
+            std::string path = it->second + "/" + ev->name;
+            if(ev->mask & IN_ISDIR){
+                // 目录被创建、移入或移出, 其下的路径整体变化
+                if(ev->mask & (IN_CREATE | IN_MOVED_TO)) add_watch(path);
+                clear();
+            }else{
+                invalidate(path);
+            }
+        }
+    }
+}
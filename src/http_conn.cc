@@ -8,101 +8,69 @@
  */
 #include "http_conn.h"
 
-const char* OK_200_TITLE = "OK";
-const char* ERROR_400_TITLE = "Bad Request";
-const char* ERROR_400_FORM = "Your request has bad syntax or is inherently impossible to satisfy.\n";
-const char* ERROR_403_TITLE = "Forbidden";
-const char* ERROR_403_FORM = "You do not have permission to get file from this server.\n";
-const char* ERROR_404_TITLE = "Not Found";
-const char* ERROR_404_FORM = "The requested file was not found on this server.\n";
-const char* ERROR_500_TITLE = "Internal Error";
-const char* ERROR_500_FORM = "There was an unusual problem serving the requested file.\n";
-
 const char* DOC_ROOT = "/home/ubuntu/project/cppproject/nkWebServer/resources";
 
-int http_conn::m_epollfd = -1;
-int http_conn::m_usercount = 0;
+static_assert(ROUTE_GET == 1u << http_conn::GET && ROUTE_POST == 1u << http_conn::POST && ROUTE_PUT == 1u << http_conn::PUT,
+              "ROUTE_METHOD bits must follow http_conn::METHOD");
 
-/**
- * @brief 设置 socket 为非阻塞状态
- * @param {int} socketfd socket标识符
- * @return 设置前 socket 状态标记
- */
-int setnonblocking(int socketfd){
-    int old_flag = fcntl(socketfd, F_GETFL);
-    int new_flag = old_flag | O_NONBLOCK;
-    fcntl(socketfd, F_SETFL, new_flag);
-    return old_flag;
-}
+std::atomic<int> http_conn::m_usercount(0);
+bool http_conn::m_use_sendfile = true;
+file_cache* http_conn::m_file_cache = nullptr;
+int http_conn::m_read_buffer_max = 64 * 1024;
+int http_conn::m_write_buffer_max = 16 * 1024;
+long http_conn::m_max_body = 1024L * 1024 * 1024;
+long http_conn::m_spill_threshold = 16 * 1024;
+long http_conn::m_body_chunk = 16 * 1024;
+const char* http_conn::m_spill_dir = "/tmp";
 
 /**
- * @brief 添加需要监听的 socket 添加到 epoll 中
- * @param {int} epollfd epoll标识符
- * @param {int} socketfd 文件描述符
- * @param {bool} one_shot 保证 socket 只被一个线程处理
+ * @brief 关闭 socket 连接, 由所属引擎完成(可能推迟到连接上的 I/O 操作结束)
+ * @return None
  */
-void addfd(int epollfd, int socketfd, bool one_shot){
-    epoll_event event;
-    event.data.fd = socketfd;
-    event.events = EPOLLIN | EPOLLRDHUP;        // ?水平触发
-    if(one_shot){
-        event.events |= EPOLLONESHOT;
+void http_conn::close_conn(){
+    if(m_sockfd != -1){
+        m_engine->close(this);
     }
-    epoll_ctl(epollfd, EPOLL_CTL_ADD, socketfd, &event);
-    // 设置 socket 为非阻塞，异步处理
-    setnonblocking(socketfd);
-}
-
-/**
- * @brief 移除 socket 描述符
- * @param {int} epollfd epoll标识符
- * @param {int} socketfd socket 描述符
- */
-void removefd(int epollfd, int socketfd){
-    epoll_ctl(epollfd, EPOLL_CTL_DEL, socketfd, 0);
-    close(socketfd);
 }
 
 /**
- * @brief 修改 socket 状态标记
- * @param {int} epollfd epoll标识符
- * @param {int} socketfd socked 标识符
- * @param {int} ev 状态标记
- */
-void modfd(int epollfd, int socketfd, int ev){
-    epoll_event event;
-    event.data.fd = socketfd;
-    event.events = ev | EPOLLET | EPOLLONESHOT | EPOLLRDHUP;
-    epoll_ctl(epollfd, EPOLL_CTL_MOD, socketfd, &event);
-}
-
-/**
- * @brief 关闭 socket 连接
+ * @brief 释放连接持有的文件与缓冲区, 由引擎在关闭描述符前调用
  * @return None
  */
-void http_conn::close_conn(){
-    if(m_sockfd != -1){
-        removefd(m_epollfd, m_sockfd);
-        m_sockfd = -1;
-        m_usercount--;
-    }
+void http_conn::release(){
+    unmap();
+    close_body();
+    clear_responses();
+    m_read_buf.release();
+    m_write_buf.release();
+    m_sockfd = -1;
+    m_usercount--;
 }
 
 /**
- * @brief 初始化连接
+ * @brief 初始化连接, 之后由 eventloop 把连接加入引擎
  * @param {int} sockfd socket连接标识符
  * @param {sockaddr_in} &addr client 地址
+ * @param {event_engine*} engine 接受该连接的 reactor 的事件引擎
  * @return None
  */
-void http_conn::init(int sockfd, const sockaddr_in &addr){
+void http_conn::init(int sockfd, const sockaddr_in &addr, event_engine* engine){
     m_sockfd = sockfd;
     m_addr = addr;
+    m_engine = engine;
+    m_timer.prev = nullptr;
+    m_timer.next = nullptr;
+    m_timer.data = this;
+    m_timeout_type = TIMEOUT_HEADER;
+    m_in_pool.store(false, std::memory_order_relaxed);
+    m_file = nullptr;
+    m_file_address = 0;
+    m_file_fd = -1;
+    m_body_fd = -1;
+    m_body_pipe[0] = m_body_pipe[1] = -1;
+    m_read_buf.init(m_read_buffer_max);
+    m_write_buf.init(m_write_buffer_max);
 
-    int reuse = 1;
-    setsockopt(m_sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
-
-    // !这里 addfd 应该是在 epoll 中添加 sockfd
-    addfd(m_epollfd, m_sockfd, true);
     m_usercount++;
 
     init();
@@ -113,42 +81,124 @@ void http_conn::init(int sockfd, const sockaddr_in &addr){
  * @return None
  */
 void http_conn::init(){
-    bytes_to_send = 0;
-    bytes_have_send = 0;
-
-    m_check_state = CHECK_STATE::REQUESTLINE;
-
     m_checked_idx = 0;
     m_start_line = 0;
+    m_request_start = 0;
     m_read_idx = 0;
     m_write_idx = 0;
 
+    m_response_count = 0;
+    m_send_idx = 0;
+    m_send_pos = 0;
+
+    init_request();
+}
+
+/**
+ * @brief 一个请求处理完后重置解析状态, 读缓冲区中剩余的数据属于下一个流水线请求
+ * @return None
+ */
+void http_conn::init_request(){
+    m_check_state = CHECK_STATE::REQUESTLINE;
+    m_start_line = m_checked_idx;
+    m_request_start = m_checked_idx;
+    // 之前的数据都已处理完, 从缓冲区开头重新开始
+    if(m_request_start == m_read_idx){
+        m_read_idx = 0;
+        m_checked_idx = 0;
+        m_start_line = 0;
+        m_request_start = 0;
+    }
+
     m_method = GET;
     m_url = 0;
+    m_query = 0;
+    m_route = nullptr;
     m_version = 0;
     m_content_length = 0;
-    m_host = 0;
-    m_linger = false;   // 默认不保持连接
-
-    bzero(m_read_buf, READ_BUFFER_SIZE);
-    bzero(m_write_buf, WRITE_BUFFER_SIZE);
-    bzero(m_real_file, FILENAME_LEN);
+    m_body_received = 0;
+    close_body();
+    m_headers.clear();
+    m_linger = false;   // 默认不保持连接, HTTP/1.1 请求行解析后改为保持
+    m_accept_gzip = false;
+    m_range_count = 0;
 }
 
 /**
- * @brief 循环读数据，直到 无数据 或 client 关闭连接
+ * @brief 把当前请求移到读缓冲区开头, 已解析出的指针一起平移
  * @return None
  */
-bool http_conn::read(){
-    if(m_read_idx >= READ_BUFFER_SIZE){
+void http_conn::compact_read_buf(){
+    int shift = m_request_start;
+    if(shift == 0) return;
+    memmove(m_read_buf.data(), m_read_buf.data() + shift, m_read_idx - shift);
+    m_read_idx -= shift;
+    m_checked_idx -= shift;
+    m_start_line -= shift;
+    m_request_start = 0;
+    if(m_url) m_url -= shift;
+    if(m_query) m_query -= shift;
+    if(m_version) m_version -= shift;
+    m_headers.rebase(-shift);
+}
+
+/**
+ * @brief 读缓冲区扩大一倍, 不超过 m_read_buffer_max
+ * @return {bool} 已达上限时返回 false
+ */
+bool http_conn::grow_read_buf(){
+    char* old = m_read_buf.data();
+    if(!m_read_buf.reserve(m_read_idx, m_read_buf.capacity() * 2)){
         return false;
     }
+    ptrdiff_t shift = m_read_buf.data() - old;
+    if(m_url) m_url += shift;
+    if(m_query) m_query += shift;
+    if(m_version) m_version += shift;
+    m_headers.rebase(shift);
+    return true;
+}
+
+/**
+ * @brief 读缓冲区已满时先丢弃已处理完的流水线请求, 仍然没有空间再扩大缓冲区
+ * @return {bool} 已达 m_read_buffer_max 时返回 false
+ */
+bool http_conn::reserve_read(){
+    if(m_read_idx < (int)m_read_buf.capacity()) return true;
+    compact_read_buf();
+    return m_read_idx < (int)m_read_buf.capacity() || grow_read_buf();
+}
 
+/**
+ * @brief 循环读数据，直到 无数据 或 client 关闭连接
+ * @return None
+ */
+bool http_conn::read(){
     int bytes_read = 0;
+    int total = 0;
+
+    if(body_streaming()){
+        // 请求体直接从 socket 写入临时文件, 不经过读缓冲区
+        while(m_body_received < m_content_length){
+            ssize_t n = splice_body();
+            if(n < 0){
+                if(errno == EAGAIN) break;
+                return false;
+            }else if(n == 0){
+                return false;
+            }
+        }
+        return true;
+    }
 
     while(true){
+        if(!reserve_read()){
+            // 已达上限: 本次读到了数据就先交给解析, 否则说明单个请求超过上限
+            return total > 0;
+        }
         // (sockfd, 接收信息开始存放的地址, 最大接受字节数, 0)
-        bytes_read = recv(m_sockfd, m_read_buf + m_read_idx, READ_BUFFER_SIZE - m_read_idx, 0);
+        bytes_read = recv(m_sockfd, m_read_buf.data() + m_read_idx, m_read_buf.capacity() - m_read_idx, 0);
+        metrics::add(METRIC_SYSCALLS);
         if(bytes_read == -1){
             if(errno == EAGAIN || errno == EWOULDBLOCK){
                 break;
@@ -158,8 +208,9 @@ bool http_conn::read(){
             return false;
         }
         m_read_idx += bytes_read;
+        total += bytes_read;
     }
-    printf("get data: %s", m_read_buf);
+    LOG_DEBUG("fd %d read %d bytes, %d buffered", m_sockfd, total, m_read_idx);
     return true;
 }
 
@@ -168,36 +219,36 @@ bool http_conn::read(){
  * @return HTTP 请求状态码
  */
 http_conn::HTTP_CODE http_conn::process_read(){
-    std::cout << "begin process read" << std::endl;
     LINE_STATUS line_status = LINE_STATUS::OK;
     HTTP_CODE ret = HTTP_CODE::NO_REQUEST;
 
     char* text = 0;
     while( 
-        (m_check_state == CHECK_STATE::CONTENT) &&          // 处于解析请求体状态
-        (line_status == LINE_STATUS::OK) ||                 // 在正常读取状态
-        ((line_status = parse_line()) == LINE_STATUS::OK)){ // 将要解析的行状态正常
+        ((m_check_state == CHECK_STATE::CONTENT) &&         // 处于解析请求体状态
+         (line_status == LINE_STATUS::OK)) ||               // 在正常读取状态
+        ((m_check_state != CHECK_STATE::CONTENT) &&         // 请求体不按行扫描, 其中的 "\r\n" 不能被改写
+         ((line_status = parse_line()) == LINE_STATUS::OK))){   // 将要解析的行状态正常
             text = getline();                               // 读入将要解析的行
             m_start_line = m_checked_idx;                   // 将读取标置为下一行
 
-            std::cout << "Read a http line: " << text << std::endl;
+            if(m_check_state != CHECK_STATE::CONTENT) LOG_DEBUG("Read a http line: %s", text);
 
             switch (m_check_state){
                 case CHECK_STATE::REQUESTLINE:{
-                    ret = parse_request_line(text);
+                    ret = parse_request_line(text, m_read_buf.data() + m_checked_idx - 2);
                     if(ret == HTTP_CODE::BAD_REQUEST) return HTTP_CODE::BAD_REQUEST;
                     break;
                 }
                 case CHECK_STATE::HEADER:{
-                    ret = parse_header(text);
-                    if(ret == HTTP_CODE::BAD_REQUEST) return HTTP_CODE::BAD_REQUEST;
-                    else if(ret == HTTP_CODE::GET_REQUEST) return do_request();         // 获取完整请求头，无 content
+                    ret = parse_header(text, m_read_buf.data() + m_checked_idx - 2);
+                    if(ret == HTTP_CODE::GET_REQUEST) return do_request();              // 获取完整请求头，无 content
+                    else if(ret != HTTP_CODE::NO_REQUEST) return ret;                   // 格式错误或拒绝请求体
                     break;
                 }
                 case CHECK_STATE::CONTENT:{
                     ret = parse_content(text);
-                    if(ret == HTTP_CODE::BAD_REQUEST) return HTTP_CODE::BAD_REQUEST;
-                    else if(ret == HTTP_CODE::GET_REQUEST) return do_request();
+                    if(ret == HTTP_CODE::GET_REQUEST) return do_request();
+                    else if(ret != HTTP_CODE::NO_REQUEST) return ret;
                     line_status = LINE_STATUS::OPEN;        // 未读取完
                     break;
             }
@@ -214,104 +265,310 @@ http_conn::HTTP_CODE http_conn::process_read(){
  * @param {char*} text 首行
  * @return HTTP 状态
  */
-http_conn::HTTP_CODE http_conn::parse_request_line(char* text){
-    std::cout << "parse request line: " << text << std::endl;
+http_conn::HTTP_CODE http_conn::parse_request_line(char* text, char* end){
     // 解析 & 校验 Method
-    char* itr = strpbrk(text, " ");
+    char* itr = http_scan::find(text, end, ' ');
     char* method = text;
+    if(itr == end) return HTTP_CODE::BAD_REQUEST;
     *itr = '\0';
-    if(!method) return HTTP_CODE::BAD_REQUEST;
     if(strcasecmp(method, "GET") == 0) m_method = METHOD::GET;
+    else if(strcasecmp(method, "POST") == 0) m_method = METHOD::POST;
+    else if(strcasecmp(method, "PUT") == 0) m_method = METHOD::PUT;
     else return HTTP_CODE::BAD_REQUEST;
 
     
     // 解析 URL
     itr++;
     m_url = itr;
-    itr = strpbrk(itr, " ");
+    itr = http_scan::find(itr, end, ' ');
+    if(itr == end) return HTTP_CODE::BAD_REQUEST;
     *itr = '\0';
-    if(!m_url) return HTTP_CODE::BAD_REQUEST;
 
     
     // 解析 & 校验 HTTP Version
     itr++;
     m_version = itr;
     if(strcasecmp(m_version, "HTTP/1.1") != 0) return HTTP_CODE::BAD_REQUEST;
+    m_linger = true;                    // HTTP/1.1 默认保持连接, 除非 Connection: close
 
     if(strncasecmp(m_url, "http://", 7) == 0){
         m_url += 7;                     // 去掉 "http://"
         m_url = strchr(m_url, '/');     // 跳转到第一个 '/' 后面，即略过 域名 or ip:port
+        if(!m_url) return HTTP_CODE::BAD_REQUEST;
+    }
+    // 查询串不参与路由与文件映射
+    char* query = strchr(m_url, '?');
+    if(query){
+        *query = '\0';
+        m_query = query + 1;
     }
     m_check_state = CHECK_STATE::HEADER;
     
-    //// /*
-    // @test-block begin
-    {
-        std::cout << "Method: " << method << std::endl;
-        std::cout << "URL: " << m_url << std::endl;
-        std::cout << "Version: " << m_version << std::endl;
-    }
-    // @test-block end
-    // */
+    LOG_DEBUG("Method: %s, URL: %s, Version: %s", method, m_url, m_version);
     return HTTP_CODE::NO_REQUEST;
 }
 
+/**
+ * @brief 判断 Accept-Encoding 是否接受 gzip, 如 "gzip, deflate, br" 或 "br;q=1.0, gzip;q=0.8"
+ *        q=0 表示明确拒绝
+ * @param {char*} value Accept-Encoding 的值
+ * @return {bool}
+ */
+static bool accepts_gzip(const char* value){
+    while(*value){
+        value += strspn(value, " \t,");
+        size_t len = strcspn(value, ",; \t");
+        if(len == 4 && strncasecmp(value, "gzip", 4) == 0){
+            const char* end = value + strcspn(value, ",");
+            const char* q = strstr(value, "q=");
+            if(q && q < end){
+                return atof(q + 2) > 0;
+            }
+            return true;
+        }
+        value += strcspn(value, ",");
+    }
+    return false;
+}
+
 /**
  * @brief 解析 HTTP请求头的一行, 请求头中信息为多行，每行为 [ Key : Value ]
  * @param {char*} text 请求头中的一行
  * @return HTTP 状态码
  * @test TODO
  */
-http_conn::HTTP_CODE http_conn::parse_header(char* text){
-    std::cout << "parse header: " << text << std::endl;
-    if(text[0] == '\0'){
-        if(m_content_length != 0){
-            m_check_state = CHECK_STATE::CONTENT;
-            return HTTP_CODE::NO_REQUEST;
-        }
-        return HTTP_CODE::GET_REQUEST;
-    }else if(strncasecmp(text, "Connection:", 11) == 0){
-        text += 11;
-        text += strspn(text, " ");
-        if(strcasecmp(text, "keep-alive") == 0){
+http_conn::HTTP_CODE http_conn::parse_header(char* text, char* end){
+    if(text == end){
+        return start_body();
+    }
+
+    // 头部名与值原地以 '\0' 结尾后登记到头部表, 已知头部按名字长度查表得到下标
+    char* colon = http_scan::find(text, end, ':');
+    if(colon == end){
+        LOG_DEBUG("invalid header: %s", text);
+        return HTTP_CODE::NO_REQUEST;
+    }
+    HEADER_NAME name = http_scan::header_name(text, colon - text);
+    *colon = '\0';
+    char* value = colon + 1;
+    value += strspn(value, " \t");
+    while(end > value && (end[-1] == ' ' || end[-1] == '\t')) *--end = '\0';
+    if(!m_headers.add(text, colon - text, value, end - value, name)){
+        // 头部数超过 MAX_HEADERS
+        return HTTP_CODE::HEADER_TOO_LARGE;
+    }
+
+    if(name == HEADER_CONNECTION){
+        if(strcasecmp(value, "keep-alive") == 0){
             m_linger = true;
+        }else if(strcasecmp(value, "close") == 0){
+            m_linger = false;
+        }
+    }else if(name == HEADER_CONTENT_LENGTH){
+        // 决定请求体的边界: 只接受十进制数字, 重复出现时值必须相同, 否则无法确定下一个请求从哪里开始
+        char* num_end = nullptr;
+        errno = 0;
+        unsigned long long length = strtoull(value, &num_end, 10);
+        if(*value < '0' || *value > '9' || *num_end != '\0' || errno == ERANGE ||
+                length > (unsigned long long)std::numeric_limits<long>::max()){
+            return HTTP_CODE::BAD_REQUEST;
+        }
+        if(m_headers.get(HEADER_CONTENT_LENGTH)->value != value && (long)length != m_content_length){
+            return HTTP_CODE::BAD_REQUEST;
         }
-    }else if(strncasecmp(text, "Content-Length:", 15) == 0){
-        text += 15;
-        text += strspn(text, " ");
-        m_content_length = atol(text);
-    }else if(strncasecmp(text, "Host:", 5) == 0){
-        text += 5;
-        text += strspn(text, " ");
-        m_host = text;
+        m_content_length = (long)length;
+    }else if(name == HEADER_ACCEPT_ENCODING){
+        m_accept_gzip = accepts_gzip(value);
+    }
+
+    LOG_DEBUG("header: %s = %s", text, value);
+    return HTTP_CODE::NO_REQUEST;
+}
+
+/**
+ * @brief 头部解析完成: 查找路由, 检查方法与请求体长度, 选择请求体的接收方式;
+ *        路由决定接受哪些方法, 静态文件只接受 GET. 拒绝时请求体没有读取, 无法找到下一个请求的起始位置, 响应后关闭连接;
+ *        放不进读缓冲区或超过 m_spill_threshold 的请求体写入临时文件(O_TMPFILE, 不可用时 mkstemp 后立即删除)
+ * @return {HTTP_CODE} 没有请求体时 GET_REQUEST, 需要接收请求体时 NO_REQUEST
+ */
+http_conn::HTTP_CODE http_conn::start_body(){
+    bool chunked = m_headers.get(HEADER_TRANSFER_ENCODING) != nullptr;
+    HTTP_CODE reject = HTTP_CODE::NO_REQUEST;
+    m_route = router::find(m_url, strlen(m_url));
+    unsigned allowed = m_route ? m_route->methods : (unsigned)ROUTE_GET;
+    if(!(allowed & (1u << m_method))){
+        reject = HTTP_CODE::METHOD_NOT_ALLOWED;
+    }else if(chunked){
+        reject = HTTP_CODE::LENGTH_REQUIRED;
+    }else if(m_content_length > m_max_body){
+        reject = HTTP_CODE::PAYLOAD_TOO_LARGE;
     }
-    else{
-        std::cout << "unkown header: " << text << std::endl;
+    if(reject != HTTP_CODE::NO_REQUEST){
+        if(m_content_length > 0 || chunked) m_linger = false;
+        return reject;
     }
+    if(m_content_length == 0) return HTTP_CODE::GET_REQUEST;
 
-    // /*
-    // @test-block begin
-    {
-        std::cout << "m_content_length: " << m_content_length << std::endl;
-        std::cout << "text: " << text << std::endl;
+    m_check_state = CHECK_STATE::CONTENT;
+    if(!body_handler() && (m_content_length > m_spill_threshold ||
+                           m_content_length > m_read_buffer_max - (m_checked_idx - m_request_start))){
+        m_body_fd = open(m_spill_dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+        if(m_body_fd < 0){
+            char path[FILENAME_LEN];
+            snprintf(path, sizeof(path), "%s/nkbody.XXXXXX", m_spill_dir);
+            m_body_fd = mkostemp(path, O_CLOEXEC);
+            if(m_body_fd >= 0) unlink(path);
+        }
+        metrics::add(METRIC_SYSCALLS);
+        if(m_body_fd < 0){
+            LOG_WARN("create body file in %s failed, errno: %d", m_spill_dir, errno);
+            m_linger = false;
+            return HTTP_CODE::INTERNAL_ERROR;
+        }
     }
-    // @test-block end
-    // */
     return HTTP_CODE::NO_REQUEST;
 }
 
 /**
- * @brief 解析请求体，这里只去判断是否完整读入
- * @param {char*} text 完整请求体
- * @return None
+ * @brief 写入全部数据, 用于把读缓冲区中的请求体写入临时文件
+ * @return {bool} 写入是否成功
+ */
+static bool write_all(int fd, const char* data, size_t len){
+    while(len > 0){
+        ssize_t n = ::write(fd, data, len);
+        metrics::add(METRIC_SYSCALLS);
+        if(n < 0){
+            if(errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+/**
+ * @brief 解析请求体: 较小的请求体留在读缓冲区中, 完整后跳过;
+ *        路由有 route::body 时, 读缓冲区中每凑满 m_body_chunk 字节(最后一块为剩余部分)交给它一次;
+ *        否则读缓冲区中已收到的部分写入临时文件. 交出的部分从缓冲区中移除,
+ *        之后的数据(下一个流水线请求)前移, 一个请求占用的读缓冲区不超过头部加一次接收的数据
+ * @param {char*} text 请求体在读缓冲区中的起始位置
+ * @return {HTTP_CODE} 请求体接收完时 GET_REQUEST
  */
 http_conn::HTTP_CODE http_conn::parse_content(char* text){
-    std::cout << "parse content: " << text << std::endl;
-    if(m_read_idx >= (m_checked_idx + m_content_length)){
-        text[m_content_length] = '\0';      // ?为什么要这样
-        return HTTP_CODE::GET_REQUEST;
+    LOG_DEBUG("parse content, length: %ld, received: %ld", (long)m_content_length, m_body_received);
+    route_body_handler handler = body_handler();
+    if(m_body_fd == -1 && !handler){
+        if(m_read_idx >= (m_checked_idx + m_content_length)){
+            // 跳过请求体, 之后的数据属于下一个流水线请求, 因此不能在请求体末尾写 '\0'
+            m_checked_idx += m_content_length;
+            m_body_received = m_content_length;
+            return HTTP_CODE::GET_REQUEST;
+        }
+        return HTTP_CODE::NO_REQUEST;
+    }
+
+    long buffered = m_read_idx - m_checked_idx;
+    long len = std::min(buffered, m_content_length - m_body_received);
+    if(handler){
+        // 块长不超过头部之后的空间, 读缓冲区满时一定能凑满一块
+        long chunk = std::max(1L, std::min(m_body_chunk, (long)m_read_buffer_max - (m_checked_idx - m_request_start)));
+        len = 0;
+        while(m_body_received < m_content_length){
+            long n = std::min(chunk, m_content_length - m_body_received);
+            if(buffered - len < n) break;
+            if(!handler(this, text + len, n)){
+                m_linger = false;
+                return HTTP_CODE::INTERNAL_ERROR;
+            }
+            len += n;
+            m_body_received += n;
+        }
+    }else if(len > 0){
+        if(!write_all(m_body_fd, text, len)){
+            m_linger = false;
+            return HTTP_CODE::INTERNAL_ERROR;
+        }
+        m_body_received += len;
+    }
+    if(len > 0){
+        memmove(text, text + len, buffered - len);
+        m_read_idx -= len;
+    }
+    if(m_body_received < m_content_length) return HTTP_CODE::NO_REQUEST;
+    if(handler && !handler(this, nullptr, 0)){
+        m_linger = false;
+        return HTTP_CODE::INTERNAL_ERROR;
+    }
+    return HTTP_CODE::GET_REQUEST;
+}
+
+/**
+ * @brief 留在读缓冲区中的请求体, 在请求处理完之前有效
+ * @return {char*} 请求体写入临时文件、交给 route::body 或没有请求体时为 nullptr
+ */
+const char* http_conn::body() const{
+    if(m_body_fd != -1 || body_handler() || m_body_received == 0) return nullptr;
+    return m_read_buf.data() + m_checked_idx - m_body_received;
+}
+
+/**
+ * @brief 请求体正在直接写入临时文件: 已收到的部分都已写入, 还有未接收的部分;
+ *        此时引擎用 splice_body() 接收, 不经过读缓冲区
+ * @return {bool}
+ */
+bool http_conn::body_streaming() const{
+    return m_body_fd != -1 && m_body_received < m_content_length && m_read_idx == m_checked_idx;
+}
+
+/**
+ * @brief 从 socket splice 最多 SPLICE_CHUNK 字节到管道, 再全部 splice 到临时文件, 数据不经过用户空间;
+ *        不会读到请求体之后的数据(下一个流水线请求)
+ * @return {ssize_t} 接收的字节数; 0 表示对端关闭; -1 时 errno 为 EAGAIN 表示暂无数据, 其他为错误
+ */
+ssize_t http_conn::splice_body(){
+    if(m_body_pipe[0] == -1){
+        metrics::add(METRIC_SYSCALLS);
+        if(pipe2(m_body_pipe, O_NONBLOCK | O_CLOEXEC) < 0){
+            m_body_pipe[0] = m_body_pipe[1] = -1;
+            return -1;
+        }
+    }
+    size_t len = std::min(m_content_length - m_body_received, (long)SPLICE_CHUNK);
+    ssize_t n = splice(m_sockfd, nullptr, m_body_pipe[1], nullptr, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    metrics::add(METRIC_SYSCALLS);
+    if(n <= 0) return n;
+    // 写入普通文件不会返回 EAGAIN, 管道中的数据一次取完
+    for(ssize_t left = n; left > 0; ){
+        ssize_t m = splice(m_body_pipe[0], nullptr, m_body_fd, nullptr, left, SPLICE_F_MOVE);
+        metrics::add(METRIC_SYSCALLS);
+        if(m < 0 && errno == EINTR) continue;
+        if(m <= 0){
+            if(m == 0) errno = EIO;
+            return -1;
+        }
+        left -= m;
+    }
+    m_body_received += n;
+    return n;
+}
+
+/**
+ * @brief 关闭请求体的临时文件(文件没有名字, 关闭后即删除)与管道
+ * @return None
+ */
+void http_conn::close_body(){
+    if(m_body_fd != -1){
+        ::close(m_body_fd);
+        m_body_fd = -1;
+        metrics::add(METRIC_SYSCALLS);
+    }
+    if(m_body_pipe[0] != -1){
+        ::close(m_body_pipe[0]);
+        ::close(m_body_pipe[1]);
+        m_body_pipe[0] = m_body_pipe[1] = -1;
+        metrics::add(METRIC_SYSCALLS, 2);
     }
-    return HTTP_CODE::NO_REQUEST;
 }
 
 /**
@@ -322,114 +579,433 @@ http_conn::HTTP_CODE http_conn::parse_content(char* text){
  * @test TODO
  */
 http_conn::LINE_STATUS http_conn::parse_line(){
-    std::cout << "check parse line" << std::endl;
+    char* buf = m_read_buf.data();
     while(m_checked_idx < m_read_idx){
-        if(m_read_buf[m_checked_idx] == '\r'){
-            if(m_checked_idx + 1 == m_read_idx){        // 回车后面还未读入，为 OPEN 状态
-                return LINE_STATUS::OPEN;
-            }else if(m_read_buf[m_checked_idx + 1] == '\n'){
-                // 转换 "\r\n" 为 "\0\0"
-                m_read_buf[m_checked_idx++] = '\0';
-                m_read_buf[m_checked_idx++] = '\0';
-                return LINE_STATUS::OK;
-            }
-            return LINE_STATUS::BAD;
+        // 一次跳到下一个 '\r', 而不是逐字节比较
+        m_checked_idx = http_scan::find(buf + m_checked_idx, buf + m_read_idx, '\r') - buf;
+        if(m_checked_idx == m_read_idx) break;
+        if(m_checked_idx + 1 == m_read_idx){            // 回车后面还未读入，为 OPEN 状态
+            return LINE_STATUS::OPEN;
+        }else if(buf[m_checked_idx + 1] == '\n'){
+            // 转换 "\r\n" 为 "\0\0"
+            buf[m_checked_idx++] = '\0';
+            buf[m_checked_idx++] = '\0';
+            return LINE_STATUS::OK;
         }
-        m_checked_idx++;
+        return LINE_STATUS::BAD;
     }
     return LINE_STATUS::OPEN;
 }
 
 /**
- * @brief 读取请求的文件到内存中
+ * @brief 路径中是否有 ".." 段, 如 "/../etc/passwd"、"/a/..", 不含 "/a..b"
+ * @param {char*} path 以 '/' 开头的路径
+ * @return {bool}
+ */
+static bool has_dot_dot(const char* path){
+    for(const char* p = path; (p = strstr(p, "..")); p += 2){
+        if(p[-1] == '/' && (p[2] == '/' || p[2] == '\0')) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 命中路由时交给处理函数, 否则获取请求的文件, 优先从文件缓存中获取
  * @return None
  */
 http_conn::HTTP_CODE http_conn::do_request(){
+    if(m_route){
+        // 方法已在 start_body 中检查
+        return HTTP_CODE::HANDLER_REQUEST;
+    }
+
+    // URL 不做百分号解码, 直接拼在 DOC_ROOT 后面, 因此只需拒绝 ".." 段与不以 '/' 开头的路径
+    if(m_url[0] != '/') return HTTP_CODE::BAD_REQUEST;
+    if(has_dot_dot(m_url)){
+        LOG_DEBUG("Path traversal: %s", m_url);
+        return HTTP_CODE::FORBIDDEN_REQUEST;
+    }
+
     strcpy(m_real_file, DOC_ROOT);
     int len = strlen(DOC_ROOT);
     strncpy(m_real_file + len, m_url, FILENAME_LEN - len - 1);      // -1 是给 '\0' 留空间
     
-    std::cout << "Get Flie: " << m_real_file <<std::endl;
+    LOG_DEBUG("Get file: %s", m_real_file);
 
-    // 不存在文件
-    if(stat(m_real_file, &m_file_stat) < 0){
-        std::cout << "No Flie: " << m_real_file <<std::endl;
-        return HTTP_CODE::NO_RESOURCE;
+    bool conditional = m_headers.get(HEADER_IF_NONE_MATCH) || m_headers.get(HEADER_IF_MODIFIED_SINCE);
+    bool gzip_tag = false;
+    if(conditional && !m_file_cache){
+        // 不经过缓存时先 stat, 未修改的文件不需要打开
+        if(stat(m_real_file, &m_file_stat) == 0 && S_ISREG(m_file_stat.st_mode) &&
+                (m_file_stat.st_mode & S_IROTH) && not_modified(&gzip_tag)){
+            m_accept_gzip = gzip_tag;
+            m_file_headers = nullptr;
+            return HTTP_CODE::NOT_MODIFIED;
+        }
     }
 
-    // 禁止访问
-    if(!(m_file_stat.st_mode & S_IROTH)){
-        std::cout << "Forbidan access: " << m_real_file <<std::endl;
-        return HTTP_CODE::FORBIDDEN_REQUEST;
+    int err = 0;
+    m_file = m_file_cache ? m_file_cache->acquire(m_real_file, err)
+                          : file_cache::load(m_real_file, !m_use_sendfile, err);
+    if(!m_file){
+        switch(err){
+            case ENOENT:
+                // 不存在文件
+                LOG_DEBUG("No file: %s", m_real_file);
+                return HTTP_CODE::NO_RESOURCE;
+            case EACCES:
+                // 禁止访问
+                LOG_DEBUG("Forbidden access: %s", m_real_file);
+                return HTTP_CODE::FORBIDDEN_REQUEST;
+            case EISDIR:
+                LOG_DEBUG("Not a file: %s", m_real_file);
+                return HTTP_CODE::BAD_REQUEST;
+            default:
+                return HTTP_CODE::INTERNAL_ERROR;
+        }
+    }
+
+    m_file_stat = m_file->st;
+    // sendfile 模式下 m_file_fd 有效, 由 sendfile 直接从页缓存发送; 否则使用 m_file_address
+    m_file_fd = m_file->fd;
+    m_file_address = m_file->address;
+    m_file_size = m_file->st.st_size;
+    m_file_headers = &m_file->headers;
+
+    if(conditional && not_modified(&gzip_tag)){
+        // 发送 client 所持版本的验证器; 304 没有实体, 不调用 gzip_variant(), 以免为它压缩文件.
+        // gzip 版本的验证器由 m_file_stat 生成, 引用保留到生成响应
+        m_accept_gzip = gzip_tag;
+        m_file_headers = gzip_tag ? nullptr : &m_file->validators;
+        return HTTP_CODE::NOT_MODIFIED;
     }
 
-    if(S_ISDIR(m_file_stat.st_mode)){
-        std::cout << "Not a Flie: " << m_real_file <<std::endl;
-        return HTTP_CODE::BAD_REQUEST;
-    } 
+    // Range 按原始内容计算, 不使用 gzip 版本
+    const header_view* range = m_headers.get(HEADER_RANGE);
+    if(range && if_range_matches()){
+        m_range_count = parse_ranges(range->value, m_file_size, m_ranges, MAX_RANGES);
+        if(m_range_count == 0){
+            // 保留 m_file_size 用于 Content-Range
+            unmap();
+            return HTTP_CODE::RANGE_NOT_SATISFIABLE;
+        }
+        // 多段响应每段占用响应队列中的一项, 流水线中放不下时忽略 Range 返回整个文件
+        if(m_range_count > 1 && m_response_count + m_range_count + 1 > MAX_PIPELINE){
+            m_range_count = -1;
+        }
+        if(m_range_count > 0) return HTTP_CODE::PARTIAL_REQUEST;
+        m_range_count = 0;
+    }
 
-    int fd = open(m_real_file, O_RDONLY);
-    // 创建内存映射
-    m_file_address = (char*)mmap(0, m_file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    ::close(fd);
+    // client 接受 gzip 时发送预压缩的版本
+    const file_variant* gzip = m_accept_gzip ? file_cache::gzip_variant(m_file) : nullptr;
+    if(gzip){
+        m_file_fd = gzip->fd;
+        m_file_address = gzip->address;
+        m_file_size = gzip->size;
+        m_file_headers = &gzip->headers;
+    }
     return HTTP_CODE::FILE_REQUEST;
 }
 
 /**
- * @brief 释放内存中读入的文件
- * @return None
+ * @brief 检查 If-Range: 不一致时忽略 Range 返回整个文件
+ *        使用强比较: 实体标签必须与原文件的 ETag 完全相同(弱标签总是不一致), 日期必须与修改时间完全相同
+ * @return {bool}
  */
-void http_conn::unmap(){
-    if(m_file_address){
-        munmap(m_file_address, m_file_stat.st_size);
-        m_file_address = 0;
+bool http_conn::if_range_matches() const{
+    const header_view* h = m_headers.get(HEADER_IF_RANGE);
+    if(!h) return true;
+    if(h->value[0] == '"'){
+        char etag[file_cache::MAX_ETAG_LEN];
+        size_t len = file_cache::format_etag(etag, m_file_stat) - etag;
+        return h->value_len == len && memcmp(h->value, etag, len) == 0;
     }
+    if(strncmp(h->value, "W/", 2) == 0) return false;
+    time_t t;
+    return http_response::parse_date(h->value, t) && t == m_file_stat.st_mtime;
 }
 
 /**
- * @brief 发送响应的数据
- * @return {bool} 发送是否成功
+ * @brief 条件请求的验证器是否与文件一致, 一致时返回 304
+ *        有 If-None-Match 时忽略 If-Modified-Since; If-None-Match 使用弱比较,
+ *        原文件与 gzip 版本的 ETag 都算一致, 两者内容相同
+ * @param {bool*} gzip_tag 输出, 一致的是 gzip 版本的 ETag 时为 true
+ * @return {bool}
  */
-bool http_conn::write(){
-    int tmp = 0;
-    int bytes_have_send = 0;
-    int bytes_ready_send = m_write_idx;
-
-    // 整体响应结束，初始化参数
-    if(bytes_ready_send == 0){
-        modfd(m_epollfd, m_sockfd, EPOLLIN);
-        init();
-        return true;
+bool http_conn::not_modified(bool* gzip_tag) const{
+    *gzip_tag = false;
+    const header_view* h = m_headers.get(HEADER_IF_NONE_MATCH);
+    if(h){
+        char etag[file_cache::MAX_ETAG_LEN];
+        size_t len = file_cache::format_etag(etag, m_file_stat) - etag;
+        const char* p = h->value;
+        while(*p){
+            p += strspn(p, " \t,");
+            if(*p == '*') return true;
+            if(strncmp(p, "W/", 2) == 0) p += 2;
+            if(*p != '"') break;
+            const char* end = strchr(p + 1, '"');
+            if(!end) break;
+            end++;
+            size_t tag_len = end - p;
+            // 原文件: "...", gzip 版本: "...-gz"
+            if(tag_len == len && memcmp(p, etag, len) == 0) return true;
+            if(tag_len == len + 3 && memcmp(p, etag, len - 1) == 0 && memcmp(p + len - 1, "-gz\"", 4) == 0){
+                *gzip_tag = true;
+                return true;
+            }
+            p = end;
+        }
+        return false;
+    }
+    h = m_headers.get(HEADER_IF_MODIFIED_SINCE);
+    time_t t;
+    return h && http_response::parse_date(h->value, t) && m_file_stat.st_mtime <= t;
+}
+
+/**
+ * @brief 读取十进制数, 超过 off_t 范围时取最大值
+ * @return {bool} 没有数字时返回 false
+ */
+static bool scan_off(const char*& p, off_t& value){
+    if(*p < '0' || *p > '9') return false;
+    const off_t max = std::numeric_limits<off_t>::max();
+    value = 0;
+    for(; *p >= '0' && *p <= '9'; p++){
+        int digit = *p - '0';
+        value = value > (max - digit) / 10 ? max : value * 10 + digit;
     }
+    return true;
+}
 
+/**
+ * @brief 解析 Range, 如 "bytes=0-499", "bytes=500-", "bytes=-500", "bytes=0-0,-1"
+ *        超出文件的部分截去, 完全在文件之外的范围跳过
+ * @param {char*} value Range 的值
+ * @param {off_t} size 文件长度
+ * @param {byte_range*} ranges 输出, 保持请求中的顺序
+ * @param {int} max ranges 的长度
+ * @return {int} 可满足的范围数; 0 表示没有可满足的范围(416); -1 表示格式错误、单位不是 bytes
+ *         或范围过多, 此时忽略 Range
+ */
+int http_conn::parse_ranges(const char* value, off_t size, byte_range* ranges, int max){
+    if(strncasecmp(value, "bytes=", 6) != 0) return -1;
+    const char* p = value + 6;
+    int count = 0;
+    bool any = false;
     while(true){
-        tmp = writev(m_sockfd, m_iv, m_iv_count);       // tmp : 写入TCP缓存的字节数
-        if(tmp < 0){
-            // TCP写缓存满了
-            // 等待下一个 EPOLLOUT 事件
-            if(errno == EAGAIN){
-                modfd(m_epollfd, m_sockfd, EPOLLOUT);
-                return true;
-            }
-            unmap();
-            return false;
+        p += strspn(p, " \t");
+        if(*p == ','){
+            p++;
+            continue;
         }
-        bytes_have_send += tmp;
-        bytes_ready_send -= tmp;
+        if(*p == '\0') break;
 
-        // 发送完成, 根据请求中的字段决定是否保持连接
-        if(bytes_ready_send <= bytes_have_send){
-            unmap();
-            if(m_linger){
-                init();
-                modfd(m_epollfd, m_sockfd, EPOLLIN);
-                return true;
+        off_t first, last;
+        if(*p == '-'){
+            // 最后 n 个字节
+            off_t suffix;
+            p++;
+            if(!scan_off(p, suffix)) return -1;
+            first = suffix >= size ? 0 : size - suffix;
+            last = suffix == 0 ? -1 : size - 1;
+        }else{
+            if(!scan_off(p, first) || *p != '-') return -1;
+            p++;
+            if(scan_off(p, last)){
+                if(last < first) return -1;
+                if(last >= size) last = size - 1;
             }else{
-                modfd(m_epollfd, m_sockfd, EPOLLIN);
+                last = size - 1;
+            }
+        }
+        p += strspn(p, " \t");
+        if(*p != ',' && *p != '\0') return -1;
+        any = true;
+
+        if(first > last || first >= size) continue;
+        if(count == max) return -1;
+        ranges[count].first = first;
+        ranges[count].last = last;
+        count++;
+    }
+    return any ? count : -1;
+}
+
+/**
+ * @brief 释放当前请求的文件, 映射与描述符属于 file_entry, 引用计数为 0 时才真正释放
+ * @return None
+ */
+void http_conn::unmap(){
+    if(m_file){
+        file_cache::release(m_file);
+        m_file = nullptr;
+    }
+    m_file_address = 0;
+    m_file_fd = -1;
+}
+
+/**
+ * @brief 清空响应队列, 释放响应持有的文件
+ * @return None
+ */
+void http_conn::clear_responses(){
+    for(int i = m_send_idx; i < m_response_count; i++){
+        if(m_responses[i].file){
+            file_cache::release(m_responses[i].file);
+        }
+    }
+    m_response_count = 0;
+    m_send_idx = 0;
+    m_send_pos = 0;
+    m_write_idx = 0;
+}
+
+/**
+ * @brief 记录已发送的字节, 发送完的响应出队
+ * @param {ssize_t} len 本次发送的字节数
+ * @return {bool} false 表示发送完的响应要求关闭连接
+ */
+bool http_conn::advance(ssize_t len){
+    m_send_pos += len;
+    while(m_send_idx < m_response_count){
+        response& r = m_responses[m_send_idx];
+        off_t total = r.header_len + r.body_size;
+        if(m_send_pos < total) break;
+        m_send_pos -= total;
+        if(!r.part) metrics::observe(METRIC_SEND, metrics::now_ns() - r.ready_ns);
+        if(r.file){
+            file_cache::release(r.file);
+            r.file = nullptr;
+        }
+        m_send_idx++;
+        if(r.close) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 响应队列发送完成, 连接进入空闲时归还缓冲区的堆内存;
+ *        读缓冲区中还有流水线请求时由引擎直接交给线程池处理
+ * @return None
+ */
+void http_conn::finish_write(){
+    clear_responses();
+    if(!has_pending_request()){
+        m_write_buf.shrink(0);
+        if(m_read_idx == 0) m_read_buf.shrink(0);
+    }
+}
+
+/**
+ * @brief 正在解析的请求行与头部占满了读缓冲区上限, 再接收也无法完整
+ *        请求体不会停在这里: 放不下的请求体写入临时文件或交给 route::body
+ * @return {bool}
+ */
+bool http_conn::header_too_large() const{
+    return m_check_state != CHECK_STATE::CONTENT && m_read_idx - m_request_start >= (int)m_read_buf.max_size();
+}
+
+/**
+ * @brief 响应已发完, 读缓冲区中还有未处理的数据(流水线请求)
+ * @return {bool}
+ */
+bool http_conn::has_pending_request() const{
+    return m_response_count == 0 && m_read_idx > m_request_start;
+}
+
+/**
+ * @brief 从当前发送进度开始的下一段连续数据:
+ *        连续的内存数据(响应头、错误页面、映射的文件)合并为一组 iov,
+ *        sendfile 模式的文件实体在其响应头之后单独发送, 响应头用 MSG_MORE 与文件开头合并;
+ *        一段最多 SEND_WINDOW 字节, 大文件分多轮发送
+ * @param {send_op&} op 输出
+ * @return {bool} 响应队列已发送完时返回 false
+ */
+bool http_conn::prepare_send(send_op& op){
+    op.iov_count = 0;
+    op.more = false;
+    op.file_fd = -1;
+    if(m_send_idx >= m_response_count) return false;
+
+    response& r = m_responses[m_send_idx];
+    if(r.body_fd != -1 && m_send_pos >= r.header_len){
+        op.file_fd = r.body_fd;
+        op.file_offset = r.body_offset + m_send_pos - r.header_len;
+        op.file_len = std::min(r.body_offset + r.body_size - op.file_offset, SEND_WINDOW);
+        return true;
+    }
+    off_t skip = m_send_pos;
+    off_t window = SEND_WINDOW;
+    for(int i = m_send_idx; i < m_response_count && window > 0; i++){
+        response& p = m_responses[i];
+        if(skip < p.header_len){
+            op.iov[op.iov_count].iov_base = m_write_buf.data() + p.header_offset + skip;
+            op.iov[op.iov_count].iov_len = p.header_len - skip;
+            window -= p.header_len - skip;
+            op.iov_count++;
+            skip = 0;
+        }else{
+            skip -= p.header_len;
+        }
+        if(p.body_fd != -1){
+            op.more = p.body_size > 0;
+            break;
+        }
+        if(p.body_size > skip && window > 0){
+            off_t len = std::min(p.body_size - skip, window);
+            op.iov[op.iov_count].iov_base = p.body_address + skip;
+            op.iov[op.iov_count].iov_len = len;
+            window -= len;
+            op.iov_count++;
+        }
+        skip = 0;
+    }
+    return true;
+}
+
+/**
+ * @brief 按顺序发送响应队列, 部分发送时记录进度, 由引擎在下一个 EPOLLOUT 事件中继续;
+ *        一次最多发送 SEND_WINDOW 字节, 向快速 client 发送大文件时也会回到事件循环, 不阻塞同一 reactor 上的其他连接
+ * @return {bool} 是否保持连接; 返回 true 且 m_response_count 不为 0 时表示还未发完
+ */
+bool http_conn::write(){
+    send_op op;
+    off_t sent = 0;
+    while(prepare_send(op)){
+        if(sent >= SEND_WINDOW){
+            // 本轮已用完发送窗口, 等待下一个 EPOLLOUT 继续
+            return true;
+        }
+        ssize_t n;
+        if(op.file_fd != -1){
+            off_t offset = op.file_offset;
+            n = sendfile(m_sockfd, op.file_fd, &offset, op.file_len);
+            if(n == 0){
+                // 文件在发送过程中被截断, 已无法发送 Content-Length 声明的长度
                 return false;
             }
+        }else{
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = op.iov;
+            msg.msg_iovlen = op.iov_count;
+            n = sendmsg(m_sockfd, &msg, op.more ? MSG_MORE : 0);
+        }
+        metrics::add(METRIC_SYSCALLS);
+
+        if(n < 0){
+            return errno == EAGAIN;
+        }
+        metrics::add(METRIC_BYTES_SENT, n);
+        sent += n;
+        if(!advance(n)){
+            return false;
         }
     }
+    finish_write();
+    return true;
 }
 
 /**
@@ -439,12 +1015,32 @@ bool http_conn::write(){
  * @return {bool} 发送是否成功
  */
 bool http_conn::add_response(const char* format, ...){
-    va_list arg_list;
-    va_start(arg_list, format);
-    int len = vsnprintf(m_write_buf + m_write_idx, WRITE_BUFFER_SIZE - m_write_idx - 1, format, arg_list);
-    if(len >= (WRITE_BUFFER_SIZE - m_write_idx - 1) || len < 0) return false;
+    while(true){
+        size_t room = m_write_buf.capacity() - m_write_idx;
+        va_list arg_list;
+        va_start(arg_list, format);
+        int len = vsnprintf(m_write_buf.data() + m_write_idx, room, format, arg_list);
+        va_end(arg_list);
+        if(len < 0) return false;
+        if((size_t)len < room){
+            m_write_idx += len;
+            return true;
+        }
+        // 空间不足, 扩大写缓冲区后重新格式化
+        if(!m_write_buf.reserve(m_write_idx, m_write_idx + len + 1)) return false;
+    }
+}
+
+/**
+ * @brief 直接复制已生成好的数据到写缓存
+ * @param {char*} data 数据
+ * @param {size_t} len 长度
+ * @return {bool} 写入是否成功
+ */
+bool http_conn::add_raw(const char* data, size_t len){
+    if(!m_write_buf.reserve(m_write_idx, m_write_idx + len)) return false;
+    memcpy(m_write_buf.data() + m_write_idx, data, len);
     m_write_idx += len;
-    va_end(arg_list);
     return true;
 }
 
@@ -454,38 +1050,143 @@ bool http_conn::add_response(const char* format, ...){
  * @param {char*} title 状态Title
  * @return {bool} 发送是否成功
  */
-bool http_conn::add_status_line(int status, const char* title){
-    return add_response("%s %d %s\r\n", "HTTP/1.1", status, title);
+bool http_conn::add_status_line(int status){
+    const response_blob& line = http_response::status_line(status);
+    return add_raw(line.data, line.len);
 }
 
 /**
- * @brief 写入 header 到写缓存
- * @param {int} content_len 
+ * @brief 写入 Date 到写缓存, 同一秒内使用缓存的结果
  * @return {bool} 写入是否成功
  */
-bool http_conn::add_headers(int content_len){
-    return  add_content_length(content_len)&&
-            add_content_type()&&
-            add_linger()&&
-            add_blank_line();
+bool http_conn::add_date(){
+    const response_blob& date = http_response::date_header();
+    return add_raw(date.data, date.len);
 }
 
 /**
  * @brief 写入 content长度 到写缓存
- * @param {int} content_len
+ * @param {off_t} content_len
  * @return {bool} 写入是否成功
  */
-bool http_conn::add_content_length(int content_len){
-    return add_response("Content-Length: %d\r\n", content_len);
+bool http_conn::add_content_length(off_t content_len){
+    static const char NAME[] = "Content-Length: ";
+    size_t len = sizeof(NAME) - 1;
+    if(!m_write_buf.reserve(m_write_idx, m_write_idx + len + http_response::MAX_UINT_LEN + 2)) return false;
+    char* p = m_write_buf.data() + m_write_idx;
+    memcpy(p, NAME, len);
+    p = http_response::format_uint(p + len, content_len);
+    *p++ = '\r';
+    *p++ = '\n';
+    m_write_idx = p - m_write_buf.data();
+    return true;
 }
 
 /**
- * @brief 写入 Content-type 到写缓存
+ * @brief 写入当前文件的 Content-Type
  * @return {bool} 写入是否成功
  */
 bool http_conn::add_content_type(){
-    char *format_file = strrchr(m_real_file, '.');
-    return add_response("Content-Type:%s\r\n", format_file == NULL ? "text/html" : (format_file + 1));
+    static const char NAME[] = "Content-Type: ";
+    return add_raw(NAME, sizeof(NAME) - 1) &&
+           add_raw(m_file->mime.data(), m_file->mime.size()) &&
+           add_raw("\r\n", 2);
+}
+
+/**
+ * @brief 写入 Content-Range, 如 "Content-Range: bytes 0-499/1234", first 小于 0 时范围写为 "*"(416 使用)
+ * @return {bool} 写入是否成功
+ */
+bool http_conn::add_content_range(off_t first, off_t last, off_t size){
+    static const char NAME[] = "Content-Range: bytes ";
+    size_t len = sizeof(NAME) - 1;
+    if(!m_write_buf.reserve(m_write_idx, m_write_idx + len + http_response::MAX_UINT_LEN * 3 + 4)) return false;
+    char* p = m_write_buf.data() + m_write_idx;
+    memcpy(p, NAME, len);
+    p += len;
+    if(first < 0){
+        *p++ = '*';
+    }else{
+        p = http_response::format_uint(p, first);
+        *p++ = '-';
+        p = http_response::format_uint(p, last);
+    }
+    *p++ = '/';
+    p = http_response::format_uint(p, size);
+    *p++ = '\r';
+    *p++ = '\n';
+    m_write_idx = p - m_write_buf.data();
+    return true;
+}
+
+/**
+ * @brief 十进制位数
+ */
+static size_t uint_len(uint64_t value){
+    char buf[http_response::MAX_UINT_LEN];
+    return http_response::format_uint(buf, value) - buf;
+}
+
+/**
+ * @brief multipart/byteranges 响应: 每段的分隔行与段头在写缓冲区中, 段内容直接引用文件(映射或 sendfile),
+ *        第一段与响应头、之后每段各占响应队列中的一项, 最后一项是结束分隔行并持有文件引用;
+ *        调用前已写入状态行与 Date, 失败时撤销已加入队列的项
+ * @return {bool} 写入是否成功
+ */
+bool http_conn::add_multipart(){
+    static const char CONTENT_TYPE[] = "Content-Type: multipart/byteranges; boundary=";
+    static const char PART_TYPE[] = "Content-Type: ";
+    static const char PART_RANGE[] = "Content-Range: bytes ";
+    const response_blob& boundary = http_response::boundary();
+    const std::string& mime = m_file->mime;
+    off_t size = m_file_stat.st_size;
+    int start = m_response_count;
+    if(start + m_range_count + 1 > MAX_PIPELINE) return false;
+
+    // 实体长度: 每段 "\r\n--boundary\r\n" + 段头 + 空行 + 内容, 最后是 "\r\n--boundary--\r\n"
+    off_t length = 4 + boundary.len + 4;
+    for(int i = 0; i < m_range_count; i++){
+        const byte_range& range = m_ranges[i];
+        length += 4 + boundary.len + 2
+                + sizeof(PART_TYPE) - 1 + mime.size() + 2
+                + sizeof(PART_RANGE) - 1 + uint_len(range.first) + 1 + uint_len(range.last) + 1 + uint_len(size) + 2
+                + 2
+                + range.last - range.first + 1;
+    }
+    bool ok = add_raw(CONTENT_TYPE, sizeof(CONTENT_TYPE) - 1) &&
+              add_raw(boundary.data, boundary.len) &&
+              add_raw("\r\n", 2) &&
+              add_content_length(length) &&
+              add_raw(m_file->validators.data(), m_file->validators.size()) &&
+              add_linger() &&
+              add_blank_line();
+    for(int i = 0; ok && i < m_range_count; i++){
+        const byte_range& range = m_ranges[i];
+        response& r = m_responses[m_response_count];
+        ok = add_raw("\r\n--", 4) &&
+             add_raw(boundary.data, boundary.len) &&
+             add_raw("\r\n", 2) &&
+             add_content_type() &&
+             add_content_range(range.first, range.last, size) &&
+             add_blank_line();
+        if(!ok) break;
+        set_slice(r, range.first, range.last - range.first + 1);
+        r.header_len = m_write_idx - r.header_offset;
+        r.part = true;
+        m_response_count++;
+        start_response();
+    }
+    ok = ok && add_raw("\r\n--", 4) && add_raw(boundary.data, boundary.len) && add_raw("--\r\n", 4);
+    if(!ok){
+        m_response_count = start;
+        return false;
+    }
+    // 段内容引用的文件由最后一项持有, 它在所有段发送完之后才出队
+    m_responses[m_response_count].file = m_file;
+    m_file = nullptr;
+    m_file_address = 0;
+    m_file_fd = -1;
+    return true;
 }
 
 /**
@@ -493,7 +1194,9 @@ bool http_conn::add_content_type(){
  * @return {bool} 写入是否成功
  */
 bool http_conn::add_linger(){
-    return add_response("Connection: %s\r\n", ( m_linger == true ) ? "keep-alive" : "close");
+    static const char KEEP_ALIVE[] = "Connection: keep-alive\r\n";
+    static const char CLOSE[] = "Connection: close\r\n";
+    return m_linger ? add_raw(KEEP_ALIVE, sizeof(KEEP_ALIVE) - 1) : add_raw(CLOSE, sizeof(CLOSE) - 1);
 }
 
 /**
@@ -501,16 +1204,17 @@ bool http_conn::add_linger(){
  * @return {bool} 写入是否成功
  */
 bool http_conn::add_blank_line(){
-    return add_response("%s", "\r\n");
+    return add_raw("\r\n", 2);
 }
 
 /**
- * @brief 写入 content 到写缓存
- * @param {char*} content 数据内容
+ * @brief 写入错误响应: 状态行、Date, 以及预先生成的其余头部与页面内容
+ * @param {int} status 状态码
  * @return {bool} 写入是否成功
  */
-bool http_conn::add_content(const char* content){
-    return add_response("%s", content);
+bool http_conn::add_error(int status){
+    response_blob tail = http_response::error_tail(status, m_linger);
+    return add_status_line(status) && add_date() && add_raw(tail.data, tail.len);
 }
 
 /**
@@ -520,76 +1224,251 @@ bool http_conn::add_content(const char* content){
  * @todo 修改代码判 false 条件
  */
 bool http_conn::process_write(HTTP_CODE ret){
+    if(m_response_count >= MAX_PIPELINE) return false;
+    response& r = start_response();
+    int status = 200;
+
     switch (ret)
     {
         case INTERNAL_ERROR:
-            if (!(  add_status_line(500, ERROR_500_TITLE) &&
-                    add_headers(strlen(ERROR_500_FORM)) &&
-                    add_content( ERROR_500_FORM)
-                )){
-                return false;
-            }
+            status = 500;
+            if(!add_error(status)) return false;
             break;
         case BAD_REQUEST:
-            if (!(  add_status_line(400, ERROR_400_TITLE) &&
-                    add_headers(strlen(ERROR_400_FORM)) &&
-                    add_content(ERROR_400_FORM)
-                )){
-                return false;
-            }
+            status = 400;
+            if(!add_error(status)) return false;
             break;
         case NO_RESOURCE:
-            if (!(  add_status_line(404, ERROR_404_TITLE) && 
-                    add_headers(strlen(ERROR_404_FORM)) &&
-                    add_content(ERROR_404_FORM) 
-                )){
-                return false;
-            }
+            status = 404;
+            if(!add_error(status)) return false;
             break;
         case FORBIDDEN_REQUEST:
-            if (!(  add_status_line(403, ERROR_403_TITLE) &&
-                    add_headers(strlen(ERROR_403_FORM)) &&
-                    add_content(ERROR_403_FORM)
-                )){
-                return false;
+            status = 403;
+            if(!add_error(status)) return false;
+            break;
+        case METHOD_NOT_ALLOWED:{
+            char allow[router::MAX_ALLOW_LEN];
+            size_t allow_len = router::format_allow(allow, m_route ? m_route->methods : (unsigned)ROUTE_GET) - allow;
+            status = 405;
+            response_blob tail = http_response::error_tail(status, m_linger);
+            if(!(   add_status_line(status) &&
+                    add_date() &&
+                    add_raw(allow, allow_len) &&
+                    add_raw(tail.data, tail.len)
+            )) return false;
+            break;
+        }
+        case LENGTH_REQUIRED:
+            status = 411;
+            if(!add_error(status)) return false;
+            break;
+        case PAYLOAD_TOO_LARGE:
+            status = 413;
+            if(!add_error(status)) return false;
+            break;
+        case HEADER_TOO_LARGE:
+            status = 431;
+            if(!add_error(status)) return false;
+            break;
+        case HANDLER_REQUEST:{
+            // 处理函数的内容较小, 与错误页面一样直接放在写缓冲区中
+            static thread_local route_reply reply;
+            static const char CONTENT_TYPE[] = "Content-Type: ";
+            reply.status = 200;
+            reply.content_type = "text/plain";
+            reply.body.clear();
+            m_route->handler(*this, reply);
+            // 不在状态表中的状态码按 500 发送, 统计也记为 500
+            status = http_response::known_status(reply.status);
+            if(reply.body.empty() && status >= 400){
+                if(!add_error(status)) return false;
+                break;
             }
+            if(!(   add_status_line(status) &&
+                    add_date() &&
+                    add_raw(CONTENT_TYPE, sizeof(CONTENT_TYPE) - 1) &&
+                    add_raw(reply.content_type, strlen(reply.content_type)) &&
+                    add_raw("\r\n", 2) &&
+                    add_content_length(reply.body.size()) &&
+                    add_linger() &&
+                    add_blank_line() &&
+                    add_raw(reply.body.data(), reply.body.size())
+            )) return false;
             break;
+        }
         case FILE_REQUEST:
-            if(!(   add_status_line(200, OK_200_TITLE) &&
-                    add_headers(m_file_stat.st_size)
+            // Content-Length 与 Content-Type 等已在文件缓存中生成
+            if(!(   add_status_line(200) &&
+                    add_date() &&
+                    add_raw(m_file_headers->data(), m_file_headers->size()) &&
+                    add_linger() &&
+                    add_blank_line()
             )) return false;
-            m_iv[ 0 ].iov_base = m_write_buf;
-            m_iv[ 0 ].iov_len = m_write_idx;
-            m_iv[ 1 ].iov_base = m_file_address;
-            m_iv[ 1 ].iov_len = m_file_stat.st_size;
-            m_iv_count = 2;
-            return true;
+            // 文件引用移交给响应
+            r.file = m_file;
+            r.body_address = m_file_address;
+            r.body_fd = m_file_fd;
+            r.body_size = m_file_size;
+            m_file = nullptr;
+            m_file_address = 0;
+            m_file_fd = -1;
+            break;
+        case PARTIAL_REQUEST:
+            status = 206;
+            if(!(add_status_line(status) && add_date())) return false;
+            if(m_range_count == 1){
+                const byte_range& range = m_ranges[0];
+                off_t len = range.last - range.first + 1;
+                if(!(   add_content_type() &&
+                        add_content_range(range.first, range.last, m_file_stat.st_size) &&
+                        add_content_length(len) &&
+                        add_raw(m_file->validators.data(), m_file->validators.size()) &&
+                        add_linger() &&
+                        add_blank_line()
+                )) return false;
+                set_slice(r, range.first, len);
+                r.file = m_file;
+                m_file = nullptr;
+                m_file_address = 0;
+                m_file_fd = -1;
+            }else if(!add_multipart()){
+                return false;
+            }
+            break;
+        case RANGE_NOT_SATISFIABLE:{
+            status = 416;
+            response_blob tail = http_response::error_tail(status, m_linger);
+            if(!(   add_status_line(status) &&
+                    add_date() &&
+                    add_content_range(-1, -1, m_file_size) &&
+                    add_raw(tail.data, tail.len)
+            )) return false;
+            break;
+        }
+        case NOT_MODIFIED:{
+            // 没有实体; 不经过缓存时文件没有打开, 或 client 持有 gzip 版本时, 由 stat 的结果生成验证器
+            static thread_local std::string validators;
+            const std::string* headers = m_file_headers;
+            if(!headers){
+                const char* mime = m_file ? m_file->mime.c_str() : file_cache::content_type(m_real_file);
+                validators = file_cache::validators(m_file_stat, mime, m_accept_gzip);
+                headers = &validators;
+            }
+            status = 304;
+            if(!(   add_status_line(status) &&
+                    add_date() &&
+                    add_raw(headers->data(), headers->size()) &&
+                    add_linger() &&
+                    add_blank_line()
+            )) return false;
+            unmap();
+            break;
+        }
         default:
             return false;
     }
 
-    m_iv[ 0 ].iov_base = m_write_buf;
-    m_iv[ 0 ].iov_len = m_write_idx;
-    m_iv_count = 1;
+    // 多段范围响应时为最后一项
+    response& last = m_responses[m_response_count];
+    last.header_len = m_write_idx - last.header_offset;
+    last.close = !m_linger;
+    last.ready_ns = metrics::now_ns();
+    metrics::status(status);
+    m_response_count++;
     return true;
 }
 
+/**
+ * @brief 在响应队列末尾开始一个新响应, 响应头从写缓冲区当前位置开始
+ * @return {response&}
+ */
+http_conn::response& http_conn::start_response(){
+    response& r = m_responses[m_response_count];
+    r.header_offset = m_write_idx;
+    r.file = nullptr;
+    r.body_address = nullptr;
+    r.body_fd = -1;
+    r.body_offset = 0;
+    r.body_size = 0;
+    r.close = false;
+    r.part = false;
+    return r;
+}
+
+/**
+ * @brief 响应实体为当前文件中的一段: 映射模式下直接指向映射中的位置, sendfile 模式下记录文件偏移
+ * @param {response&} r
+ * @param {off_t} first 起始位置
+ * @param {off_t} len 长度
+ */
+void http_conn::set_slice(response& r, off_t first, off_t len){
+    r.body_fd = m_file_fd;
+    r.body_address = m_file_address ? m_file_address + first : nullptr;
+    r.body_offset = first;
+    r.body_size = len;
+}
+
+/**
+ * @brief 根据连接所处阶段返回对应的超时类型, 由 reactor 在连接不在线程池中时调用
+ * @return {TIMEOUT_TYPE}
+ */
+http_conn::TIMEOUT_TYPE http_conn::timeout_type() const{
+    if(m_write_idx > 0) return TIMEOUT_WRITE;                       // 响应未发送完
+    if(m_check_state == CHECK_STATE::CONTENT) return TIMEOUT_BODY;  // 头部已解析, 等待请求体
+    if(m_read_idx > 0) return TIMEOUT_HEADER;                       // 已收到部分请求
+    return TIMEOUT_IDLE;
+}
+
 /**
  * @brief 由线程池workder调用,用于处理HTTP请求
  * @return {*}
  */
 void http_conn::process(){
-    // 解析 HTTP 请求
-    HTTP_CODE read_ret = process_read();
-    if(read_ret == HTTP_CODE::NO_REQUEST){
-        modfd(m_epollfd, m_sockfd, EPOLLIN); 
-        return;
+    metrics::observe(METRIC_QUEUE_WAIT, metrics::now_ns() - m_enqueue_ns);
+    if(!process_requests()){
+        // 连接只能由所属 reactor 关闭(需要同时移除定时器),
+        // 这里关闭读写, reactor 收到 EPOLLHUP(或读到 EOF)后调用 close_conn()
+        shutdown(m_sockfd, SHUT_RDWR);
+        metrics::add(METRIC_SYSCALLS);
     }
+    // 交还给引擎: 有响应时发送, 否则继续接收; 之后不能再访问连接
+    m_engine->resume(this);
+}
+
+/**
+ * @brief 依次处理读缓冲区中的所有完整请求, 响应按顺序进入响应队列;
+ *        线程池模式下由 process() 调用, 协程引擎在 reactor 线程中直接调用
+ * @return {bool} 生成响应失败时返回 false, 需要关闭连接
+ */
+bool http_conn::process_requests(){
+    bool ok = true;
+    uint64_t start = metrics::now_ns();
+    // 依次处理读缓冲区中的所有完整请求, 响应按顺序进入响应队列, 由一次 write() 发出
+    while(m_response_count < MAX_PIPELINE && (int)m_write_buf.max_size() - m_write_idx >= PIPELINE_RESERVE){
+        // 解析 HTTP 请求
+        HTTP_CODE read_ret = process_read();
+        if(read_ret == HTTP_CODE::NO_REQUEST){
+            if(!header_too_large()) break;
+            // 请求行与头部已填满读缓冲区上限仍不完整, 返回 431 后关闭连接, 而不是直接断开
+            read_ret = HTTP_CODE::HEADER_TOO_LARGE;
+        }
+        uint64_t parsed = metrics::now_ns();
+        metrics::observe(METRIC_PARSE, parsed - start);
+        if(read_ret == HTTP_CODE::BAD_REQUEST || read_ret == HTTP_CODE::HEADER_TOO_LARGE){
+            // 无法确定下一个请求从哪里开始, 响应后关闭连接
+            m_linger = false;
+        }
 
-    // 生成响应
-    bool write_ret = process_write(read_ret);
-    if(!write_ret){
-        close_conn();
+        // 生成响应
+        if(!process_write(read_ret)){
+            unmap();
+            ok = false;
+            break;
+        }
+        bool close = m_responses[m_response_count - 1].close;
+        init_request();
+        if(close) break;
+        start = metrics::now_ns();
     }
-    modfd(m_epollfd, m_sockfd, EPOLLOUT);
-}
\ No newline at end of file
+    return ok;
+}
@@ -0,0 +1,157 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 响应头生成
+ * @Date: 2026-10-17 19:10:26
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 19:10:26
+ */
+#include "http_response.h"
+#include <cstring>
+#include <ctime>
+#include <random>
+
+#define STATUS_LINE(code, title) {"HTTP/1.1 " #code " " title "\r\n", sizeof("HTTP/1.1 " #code " " title "\r\n") - 1}
+
+/**
+ * 服务器会发出的状态码, 最后一项(500)兼作不认识的状态码
+ */
+http_response::status_entry http_response::s_status[] = {
+    {200, STATUS_LINE(200, "OK"), nullptr, {}},
+    {206, STATUS_LINE(206, "Partial Content"), nullptr, {}},
+    {304, STATUS_LINE(304, "Not Modified"), nullptr, {}},
+    {400, STATUS_LINE(400, "Bad Request"), "Your request has bad syntax or is inherently impossible to satisfy.\n", {}},
+    {403, STATUS_LINE(403, "Forbidden"), "You do not have permission to get file from this server.\n", {}},
+    {404, STATUS_LINE(404, "Not Found"), "The requested file was not found on this server.\n", {}},
+    {405, STATUS_LINE(405, "Method Not Allowed"), "The requested method is not supported for this resource.\n", {}},
+    {411, STATUS_LINE(411, "Length Required"), "The request body must be sent with a Content-Length.\n", {}},
+    {413, STATUS_LINE(413, "Payload Too Large"), "The request body is larger than the server is willing to accept.\n", {}},
+    {416, STATUS_LINE(416, "Range Not Satisfiable"), "The requested range is not satisfiable.\n", {}},
+    {431, STATUS_LINE(431, "Request Header Fields Too Large"), "The request header fields are larger than the server is willing to accept.\n", {}},
+    {500, STATUS_LINE(500, "Internal Error"), "There was an unusual problem serving the requested file.\n", {}},
+};
+
+const int http_response::s_status_number = sizeof(s_status) / sizeof(s_status[0]);
+
+/**
+ * 启动时生成所有错误响应的尾部, 之后只读, 各线程共享
+ */
+struct error_tails_init{
+    error_tails_init(){
+        for(int i = 0; i < http_response::s_status_number; i++){
+            http_response::status_entry& e = http_response::s_status[i];
+            if(!e.form) continue;
+            for(int keep_alive = 0; keep_alive < 2; keep_alive++){
+                char buf[http_response::MAX_UINT_LEN];
+                std::string& tail = e.tails[keep_alive];
+                tail = "Content-Length: ";
+                tail.append(buf, http_response::format_uint(buf, strlen(e.form)) - buf);
+                tail += "\r\nContent-Type: text/plain\r\n";
+                tail += keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+                tail += "\r\n";
+                tail += e.form;
+            }
+        }
+    }
+};
+
+static error_tails_init s_error_tails_init;
+
+http_response::status_entry* http_response::entry(int status){
+    for(int i = 0; i < s_status_number - 1; i++){
+        if(s_status[i].status == status) return &s_status[i];
+    }
+    return &s_status[s_status_number - 1];
+}
+
+const response_blob& http_response::status_line(int status){
+    return entry(status)->line;
+}
+
+int http_response::known_status(int status){
+    return entry(status)->status;
+}
+
+response_blob http_response::error_tail(int status, bool keep_alive){
+    status_entry* e = entry(status);
+    if(!e->form) e = &s_status[s_status_number - 1];
+    const std::string& tail = e->tails[keep_alive ? 1 : 0];
+    return {tail.data(), tail.size()};
+}
+
+const response_blob& http_response::date_header(){
+    static thread_local char buf[64];
+    static thread_local response_blob blob = {buf, 0};
+    static thread_local time_t last = -1;
+
+    // CLOCK_REALTIME_COARSE 不陷入内核, 只在秒数变化时重新格式化
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    if(ts.tv_sec != last){
+        static const char NAME[] = "Date: ";
+        memcpy(buf, NAME, sizeof(NAME) - 1);
+        char* p = format_date(buf + sizeof(NAME) - 1, ts.tv_sec);
+        *p++ = '\r';
+        *p++ = '\n';
+        blob.len = p - buf;
+        last = ts.tv_sec;
+    }
+    return blob;
+}
+
+char* http_response::format_date(char* out, time_t t){
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char buf[MAX_DATE_LEN + 1];
+    size_t len = strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    memcpy(out, buf, len);
+    return out + len;
+}
+
+bool http_response::parse_date(const char* value, time_t& t){
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char* end = strptime(value, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if(!end || *end != '\0') return false;
+    t = timegm(&tm);
+    return t != (time_t)-1;
+}
+
+const response_blob& http_response::boundary(){
+    static const std::string s = [](){
+        static const char HEX[] = "0123456789abcdef";
+        std::random_device rd;
+        uint64_t value = ((uint64_t)rd() << 32) | rd();
+        std::string b(16, '0');
+        for(int i = 0; i < 16; i++) b[i] = HEX[(value >> (i * 4)) & 0xf];
+        return b;
+    }();
+    static const response_blob blob = {s.data(), s.size()};
+    return blob;
+}
+
+char* http_response::format_uint(char* out, uint64_t value){
+    static const char DIGITS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char tmp[MAX_UINT_LEN];
+    char* p = tmp + MAX_UINT_LEN;
+    // 每次处理两位
+    while(value >= 100){
+        unsigned i = (unsigned)(value % 100) * 2;
+        value /= 100;
+        *--p = DIGITS[i + 1];
+        *--p = DIGITS[i];
+    }
+    if(value >= 10){
+        unsigned i = (unsigned)value * 2;
+        *--p = DIGITS[i + 1];
+        *--p = DIGITS[i];
+    }else{
+        *--p = (char)('0' + value);
+    }
+    size_t len = tmp + MAX_UINT_LEN - p;
+    memcpy(out, p, len);
+    return out + len;
+}
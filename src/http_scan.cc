@@ -0,0 +1,149 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 请求解析用的字符扫描与头部名查表
+ * @Date: 2026-10-17 17:58:20
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 17:58:20
+ */
+#include "http_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HTTP_SCAN_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * 已知头部名, 全部小写, 按长度排序; 新增头部时在 HEADER_NAME 中加一项并在这里登记
+ */
+struct header_def{
+    const char* name;
+    size_t len;
+    HEADER_NAME id;
+};
+
+static const header_def HEADER_TABLE[] = {
+    {"host",                4,  HEADER_HOST},
+    {"range",               5,  HEADER_RANGE},
+    {"accept",              6,  HEADER_ACCEPT},
+    {"cookie",              6,  HEADER_COOKIE},
+    {"expect",              6,  HEADER_EXPECT},
+    {"if-range",            8,  HEADER_IF_RANGE},
+    {"connection",          10, HEADER_CONNECTION},
+    {"user-agent",          10, HEADER_USER_AGENT},
+    {"content-type",        12, HEADER_CONTENT_TYPE},
+    {"if-none-match",       13, HEADER_IF_NONE_MATCH},
+    {"content-length",      14, HEADER_CONTENT_LENGTH},
+    {"accept-encoding",     15, HEADER_ACCEPT_ENCODING},
+    {"if-modified-since",   17, HEADER_IF_MODIFIED_SINCE},
+    {"transfer-encoding",   17, HEADER_TRANSFER_ENCODING},
+};
+
+static const size_t HEADER_TABLE_SIZE = sizeof(HEADER_TABLE) / sizeof(HEADER_TABLE[0]);
+static const size_t MAX_HEADER_NAME_LEN = 32;
+
+/**
+ * 按长度分桶的下标: s_buckets[len] 为该长度的第一项, 以 HEADER_TABLE_SIZE 结尾
+ * 表在编译期按长度排好序, 桶在第一次使用前构造
+ */
+struct header_buckets{
+    unsigned char first[MAX_HEADER_NAME_LEN + 2];
+
+    header_buckets(){
+        size_t i = 0;
+        for(size_t len = 0; len <= MAX_HEADER_NAME_LEN + 1; len++){
+            while(i < HEADER_TABLE_SIZE && HEADER_TABLE[i].len < len) i++;
+            first[len] = (unsigned char)i;
+        }
+    }
+};
+
+static const header_buckets s_buckets;
+
+/**
+ * 头部名只由 token 字符组成, 与 0x20 按位或即可得到小写字母, 其余字符不变
+ */
+static bool equal_lower(const char* text, const char* lower, size_t len){
+    for(size_t i = 0; i < len; i++){
+        if((text[i] | 0x20) != lower[i]) return false;
+    }
+    return true;
+}
+
+HEADER_NAME http_scan::header_name(const char* name, size_t len){
+    if(len == 0 || len > MAX_HEADER_NAME_LEN) return HEADER_UNKNOWN;
+    for(size_t i = s_buckets.first[len]; i < s_buckets.first[len + 1]; i++){
+        if(equal_lower(name, HEADER_TABLE[i].name, len)) return HEADER_TABLE[i].id;
+    }
+    return HEADER_UNKNOWN;
+}
+
+static const char* find_scalar(const char* begin, const char* end, char c){
+    while(begin < end && *begin != c) begin++;
+    return begin;
+}
+
+#ifdef HTTP_SCAN_X86
+static const char* find_sse2(const char* begin, const char* end, char c){
+    const __m128i needle = _mm_set1_epi8(c);
+    while(end - begin >= 16){
+        __m128i chunk = _mm_loadu_si128((const __m128i*)begin);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if(mask) return begin + __builtin_ctz(mask);
+        begin += 16;
+    }
+    return find_scalar(begin, end, c);
+}
+
+__attribute__((target("avx2")))
+static const char* find_avx2(const char* begin, const char* end, char c){
+    const __m256i needle = _mm256_set1_epi8(c);
+    while(end - begin >= 32){
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)begin);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+        if(mask) return begin + __builtin_ctz(mask);
+        begin += 32;
+    }
+    return find_sse2(begin, end, c);
+}
+#endif
+
+/**
+ * @brief 选择 CPU 支持的最快实现
+ */
+static http_scan::ISA detect(){
+#ifdef HTTP_SCAN_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) return http_scan::AVX2;
+    if(__builtin_cpu_supports("sse2")) return http_scan::SSE2;
+#endif
+    return http_scan::SCALAR;
+}
+
+static http_scan::find_func resolve(http_scan::ISA isa){
+    switch(isa){
+#ifdef HTTP_SCAN_X86
+        case http_scan::AVX2: return find_avx2;
+        case http_scan::SSE2: return find_sse2;
+#endif
+        default: return find_scalar;
+    }
+}
+
+http_scan::ISA http_scan::s_isa = detect();
+http_scan::find_func http_scan::s_find = resolve(http_scan::s_isa);
+
+bool http_scan::select(ISA isa){
+    if(isa > detect()) return false;
+    s_isa = isa;
+    s_find = resolve(isa);
+    return true;
+}
+
+const char* http_scan::isa_name(ISA isa){
+    switch(isa){
+        case AVX2: return "avx2";
+        case SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
@@ -0,0 +1,338 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 异步日志实现
+ * @Date: 2026-10-17 19:42:15
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 19:42:15
+ */
+#include "log.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+
+#define LOG_PADDING 0xff                    // 缓冲区末尾放不下一条记录时的填充
+#define LOG_FLUSH_INTERVAL_MS 10            // 后台线程空闲时的检查间隔
+#define LOG_OUTPUT_SIZE (64 * 1024)         // 批量写入的大小
+#define LOG_LINE_MAX 4096                   // 单条日志格式化后的最大长度
+
+/**
+ * 单生产者(所属线程)单消费者(后台线程)的环形缓冲区
+ * head/tail 为累计字节数, 不回绕, 取模得到位置
+ */
+struct log_ring{
+    char* data;
+    int tid;
+    log_ring* next;                                 // 所有缓冲区组成的链表, 只在头部插入
+    alignas(64) std::atomic<size_t> head;           // 生产者写入位置
+    size_t cached_tail;                             // 生产者看到的消费位置, 减少对 tail 的读取
+    uint64_t dropped;
+    alignas(64) std::atomic<size_t> tail;           // 消费者读取位置
+    std::atomic<uint64_t> dropped_total;
+};
+
+static std::atomic<log_ring*> s_rings(nullptr);
+static thread_local log_ring* t_ring = nullptr;
+static int s_fd = STDOUT_FILENO;
+static pthread_t s_flusher;
+static std::atomic<bool> s_running(false);
+static std::mutex s_stop_mutex;
+
+/**
+ * @brief 当前线程的缓冲区, 第一次记录日志时创建并登记, 线程退出后不释放(线程都是常驻的)
+ */
+static log_ring* ring(){
+    if(t_ring) return t_ring;
+    log_ring* r = new log_ring();
+    r->data = (char*)aligned_alloc(64, logger::RING_SIZE);
+    r->tid = (int)syscall(SYS_gettid);
+    r->head.store(0, std::memory_order_relaxed);
+    r->tail.store(0, std::memory_order_relaxed);
+    r->cached_tail = 0;
+    r->dropped = 0;
+    r->dropped_total.store(0, std::memory_order_relaxed);
+    r->next = s_rings.load(std::memory_order_relaxed);
+    while(!s_rings.compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed)){}
+    t_ring = r;
+    return r;
+}
+
+/**
+ * @brief 在当前线程的缓冲区中预留 size 字节, 需要时在末尾写入填充
+ * @return {char*} 空间不足时返回 nullptr, 日志被丢弃
+ */
+char* logger::begin(size_t size){
+    log_ring* r = ring();
+    size_t head = r->head.load(std::memory_order_relaxed);
+    size_t pos = head & (RING_SIZE - 1);
+    size_t pad = RING_SIZE - pos < size ? RING_SIZE - pos : 0;
+    if(head + pad + size - r->cached_tail > RING_SIZE){
+        r->cached_tail = r->tail.load(std::memory_order_acquire);
+        if(head + pad + size - r->cached_tail > RING_SIZE){
+            r->dropped++;
+            r->dropped_total.store(r->dropped, std::memory_order_relaxed);
+            return nullptr;
+        }
+    }
+    if(pad){
+        record* p = (record*)(r->data + pos);
+        p->size = (uint32_t)pad;
+        p->level = LOG_PADDING;
+        r->head.store(head + pad, std::memory_order_release);
+        pos = 0;
+    }
+    return r->data + pos;
+}
+
+void logger::commit(size_t size){
+    log_ring* r = t_ring;
+    r->head.store(r->head.load(std::memory_order_relaxed) + size, std::memory_order_release);
+}
+
+void logger::stamp(record* r){
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    r->sec = ts.tv_sec;
+    r->nsec = (uint32_t)ts.tv_nsec;
+}
+
+uint64_t logger::dropped(){
+    uint64_t total = 0;
+    for(log_ring* r = s_rings.load(std::memory_order_acquire); r; r = r->next){
+        total += r->dropped_total.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+/**
+ * 记录中的参数, 按格式串中的转换依次取出
+ */
+struct arg_reader{
+    const char* p;
+    int left;
+
+    bool next(uint8_t& type, const char*& value){
+        if(left == 0) return false;
+        left--;
+        type = (uint8_t)*p;
+        if(type == logger::ARG_STRING){
+            uint16_t len;
+            memcpy(&len, p + 1, 2);
+            value = p + 3;
+            p += 4 + len;
+        }else{
+            value = p + 1;
+            p += 9;
+        }
+        return true;
+    }
+};
+
+static int64_t as_int(uint8_t type, const char* value){
+    if(type == logger::ARG_DOUBLE){
+        double d;
+        memcpy(&d, value, 8);
+        return (int64_t)d;
+    }
+    if(type == logger::ARG_STRING) return 0;
+    int64_t i;
+    memcpy(&i, value, 8);
+    return i;
+}
+
+/**
+ * @brief 按格式串与记录中的参数格式化一条日志
+ *        每个转换说明单独交给 snprintf, 整数统一加上 ll 长度修饰
+ * @return {int} 写入的长度
+ */
+static int format_record(char* out, int size, const logger::record* r){
+    arg_reader args = {(const char*)(r + 1), r->argc};
+    const char* f = r->fmt;
+    int n = 0;
+    while(*f && n < size - 1){
+        if(*f != '%'){
+            out[n++] = *f++;
+            continue;
+        }
+        if(f[1] == '%'){
+            out[n++] = '%';
+            f += 2;
+            continue;
+        }
+        // 转换说明: %[flags][width][.precision][length]conversion, '*' 取一个整数参数
+        char spec[64];
+        int len = 0;
+        spec[len++] = *f++;
+        while(*f && strchr("-+ #0", *f) && len < 40) spec[len++] = *f++;
+        for(int part = 0; part < 2; part++){
+            if(part == 1){
+                if(*f != '.') break;
+                spec[len++] = *f++;
+            }
+            if(*f == '*'){
+                uint8_t type;
+                const char* value;
+                int v = args.next(type, value) ? (int)as_int(type, value) : 0;
+                len += snprintf(spec + len, 16, "%d", v);
+                f++;
+            }else{
+                while(*f >= '0' && *f <= '9' && len < 40) spec[len++] = *f++;
+            }
+        }
+        while(*f && strchr("hlLqjzt", *f)) f++;
+        char conv = *f;
+        if(!conv) break;
+        f++;
+
+        uint8_t type;
+        const char* value;
+        if(!args.next(type, value)){
+            n += snprintf(out + n, size - n, "(missing)");
+            continue;
+        }
+        int written = 0;
+        if(strchr("diouxXc", conv)){
+            if(conv != 'c'){
+                spec[len++] = 'l';
+                spec[len++] = 'l';
+            }
+            spec[len++] = conv;
+            spec[len] = '\0';
+            int64_t i = as_int(type, value);
+            if(conv == 'c') written = snprintf(out + n, size - n, spec, (int)i);
+            else if(conv == 'd' || conv == 'i') written = snprintf(out + n, size - n, spec, (long long)i);
+            else written = snprintf(out + n, size - n, spec, (unsigned long long)i);
+        }else if(strchr("fFeEgGaA", conv)){
+            spec[len++] = conv;
+            spec[len] = '\0';
+            double d;
+            if(type == logger::ARG_DOUBLE) memcpy(&d, value, 8);
+            else d = (double)as_int(type, value);
+            written = snprintf(out + n, size - n, spec, d);
+        }else if(conv == 's'){
+            spec[len++] = conv;
+            spec[len] = '\0';
+            written = snprintf(out + n, size - n, spec, type == logger::ARG_STRING ? value : "(bad)");
+        }else if(conv == 'p'){
+            void* ptr;
+            memcpy(&ptr, value, 8);
+            written = snprintf(out + n, size - n, "%p", ptr);
+        }
+        n += written;
+    }
+    if(n > size - 1) n = size - 1;
+    return n;
+}
+
+static void write_all(const char* data, size_t len){
+    while(len > 0){
+        ssize_t n = write(s_fd, data, len);
+        if(n < 0){
+            if(errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief 取出所有缓冲区中的日志, 格式化后批量写入
+ * @return {bool} 是否取到日志
+ */
+static bool drain(char* out, size_t& used){
+    static const char* LEVELS[] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+    static thread_local time_t last_sec = -1;
+    static thread_local char time_buf[32];
+
+    bool any = false;
+    for(log_ring* r = s_rings.load(std::memory_order_acquire); r; r = r->next){
+        size_t tail = r->tail.load(std::memory_order_relaxed);
+        size_t head = r->head.load(std::memory_order_acquire);
+        while(tail != head){
+            const logger::record* rec = (const logger::record*)(r->data + (tail & (logger::RING_SIZE - 1)));
+            if(rec->level != LOG_PADDING){
+                if(LOG_OUTPUT_SIZE - used < LOG_LINE_MAX){
+                    write_all(out, used);
+                    used = 0;
+                }
+                if(rec->sec != last_sec){
+                    struct tm tm;
+                    time_t sec = (time_t)rec->sec;
+                    localtime_r(&sec, &tm);
+                    strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &tm);
+                    last_sec = rec->sec;
+                }
+                char* line = out + used;
+                int n = snprintf(line, LOG_LINE_MAX, "%s.%06u %s %d ", time_buf,
+                                 rec->nsec / 1000, LEVELS[rec->level & 3], r->tid);
+                n += format_record(line + n, LOG_LINE_MAX - n - 1, rec);
+                // 原来的输出大多自带换行, 统一去掉后再加一个
+                while(n > 0 && line[n - 1] == '\n') n--;
+                line[n++] = '\n';
+                used += n;
+            }
+            tail += rec->size;
+            any = true;
+        }
+        r->tail.store(tail, std::memory_order_release);
+    }
+    return any;
+}
+
+static void* flusher(void*){
+    char* out = (char*)malloc(LOG_OUTPUT_SIZE);
+    size_t used = 0;
+    uint64_t reported = 0;
+    while(true){
+        bool running = s_running.load(std::memory_order_acquire);
+        bool any = drain(out, used);
+        uint64_t dropped = logger::dropped();
+        if(dropped != reported && LOG_OUTPUT_SIZE - used >= LOG_LINE_MAX){
+            used += snprintf(out + used, LOG_LINE_MAX, "log buffer full, %llu messages dropped\n",
+                             (unsigned long long)(dropped - reported));
+            reported = dropped;
+        }
+        if(used > 0){
+            write_all(out, used);
+            used = 0;
+        }
+        if(!running) break;
+        if(!any){
+            struct timespec ts = {0, LOG_FLUSH_INTERVAL_MS * 1000000L};
+            nanosleep(&ts, nullptr);
+        }
+    }
+    free(out);
+    return nullptr;
+}
+
+bool logger::init(const char* path){
+    if(path){
+        s_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if(s_fd < 0){
+            s_fd = STDOUT_FILENO;
+            return false;
+        }
+    }
+    s_running.store(true, std::memory_order_release);
+    if(pthread_create(&s_flusher, nullptr, flusher, nullptr) != 0){
+        s_running.store(false, std::memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+void logger::stop(){
+    std::lock_guard<std::mutex> guard(s_stop_mutex);
+    if(!s_running.exchange(false)) return;
+    pthread_join(s_flusher, nullptr);
+    if(s_fd != STDOUT_FILENO) close(s_fd);
+    s_fd = STDOUT_FILENO;
+}
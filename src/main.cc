@@ -9,9 +9,14 @@
 #include"locker.h"
 #include"threadpool.h"
 #include"http_conn.h"
+#include"eventloop.h"
+#include"log.h"
+#include<vector>
+#include<climits>
+#include<sys/stat.h>
 
-#define MAX_FD 65535                // 最大描述符个数, 即最大服务客户端数量
-#define MAX_EVENT_NUMBER 10000      // 监听的最大数量
+#define DEFAULT_CACHE_ENTRIES 1024                  // 静态文件缓存默认文件数
+#define DEFAULT_CACHE_BYTES (64 * 1024 * 1024)      // 静态文件缓存默认总大小
 
 
 /**
@@ -38,36 +43,215 @@ void addsig(int sig, void (handler)(int)){
 }
 
 /**
- * @brief 将 fd 添加到 epoll中
- * @param {int} epollfd epoll描述符
- * @param {int} fd 描述符
- * @param {bool} one_shot 保证socket只被一个线程处理
+ * @brief 打印启动参数
+ * @param {char*} name 程序名
  */
-extern void addfd(int epollfd, int fd, bool one_shot);
+void usage(const char* name){
+    std::cout << "未输入正确参数，期望格式如下" << std::endl;
+    printf("%s [-t thread_number] [-w] [-m] [-c cache_entries] [-o idle,header,body,write] [-b read,write] [-l log_file] [-e epoll|uring|coro] [-q backlog] [-s] [-a max_age] [-u max_body,spill,chunk] [-r doc_root] {port} [loop_number]\n", name);
+    printf("  -t  线程池线程数, 默认 8\n");
+    printf("  -w  线程池使用 work stealing 调度\n");
+    printf("  -m  文件使用 mmap + writev 发送, 默认使用 sendfile 零拷贝\n");
+    printf("  -c  静态文件缓存的最大文件数, 默认 %d, 0 表示不缓存\n", DEFAULT_CACHE_ENTRIES);
+    printf("  -o  连接各阶段超时(ms): keep-alive 空闲, 读头部, 读请求体, 发送; 0 表示不超时\n");
+    printf("      默认 %d,%d,%d,%d\n", DEFAULT_IDLE_TIMEOUT, DEFAULT_HEADER_TIMEOUT,
+            DEFAULT_BODY_TIMEOUT, DEFAULT_WRITE_TIMEOUT);
+    printf("  -b  连接读/写缓冲区上限(字节), 默认 %d,%d; 读缓冲区上限即最大请求头长度\n",
+            http_conn::m_read_buffer_max, http_conn::m_write_buffer_max);
+    printf("  -l  日志文件, 默认写到标准输出\n");
+    printf("  -e  事件引擎 epoll 或 uring, 默认 epoll; io_uring 不可用时退回 epoll, uring 下文件使用 mmap 发送\n");
+    printf("      coro: epoll 上每个连接一个协程, 请求直接在 reactor 线程中处理, 不经过线程池(需要 NK_COROUTINE 编译)\n");
+    printf("  -q  监听队列长度, 默认 %d, 不超过 net.core.somaxconn\n", DEFAULT_BACKLOG);
+    printf("  -s  多个 reactor 共享一个监听 socket(EPOLLEXCLUSIVE), 默认各自监听(SO_REUSEPORT)\n");
+    printf("  -a  静态文件 Cache-Control 的 max-age(秒), 默认 0 即 no-cache, 每次使用前用 ETag 验证\n");
+    printf("  -u  请求体上限、写入临时文件的阈值与交给路由请求体处理函数的块长(字节), 默认 %ld,%ld,%ld;\n"
+           "      临时文件放在 $TMPDIR, 默认 /tmp\n",
+            http_conn::m_max_body, http_conn::m_spill_threshold, http_conn::m_body_chunk);
+    printf("  -r  静态文件根目录, 默认 %s; 没有命中路由(" METRICS_URL ", " UPLOAD_URL ", " HEALTH_URL " 等)的请求映射到其下的文件\n", DOC_ROOT);
+}
 
 /**
- * @brief 从 epoll 中删除 fd
- * @param epollfd epoll描述符
- * @param fd 描述符
+ * @brief 解析 "read,write" 格式的缓冲区上限, 可只给出读缓冲区
+ * @param {char*} arg 参数
+ * @return {bool} 格式是否正确
  */
-extern void removefd(int epollfd, int fd);
+bool parse_buffers(const char* arg){
+    char* end = nullptr;
+    long value = strtol(arg, &end, 10);
+    if(end == arg || value < http_conn::READ_BUFFER_SIZE) return false;
+    http_conn::m_read_buffer_max = (int)value;
+    if(*end == '\0') return true;
+    if(*end != ',') return false;
+    arg = end + 1;
+    value = strtol(arg, &end, 10);
+    // 写缓冲区至少要放下一个流水线响应的预留空间
+    if(end == arg || *end != '\0' || value < http_conn::PIPELINE_RESERVE) return false;
+    http_conn::m_write_buffer_max = (int)value;
+    return true;
+}
 
 /**
- * @brief 修改 描述符状态
- * @param epollfd epoll描述符
- * @param fd 描述符
- * @param ev 描述符
+ * @brief 设置静态文件根目录: 转为绝对路径, 必须是目录, 并给请求路径留出足够的长度
+ * @param {char*} path 参数
+ * @return {bool} 是否可用
  */
-extern void modfd(int epollfd, int fd, int ev);
+bool set_doc_root(const char* path){
+    char* root = realpath(path, nullptr);
+    struct stat st;
+    if(!root || stat(root, &st) != 0 || !S_ISDIR(st.st_mode) || strlen(root) >= http_conn::FILENAME_LEN / 2){
+        free(root);
+        return false;
+    }
+    // 进程生命周期内有效
+    DOC_ROOT = root;
+    return true;
+}
+
+/**
+ * @brief 解析 "max_body,spill_threshold,chunk" 格式的请求体参数, 可只给出前几项
+ * @param {char*} arg 参数
+ * @return {bool} 格式是否正确
+ */
+bool parse_body_limits(const char* arg){
+    char* end = nullptr;
+    long value = strtol(arg, &end, 10);
+    if(end == arg || value < 0) return false;
+    http_conn::m_max_body = value;
+    if(*end == '\0') return true;
+    if(*end != ',') return false;
+    arg = end + 1;
+    value = strtol(arg, &end, 10);
+    if(end == arg || value < 0) return false;
+    http_conn::m_spill_threshold = value;
+    if(*end == '\0') return true;
+    if(*end != ',') return false;
+    arg = end + 1;
+    value = strtol(arg, &end, 10);
+    if(end == arg || *end != '\0' || value <= 0) return false;
+    http_conn::m_body_chunk = value;
+    return true;
+}
+
+/**
+ * @brief 解析 "idle,header,body,write" 格式的超时参数, 可只给出前几项
+ * @param {char*} arg 参数
+ * @param {int*} timeouts 输出, 下标为 http_conn::TIMEOUT_TYPE
+ * @return {bool} 格式是否正确
+ */
+bool parse_timeouts(const char* arg, int* timeouts){
+    for(int i = 0; i < http_conn::TIMEOUT_NUMBER && *arg; i++){
+        char* end = nullptr;
+        long value = strtol(arg, &end, 10);
+        if(end == arg || value < 0) return false;
+        timeouts[i] = (int)value;
+        if(*end == ',') end++;
+        else if(*end != '\0') return false;
+        arg = end;
+    }
+    return true;
+}
 
 int main(int argc, char* argv[]){
-    if(argc < 2){
-        std::cout << "未输入正确参数，期望格式如下" << std::endl;
-        printf("%s {port}\n", basename(argv[0]));
+    int thread_number = 8;
+    POOL_MODE pool_mode = SHARED_QUEUE;
+    int cache_entries = DEFAULT_CACHE_ENTRIES;
+    int timeouts[http_conn::TIMEOUT_NUMBER] = {
+        DEFAULT_IDLE_TIMEOUT, DEFAULT_HEADER_TIMEOUT, DEFAULT_BODY_TIMEOUT, DEFAULT_WRITE_TIMEOUT
+    };
+    const char* log_file = NULL;
+    ENGINE_TYPE engine = ENGINE_EPOLL;
+    int backlog = DEFAULT_BACKLOG;
+    bool shared_listener = false;
+    int opt;
+    while((opt = getopt(argc, argv, "t:wmc:o:b:l:e:q:sa:u:r:")) != -1){
+        switch(opt){
+            case 't': thread_number = atoi(optarg); break;
+            case 'w': pool_mode = WORK_STEALING; break;
+            case 'm': http_conn::m_use_sendfile = false; break;
+            case 'c': cache_entries = atoi(optarg); break;
+            case 'o':
+                if(!parse_timeouts(optarg, timeouts)){
+                    usage(basename(argv[0]));
+                    return 1;
+                }
+                break;
+            case 'b':
+                if(!parse_buffers(optarg)){
+                    usage(basename(argv[0]));
+                    return 1;
+                }
+                break;
+            case 'l': log_file = optarg; break;
+            case 'e':
+                if(strcmp(optarg, "epoll") == 0){
+                    engine = ENGINE_EPOLL;
+#ifdef NK_COROUTINE
+                }else if(strcmp(optarg, "coro") == 0){
+                    engine = ENGINE_CORO;
+#endif
+                }else if(strcmp(optarg, "uring") == 0){
+                    // io_uring 没有 sendfile 操作, 文件实体映射后与响应头一起 sendmsg
+                    engine = ENGINE_URING;
+                    http_conn::m_use_sendfile = false;
+                }else{
+                    usage(basename(argv[0]));
+                    return 1;
+                }
+                break;
+            case 'q':
+                backlog = atoi(optarg);
+                if(backlog <= 0){
+                    usage(basename(argv[0]));
+                    return 1;
+                }
+                break;
+            case 's': shared_listener = true; break;
+            case 'a':
+                file_cache::m_max_age = atoi(optarg);
+                if(file_cache::m_max_age < 0){
+                    usage(basename(argv[0]));
+                    return 1;
+                }
+                break;
+            case 'u':
+                if(!parse_body_limits(optarg)){
+                    usage(basename(argv[0]));
+                    return 1;
+                }
+                break;
+            case 'r':
+                if(!set_doc_root(optarg)){
+                    printf("Invalid doc root %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                usage(basename(argv[0]));
+                return 1;
+        }
+    }
+    if(optind >= argc){
+        usage(basename(argv[0]));
+        return 1;
+    }
+
+    int port = atoi(argv[optind]);
+    // reactor 数量, 默认 1 即单 reactor; 大于 1 时每个 reactor 使用 SO_REUSEPORT 独立监听
+    int loop_number = optind + 1 < argc ? atoi(argv[optind + 1]) : 1;
+    if(loop_number <= 0){
+        loop_number = sysconf(_SC_NPROCESSORS_ONLN);
+        if(loop_number <= 0) loop_number = 1;
+    }
+
+    // 日志由后台线程写出, 退出时写完缓冲区中剩余的日志
+    if(!logger::init(log_file)){
+        printf("Open log file %s failed, errno: %d\n", log_file ? log_file : "stdout", errno);
         return 1;
     }
+    atexit(logger::stop);
 
-    int port = atoi(argv[1]);
+    const char* tmpdir = getenv("TMPDIR");
+    if(tmpdir && *tmpdir) http_conn::m_spill_dir = tmpdir;
 
     // SIGPIPE : 往 读端被关闭的管道 或者 socket连接中写数据
     // SIG_IGN : 忽略 SIGPIPE 的信号，本项目中用于忽略向 socket 连接中写数据
@@ -76,93 +260,81 @@ int main(int argc, char* argv[]){
     // 线程池
     threadpool<http_conn> *pool = NULL;
     try{
-        pool = new threadpool<http_conn>();
+        pool = new threadpool<http_conn>(thread_number, 10000, pool_mode);
     }catch(...) {
         return 1;
     }
     sleep(1);           // 增加了 sleep(1) 就能运行?
-    // 保存所有 client 信息
-    http_conn *users = new http_conn[MAX_FD];
-
-    // 监听 socket 描述符
-    int listenfd = socket(PF_INET, SOCK_STREAM, 0);
-
-    // 绑定
-    struct sockaddr_in address;
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(port);     // host to net short
-
-    // 设置端口复用
-    int resue = 1;
-    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &resue, sizeof(resue));
-    bind(listenfd, (struct sockaddr*) &address, sizeof(address));
-    // 监听 {监听socket, 最大监听数目?}
-    listen(listenfd, 5);
-
-    epoll_event events[MAX_EVENT_NUMBER];
-    int epollfd = epoll_create(5);
-
-    addfd(epollfd, listenfd, false);
-    http_conn::m_epollfd = epollfd;
-
-    while(true){
-        // epollfd : epoll 描述符
-        // events : 记录事件的具体信息，包括描述符、结果等
-        // MAX_EVENT_NUMBER - 1 : 最大事件数量
-        // -1 : 是否设置最长处理时间
-        std::cout << "Waiting Connection..." << std::endl;
-        int num = epoll_wait(epollfd, events, MAX_EVENT_NUMBER - 1, -1);
-
-        // ! 这里有修改
-        if(num < 0 && errno != EINTR){
-            std::cout << "EPOLL FAILURE" << std::endl;
-            break;
+
+    // 静态文件缓存, 依赖 inotify 使修改过的文件失效, 无法监听时不使用缓存
+    file_cache *cache = NULL;
+    if(cache_entries > 0){
+        cache = new file_cache(cache_entries, DEFAULT_CACHE_BYTES, !http_conn::m_use_sendfile);
+        if(cache->watch(DOC_ROOT)){
+            http_conn::m_file_cache = cache;
+        }else{
+            LOG_WARN("Watch %s failed, errno: %d, file cache disabled", DOC_ROOT, errno);
+            delete cache;
+            cache = NULL;
         }
+    }
+    // 读取 METRICS_URL 时计算的指标
+    metrics::add_gauge("nk_connections", "Open client connections.",
+                       [](void*) -> long { return http_conn::m_usercount.load(std::memory_order_relaxed); }, nullptr);
+    metrics::add_gauge("nk_queue_depth", "Requests waiting in the thread pool.",
+                       [](void* arg) -> long { return ((threadpool<http_conn>*)arg)->queue_depth(); }, pool);
 
-        for(int i = 0; i < num; i++){
-            // client 连接的 socket
-            int sockfd = events[i].data.fd;
-            if(sockfd == listenfd){
-                struct sockaddr_in client_addr;
-                socklen_t client_addrlen = sizeof(client_addr);
-
-                int connfd = accept(listenfd, (struct sockaddr*)&client_addr, &client_addrlen);
-                if(connfd < 0){
-                    printf("Errno in : %d\n", errno);
-                    continue;
-                }
-                printf("Client socket fd is: %d\n", connfd);
-                if(http_conn::m_usercount >= MAX_FD){
-                    printf("The connection pool is full and the server is busy\n");
-                    close(connfd);
-                    continue;
-                }
-                users[connfd].init(connfd, client_addr);
-            }else if(events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)){
-                users[sockfd].close_conn();
-            }else if(events[i].events & EPOLLIN){
-                printf("发生读事件\n");
-                if(users[sockfd].read()){
-                    // ?放入待处理队列
-                    printf("读事件进入待处理队列\n");
-                    pool->append(users + sockfd);
-                }else{
-                    users[sockfd].close_conn();
-                }
-            }else if(events[i].events & EPOLLOUT){
-                printf("发生写事件\n");
-                if(!users[sockfd].write()){
-                    users[sockfd].close_conn();
-                }
+    // 连接对象由各个 reactor 在 accept 时从自己的 slab 中分配
+    std::vector<eventloop*> loops;
+    metrics::add_gauge("nk_connection_memory_bytes", "Memory held by connection objects, including empty spare slabs.",
+                       [](void* arg) -> long {
+                           long bytes = 0;
+                           for(eventloop* el : *(std::vector<eventloop*>*)arg) bytes += el->conn_bytes();
+                           return bytes;
+                       }, &loops);
+    // 共享时只创建一个监听 socket, 否则每个 reactor 一个, 多个时使用 SO_REUSEPORT
+    bool shared = shared_listener && loop_number > 1;
+    int shared_fd = -1;
+    for(int i = 0; i < loop_number; i++){
+        int listenfd = shared_fd;
+        if(listenfd == -1){
+            listenfd = eventloop::open_listener(port, backlog, loop_number > 1 && !shared);
+            if(listenfd < 0){
+                LOG_ERROR("Listen on port %d failed, errno: %d", port, errno);
+                for(eventloop* l : loops) delete l;
+                delete pool;
+                return 1;
             }
+            if(shared) shared_fd = listenfd;
+        }
+        eventloop* el = new eventloop(listenfd, shared, pool, timeouts, engine);
+        if(!el->init()){
+            LOG_ERROR("Init event loop %d failed, errno: %d", i, errno);
+            delete el;
+            for(eventloop* l : loops) delete l;
+            if(shared_fd != -1) close(shared_fd);
+            delete pool;
+            return 1;
         }
+        loops.push_back(el);
     }
 
-    close(epollfd);
-    close(listenfd);
-    delete [] users;
+    // 第 0 个 reactor 在主线程中运行, 其余各自一个线程
+    for(int i = 1; i < loop_number; i++){
+        if(!loops[i]->start()){
+            LOG_ERROR("Start event loop %d failed", i);
+            return 1;
+        }
+    }
+    loops[0]->loop();
+
+    for(int i = 1; i < loop_number; i++){
+        loops[i]->join();
+    }
+    for(eventloop* el : loops) delete el;
+    if(shared_fd != -1) close(shared_fd);
     delete pool;
+    delete cache;
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,135 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 运行指标实现
+ * @Date: 2026-10-17 20:48:06
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 20:48:06
+ */
+#include "metrics.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#define MAX_GAUGES 8
+
+struct counter_def{
+    const char* name;
+    const char* help;
+};
+
+static const counter_def COUNTERS[METRIC_COUNTER_NUMBER] = {
+    {"nk_accepts_total", "Accepted connections."},
+    {"nk_sent_bytes_total", "Bytes sent, headers and bodies."},
+    {"nk_queue_full_total", "Connections closed because the request queue was full."},
+    {"nk_timeouts_total", "Connections closed by a timeout."},
+    {"nk_syscalls_total", "System calls on the connection I/O path: accept, epoll, recv, send, io_uring_enter and the like."},
+};
+
+static const counter_def HISTOGRAMS[METRIC_HISTOGRAM_NUMBER] = {
+    {"nk_queue_wait_seconds", "Time from entering the thread pool to being processed."},
+    {"nk_parse_seconds", "Time to parse one request."},
+    {"nk_send_seconds", "Time from a response being queued to its last byte being sent."},
+};
+
+struct gauge_def{
+    const char* name;
+    const char* help;
+    metrics::gauge_func fn;
+    void* arg;
+};
+
+static gauge_def s_gauges[MAX_GAUGES];
+static int s_gauge_number = 0;
+static std::atomic<metrics::shard*> s_shards(nullptr);
+
+thread_local metrics::shard* metrics::t_shard = nullptr;
+
+/**
+ * @brief 当前线程第一次记录时创建 shard, 按 cache line 对齐, 线程退出后保留(数据仍计入总数)
+ */
+metrics::shard* metrics::create(){
+    void* p = aligned_alloc(64, (sizeof(shard) + 63) / 64 * 64);
+    shard* s = new(p) shard();
+    for(auto& c : s->counters) c.store(0, std::memory_order_relaxed);
+    for(auto& c : s->status) c.store(0, std::memory_order_relaxed);
+    for(auto& h : s->buckets) for(auto& b : h) b.store(0, std::memory_order_relaxed);
+    for(auto& c : s->sum) c.store(0, std::memory_order_relaxed);
+    s->next = s_shards.load(std::memory_order_relaxed);
+    while(!s_shards.compare_exchange_weak(s->next, s, std::memory_order_release, std::memory_order_relaxed)){}
+    t_shard = s;
+    return s;
+}
+
+void metrics::add_gauge(const char* name, const char* help, gauge_func fn, void* arg){
+    if(s_gauge_number == MAX_GAUGES) return;
+    s_gauges[s_gauge_number++] = {name, help, fn, arg};
+}
+
+static void append(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+static void append(std::string& out, const char* format, ...){
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if(n > 0) out.append(buf, n < (int)sizeof(buf) ? n : sizeof(buf) - 1);
+}
+
+/**
+ * 直方图只输出 4 的幂(纳秒)作为 le 边界, 从 1us 到约 69s; 这些边界与子桶对齐, 因此是精确的
+ */
+#define HISTOGRAM_MIN_SHIFT 10
+#define HISTOGRAM_MAX_SHIFT 36
+
+void metrics::render(std::string& out){
+    uint64_t counters[METRIC_COUNTER_NUMBER] = {0};
+    static thread_local uint64_t status[MAX_STATUS - MIN_STATUS + 1];
+    static thread_local uint64_t buckets[METRIC_HISTOGRAM_NUMBER][BUCKETS];
+    uint64_t sum[METRIC_HISTOGRAM_NUMBER] = {0};
+    memset(status, 0, sizeof(status));
+    memset(buckets, 0, sizeof(buckets));
+
+    for(shard* s = s_shards.load(std::memory_order_acquire); s; s = s->next){
+        for(int i = 0; i < METRIC_COUNTER_NUMBER; i++) counters[i] += s->counters[i].load(std::memory_order_relaxed);
+        for(int i = 0; i <= MAX_STATUS - MIN_STATUS; i++) status[i] += s->status[i].load(std::memory_order_relaxed);
+        for(int h = 0; h < METRIC_HISTOGRAM_NUMBER; h++){
+            for(int i = 0; i < BUCKETS; i++) buckets[h][i] += s->buckets[h][i].load(std::memory_order_relaxed);
+            sum[h] += s->sum[h].load(std::memory_order_relaxed);
+        }
+    }
+
+    out.clear();
+    for(int i = 0; i < METRIC_COUNTER_NUMBER; i++){
+        append(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", COUNTERS[i].name, COUNTERS[i].help,
+               COUNTERS[i].name, COUNTERS[i].name, (unsigned long long)counters[i]);
+    }
+
+    append(out, "# HELP nk_requests_total Responses by status code.\n# TYPE nk_requests_total counter\n");
+    for(int i = 0; i <= MAX_STATUS - MIN_STATUS; i++){
+        if(status[i]) append(out, "nk_requests_total{code=\"%d\"} %llu\n", i + MIN_STATUS, (unsigned long long)status[i]);
+    }
+
+    for(int g = 0; g < s_gauge_number; g++){
+        append(out, "# HELP %s %s\n# TYPE %s gauge\n%s %ld\n", s_gauges[g].name, s_gauges[g].help,
+               s_gauges[g].name, s_gauges[g].name, s_gauges[g].fn(s_gauges[g].arg));
+    }
+
+    for(int h = 0; h < METRIC_HISTOGRAM_NUMBER; h++){
+        const char* name = HISTOGRAMS[h].name;
+        append(out, "# HELP %s %s\n# TYPE %s histogram\n", name, HISTOGRAMS[h].help, name);
+        uint64_t cumulative = 0;
+        int i = 0;
+        for(int shift = HISTOGRAM_MIN_SHIFT; shift <= HISTOGRAM_MAX_SHIFT; shift += 2){
+            uint64_t le = 1ull << shift;
+            while(i < BUCKETS && bucket_upper(i) <= le) cumulative += buckets[h][i++];
+            append(out, "%s_bucket{le=\"%g\"} %llu\n", name, le / 1e9, (unsigned long long)cumulative);
+        }
+        while(i < BUCKETS) cumulative += buckets[h][i++];
+        append(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)cumulative);
+        append(out, "%s_sum %.9f\n", name, sum[h] / 1e9);
+        append(out, "%s_count %llu\n", name, (unsigned long long)cumulative);
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 内置路由与路由查找
+ * @Date: 2026-10-17 23:58:40
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 23:58:40
+ */
+#include "router.h"
+#include "http_conn.h"
+#include "metrics.h"
+
+std::vector<route> router::m_routes;
+
+/**
+ * @brief METRICS_URL: Prometheus 文本格式的服务器指标
+ */
+static void metrics_handler(const http_conn& conn, route_reply& reply){
+    (void)conn;
+    reply.content_type = "text/plain; version=0.0.4";
+    metrics::render(reply.body);
+}
+
+/**
+ * @brief UPLOAD_URL: 接收 POST/PUT 请求体(较大的已写入临时文件), 返回收到的字节数
+ */
+static void upload_handler(const http_conn& conn, route_reply& reply){
+    char text[64];
+    int len = snprintf(text, sizeof(text), "received %ld bytes\n", conn.body_length());
+    reply.body.append(text, len);
+}
+
+/**
+ * @brief HEALTH_URL: 存活检查, 返回 JSON
+ */
+static void health_handler(const http_conn& conn, route_reply& reply){
+    (void)conn;
+    char text[64];
+    int len = snprintf(text, sizeof(text), "{\"status\":\"ok\",\"connections\":%d}\n", http_conn::m_usercount.load());
+    reply.content_type = "application/json";
+    reply.body.append(text, len);
+}
+
+// 编译期路由, 新增的固定接口加在这里
+static constexpr route ROUTES[] = {
+    {METRICS_URL, ROUTE_GET, metrics_handler, nullptr},
+    {UPLOAD_URL, ROUTE_POST | ROUTE_PUT, upload_handler, nullptr},
+    {HEALTH_URL, ROUTE_GET, health_handler, nullptr},
+};
+static constexpr route_table<sizeof(ROUTES) / sizeof(ROUTES[0])> TABLE(ROUTES);
+
+const route* router::find(const char* path, size_t len){
+    const route* r = TABLE.find(path, len);
+    if(r || m_routes.empty()) return r;
+    for(const route& e : m_routes){
+        if(strncmp(e.path, path, len) == 0 && e.path[len] == '\0') return &e;
+    }
+    return nullptr;
+}
+
+bool router::add(const char* path, unsigned methods, route_handler handler, route_body_handler body){
+    if(path[0] != '/' || find(path, strlen(path))) return false;
+    // 路径与路由一样在整个进程生命周期内有效
+    m_routes.push_back({strdup(path), methods, handler, body});
+    return true;
+}
+
+char* router::format_allow(char* out, unsigned methods){
+    static const char* const NAMES[] = {"GET", "POST", nullptr, "PUT"};
+    char* p = out;
+    memcpy(p, "Allow: ", 7);
+    p += 7;
+    bool first = true;
+    for(unsigned i = 0; i < sizeof(NAMES) / sizeof(NAMES[0]); i++){
+        if(!NAMES[i] || !(methods & (1u << i))) continue;
+        if(!first){
+            *p++ = ',';
+            *p++ = ' ';
+        }
+        size_t len = strlen(NAMES[i]);
+        memcpy(p, NAMES[i], len);
+        p += len;
+        first = false;
+    }
+    *p++ = '\r';
+    *p++ = '\n';
+    return p;
+}
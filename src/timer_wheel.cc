@@ -0,0 +1,147 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 分层时间轮实现
+ * @Date: 2026-10-17 14:10:37
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 14:10:37
+ */
+#include "timer_wheel.h"
+
+timer_wheel::timer_wheel(int tick_ms, uint64_t now_ms)
+        : m_tick_ms(tick_ms > 0 ? tick_ms : 1), m_current(0), m_size(0){
+    m_current = now_ms / m_tick_ms;
+    for(int i = 0; i < ROOT_SIZE; i++){
+        list_init(&m_root[i]);
+    }
+    for(int l = 0; l < LEVELS - 1; l++){
+        for(int i = 0; i < LEVEL_SIZE; i++){
+            list_init(&m_levels[l][i]);
+        }
+    }
+}
+
+void timer_wheel::list_init(timer_node* head){
+    head->prev = head;
+    head->next = head;
+}
+
+void timer_wheel::list_append(timer_node* head, timer_node* node){
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+/**
+ * @brief 按到期 tick 与当前 tick 的距离放入对应层的槽位
+ * @param {timer_node*} node
+ */
+void timer_wheel::insert(timer_node* node){
+    uint64_t delta = node->expire - m_current;
+    if(delta < (uint64_t)ROOT_SIZE){
+        list_append(&m_root[node->expire & (ROOT_SIZE - 1)], node);
+        return;
+    }
+    for(int l = 0; l < LEVELS - 1; l++){
+        int shift = ROOT_BITS + l * LEVEL_BITS;
+        if(delta < ((uint64_t)1 << (shift + LEVEL_BITS)) || l == LEVELS - 2){
+            list_append(&m_levels[l][(node->expire >> shift) & (LEVEL_SIZE - 1)], node);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief 添加定时器, 已存在时重置
+ * @param {timer_node*} node
+ * @param {uint64_t} timeout_ms 多少毫秒后到期, 至少一个 tick
+ */
+void timer_wheel::add(timer_node* node, uint64_t timeout_ms){
+    del(node);
+    uint64_t ticks = (timeout_ms + m_tick_ms - 1) / m_tick_ms;
+    if(ticks == 0) ticks = 1;
+    if(ticks >= MAX_TICKS) ticks = MAX_TICKS - 1;
+    node->expire = m_current + ticks;
+    insert(node);
+    m_size++;
+}
+
+void timer_wheel::del(timer_node* node){
+    if(!node->linked()) return;
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = nullptr;
+    node->next = nullptr;
+    m_size--;
+}
+
+/**
+ * @brief 把上层一个槽位的节点重新分配到下层
+ * @param {int} level 层号(1 ~ 3)
+ * @param {int} index 槽位
+ */
+void timer_wheel::cascade(int level, int index){
+    timer_node* head = &m_levels[level - 1][index];
+    timer_node* node = head->next;
+    list_init(head);
+    while(node != head){
+        timer_node* next = node->next;
+        insert(node);
+        node = next;
+    }
+}
+
+/**
+ * @brief 推进时间轮
+ * @param {uint64_t} now_ms 当前时间
+ * @return {timer_node*} 到期节点单链表, 节点均已从时间轮中移除
+ */
+timer_node* timer_wheel::expire(uint64_t now_ms){
+    uint64_t target = now_ms / m_tick_ms;
+    timer_node* expired = nullptr;
+    timer_node** tail = &expired;
+    while(m_current < target && m_size > 0){
+        m_current++;
+        int index = m_current & (ROOT_SIZE - 1);
+        // 第 0 层转完一圈, 依次从上层取下一个槽位
+        for(int l = 1; l < LEVELS && index == 0; l++){
+            int shift = ROOT_BITS + (l - 1) * LEVEL_BITS;
+            index = (m_current >> shift) & (LEVEL_SIZE - 1);
+            cascade(l, index);
+        }
+
+        timer_node* head = &m_root[m_current & (ROOT_SIZE - 1)];
+        timer_node* node = head->next;
+        while(node != head){
+            timer_node* next = node->next;
+            node->prev = nullptr;
+            node->next = nullptr;
+            m_size--;
+            *tail = node;
+            tail = &node->next;
+            node = next;
+        }
+        list_init(head);
+    }
+    // 没有定时器时直接追上当前时间
+    if(m_current < target) m_current = target;
+    return expired;
+}
+
+/**
+ * @brief 到下一个需要处理的 tick 的毫秒数: 第 0 层中下一个非空槽位, 最远到第 0 层转完一圈(上层下沉)的 tick;
+ *        上层的定时器都在下沉之后才会到期, 因此不会错过, 只有连接很少时每圈多唤醒一次
+ * @param {uint64_t} now_ms 当前时间
+ * @return {int} 无定时器时返回 -1
+ */
+int timer_wheel::next_timeout(uint64_t now_ms) const{
+    if(m_size == 0) return -1;
+    uint64_t boundary = (m_current | (ROOT_SIZE - 1)) + 1;
+    uint64_t next = m_current + 1;
+    while(next < boundary && m_root[next & (ROOT_SIZE - 1)].next == &m_root[next & (ROOT_SIZE - 1)]){
+        next++;
+    }
+    next *= m_tick_ms;
+    return next > now_ms ? (int)(next - now_ms) : 0;
+}
@@ -0,0 +1,557 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: io_uring 事件引擎实现
+ * @Date: 2026-10-17 22:31:05
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 22:31:05
+ */
+#include "uring_engine.h"
+#include "eventloop.h"
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <csignal>
+
+#define URING_MIN_MAJOR 6           // multishot recv 需要 6.0 及以上的内核
+
+static int uring_setup(unsigned entries, io_uring_params* p){
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t size){
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, size);
+}
+
+static int uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args){
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static uint64_t make_data(int fd, int op){
+    return ((uint64_t)(unsigned)fd << 8) | (unsigned)op;
+}
+
+uring_engine::uring_engine(eventloop* loop)
+        : event_engine(loop), m_listenfd(-1), m_ringfd(-1),
+          m_sq_head(nullptr), m_sq_tail(nullptr), m_sq_mask(0), m_sq_entries(0), m_sq_local_tail(0), m_sqes(nullptr),
+          m_cq_head(nullptr), m_cq_tail(nullptr), m_cq_mask(0), m_cqes(nullptr),
+          m_ring_mem(MAP_FAILED), m_ring_size(0), m_sqes_size(0),
+          m_buf_ring((io_uring_buf_ring*)MAP_FAILED), m_buffers(nullptr), m_buf_tail(0), m_buf_free(0),
+          m_states(nullptr), m_free_sends(nullptr), m_wakefd(-1), m_wake_value(0),
+          m_resumed(MAX_FD), m_sleeping(false){
+}
+
+uring_engine::~uring_engine(){
+    if(m_ringfd != -1) ::close(m_ringfd);
+    if(m_ring_mem != MAP_FAILED) munmap(m_ring_mem, m_ring_size);
+    if(m_sqes) munmap(m_sqes, m_sqes_size);
+    if(m_buf_ring != MAP_FAILED) munmap(m_buf_ring, BUFFER_NUMBER * sizeof(io_uring_buf));
+    if(m_wakefd != -1) ::close(m_wakefd);
+    free(m_buffers);
+    free(m_states);
+    while(m_free_sends){
+        send_state* next = m_free_sends->next;
+        delete m_free_sends;
+        m_free_sends = next;
+    }
+}
+
+/**
+ * @brief 创建 io_uring、映射提交/完成队列, 注册提供缓冲区环, 提交 multishot accept;
+ *        内核中 accept 以独占方式等待监听 socket, 共享监听 socket 时每个新连接同样只唤醒一个 ring
+ * @return {bool} 内核不支持所需特性时返回 false
+ */
+bool uring_engine::init(int listenfd, bool /* shared */){
+    struct utsname uts;
+    if(uname(&uts) != 0 || atoi(uts.release) < URING_MIN_MAJOR){
+        errno = ENOSYS;
+        return false;
+    }
+
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+    p.cq_entries = CQ_ENTRIES;
+    m_ringfd = uring_setup(SQ_ENTRIES, &p);
+    if(m_ringfd < 0 && errno == EINVAL){
+        p.flags = IORING_SETUP_CQSIZE;
+        m_ringfd = uring_setup(SQ_ENTRIES, &p);
+    }
+    if(m_ringfd < 0) return false;
+    if(!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)){
+        errno = ENOSYS;
+        return false;
+    }
+
+    // 提交队列与完成队列共用一次映射
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    m_ring_size = sq_size > cq_size ? sq_size : cq_size;
+    m_ring_mem = mmap(nullptr, m_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringfd, IORING_OFF_SQ_RING);
+    if(m_ring_mem == MAP_FAILED) return false;
+    m_sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringfd, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) return false;
+    m_sqes = (io_uring_sqe*)sqes;
+
+    char* ring = (char*)m_ring_mem;
+    m_sq_head = (unsigned*)(ring + p.sq_off.head);
+    m_sq_tail = (unsigned*)(ring + p.sq_off.tail);
+    m_sq_mask = *(unsigned*)(ring + p.sq_off.ring_mask);
+    m_sq_entries = p.sq_entries;
+    m_sq_local_tail = *m_sq_tail;
+    // SQE 按顺序使用, 索引数组固定为恒等映射
+    unsigned* array = (unsigned*)(ring + p.sq_off.array);
+    for(unsigned i = 0; i < m_sq_entries; i++) array[i] = i;
+    m_cq_head = (unsigned*)(ring + p.cq_off.head);
+    m_cq_tail = (unsigned*)(ring + p.cq_off.tail);
+    m_cq_mask = *(unsigned*)(ring + p.cq_off.ring_mask);
+    m_cqes = (io_uring_cqe*)(ring + p.cq_off.cqes);
+
+    // 提供缓冲区环: 内核接收数据时从中取一个缓冲区, 完成事件带回缓冲区编号
+    m_buf_ring = (io_uring_buf_ring*)mmap(nullptr, BUFFER_NUMBER * sizeof(io_uring_buf), PROT_READ | PROT_WRITE,
+                                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(m_buf_ring == MAP_FAILED) return false;
+    m_buffers = (char*)aligned_alloc(4096, (size_t)BUFFER_NUMBER * BUFFER_SIZE);
+    if(!m_buffers) return false;
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)m_buf_ring;
+    reg.ring_entries = BUFFER_NUMBER;
+    reg.bgid = BUFFER_GROUP;
+    if(uring_register(m_ringfd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) return false;
+    for(unsigned i = 0; i < BUFFER_NUMBER; i++) recycle(i);
+    __atomic_store_n(&m_buf_ring->tail, m_buf_tail, __ATOMIC_RELEASE);
+
+    m_states = (conn_state*)calloc(MAX_FD, sizeof(conn_state));
+    if(!m_states) return false;
+    m_wakefd = eventfd(0, EFD_CLOEXEC);
+    if(m_wakefd < 0) return false;
+
+    m_listenfd = listenfd;
+    arm_accept();
+    arm_wake();
+    return true;
+}
+
+/**
+ * @brief 取一个空闲的 SQE, 提交队列满时先提交已有的
+ */
+io_uring_sqe* uring_engine::get_sqe(uint64_t user_data){
+    if(m_sq_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >= m_sq_entries){
+        enter(0, 0);
+    }
+    io_uring_sqe* sqe = m_sqes + (m_sq_local_tail & m_sq_mask);
+    m_sq_local_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = user_data;
+    return sqe;
+}
+
+/**
+ * @brief 提交所有已填写的 SQE, wait_nr 不为 0 时等待完成事件
+ * @param {int} timeout_ms 等待的超时, -1 表示一直等待
+ * @return {int} io_uring_enter 的返回值
+ */
+int uring_engine::enter(unsigned wait_nr, int timeout_ms){
+    __atomic_store_n(m_sq_tail, m_sq_local_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = m_sq_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+    if(to_submit == 0 && wait_nr == 0) return 0;
+
+    unsigned flags = 0;
+    io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    void* argp = nullptr;
+    size_t size = 0;
+    if(wait_nr){
+        flags |= IORING_ENTER_GETEVENTS;
+        if(timeout_ms >= 0){
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+            memset(&arg, 0, sizeof(arg));
+            arg.sigmask_sz = _NSIG / 8;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            size = sizeof(arg);
+        }
+    }
+    metrics::add(METRIC_SYSCALLS);
+    return uring_enter(m_ringfd, to_submit, wait_nr, flags, argp, size);
+}
+
+unsigned uring_engine::cq_ready() const{
+    return __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE) - *m_cq_head;
+}
+
+/**
+ * @brief 归还一个提供缓冲区, 在下一次发布环尾时对内核可见
+ */
+void uring_engine::recycle(int bid){
+    // C++ 中 __DECLARE_FLEX_ARRAY 展开出的空结构体占 1 字节, bufs 的偏移不是 0, 按数组直接访问环
+    io_uring_buf* buf = (io_uring_buf*)m_buf_ring + (m_buf_tail & (BUFFER_NUMBER - 1));
+    buf->addr = (uint64_t)(uintptr_t)(m_buffers + (size_t)bid * BUFFER_SIZE);
+    buf->len = BUFFER_SIZE;
+    buf->bid = (unsigned short)bid;
+    m_buf_tail++;
+    m_buf_free++;
+}
+
+void uring_engine::arm_accept(){
+    io_uring_sqe* sqe = get_sqe(make_data(m_listenfd, OP_ACCEPT));
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = m_listenfd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+}
+
+void uring_engine::arm_wake(){
+    io_uring_sqe* sqe = get_sqe(make_data(m_wakefd, OP_WAKE));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = m_wakefd;
+    sqe->addr = (uint64_t)(uintptr_t)&m_wake_value;
+    sqe->len = sizeof(m_wake_value);
+}
+
+void uring_engine::arm_recv(int fd){
+    conn_state& st = m_states[fd];
+    io_uring_sqe* sqe = get_sqe(make_data(fd, OP_RECV));
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    st.recv_armed = true;
+    st.inflight++;
+}
+
+/**
+ * @brief recv 已结束时重新开始; 暂存的数据拷贝完之后才开始, 没有空闲缓冲区时等待归还
+ */
+void uring_engine::rearm(int fd){
+    conn_state& st = m_states[fd];
+    if(st.recv_armed || st.eof || st.closing || st.stash_head != -1) return;
+    if(m_buf_free > 0) arm_recv(fd);
+    else m_starved.push_back(fd);
+}
+
+void uring_engine::add(http_conn* conn){
+    int fd = conn->m_sockfd;
+    conn_state& st = m_states[fd];
+    st.inflight = 0;
+    st.recv_armed = false;
+    st.eof = false;
+    st.closing = false;
+    st.stash_head = -1;
+    st.stash_tail = -1;
+    st.stash_off = 0;
+    st.send = nullptr;
+    arm_recv(fd);
+}
+
+/**
+ * @brief 没有未完成的操作时立即关闭, 否则 shutdown 让它们尽快结束
+ */
+void uring_engine::close(http_conn* conn){
+    int fd = conn->m_sockfd;
+    conn_state& st = m_states[fd];
+    if(st.closing) return;
+    st.closing = true;
+    if(st.inflight == 0){
+        finish_close(fd);
+        return;
+    }
+    // 不使用 IORING_OP_SHUTDOWN: 它总在 io-wq 中异步执行, 执行时才按 fd 查找文件,
+    // 若此前操作已结束、连接已关闭且 fd 被新连接复用, 会关掉新连接
+    ::shutdown(fd, SHUT_RDWR);
+    metrics::add(METRIC_SYSCALLS);
+}
+
+/**
+ * @brief 归还暂存的缓冲区, 释放连接, 描述符随下一次提交关闭
+ */
+void uring_engine::finish_close(int fd){
+    conn_state& st = m_states[fd];
+    while(st.stash_head != -1){
+        int bid = st.stash_head;
+        st.stash_head = m_buf_next[bid];
+        recycle(bid);
+    }
+    st.stash_tail = -1;
+    st.closing = false;
+    m_loop->free_conn(m_loop->find_conn(fd));
+    io_uring_sqe* sqe = get_sqe(make_data(fd, OP_CLOSE));
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+}
+
+/**
+ * @brief 工作线程交还连接: 放入队列, reactor 睡眠时才唤醒;
+ *        与 wait() 中的屏障配对: 要么这里看到 m_sleeping, 要么 reactor 睡眠前能看到队列中的连接
+ */
+void uring_engine::resume(http_conn* conn){
+    while(!m_resumed.push(conn)) sched_yield();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false)){
+        uint64_t one = 1;
+        ssize_t n = ::write(m_wakefd, &one, sizeof(one));
+        (void)n;
+        metrics::add(METRIC_SYSCALLS);
+    }
+}
+
+int uring_engine::wait(int timeout_ms){
+    int ret;
+    if(cq_ready() > 0 || m_resumed.size() > 0){
+        ret = enter(0, 0);
+    }else{
+        m_sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        ret = m_resumed.size() > 0 ? enter(0, 0) : enter(1, timeout_ms);
+        m_sleeping.store(false, std::memory_order_relaxed);
+    }
+    if(ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN){
+        return -1;
+    }
+    return (int)cq_ready();
+}
+
+void uring_engine::handle_events(){
+    // 处理完成事件, 处理过程中产生的操作在下一次 wait() 时一起提交
+    unsigned head = *m_cq_head;
+    unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+    while(head != tail){
+        for(; head != tail; head++){
+            io_uring_cqe* cqe = m_cqes + (head & m_cq_mask);
+            handle_cqe(cqe->user_data, cqe->res, cqe->flags);
+        }
+        __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+        tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+    }
+
+    // 工作线程处理完的连接
+    http_conn* conn;
+    while(m_resumed.pop(conn)){
+        on_resume(conn);
+    }
+
+    // 归还的缓冲区对内核可见后, 重新开始因缓冲区耗尽而结束的 recv
+    __atomic_store_n(&m_buf_ring->tail, m_buf_tail, __ATOMIC_RELEASE);
+    if(!m_starved.empty() && m_buf_free > 0){
+        std::vector<int> starved;
+        starved.swap(m_starved);
+        for(int fd : starved){
+            // 线程池中的连接回到 reactor 时(on_resume)再重新开始
+            http_conn* conn = m_loop->find_conn(fd);
+            if(conn && !conn->m_in_pool.load(std::memory_order_relaxed)) rearm(fd);
+        }
+    }
+}
+
+void uring_engine::handle_cqe(uint64_t user_data, int res, unsigned flags){
+    int fd = (int)(user_data >> 8);
+    switch((int)(user_data & 0xff)){
+        case OP_ACCEPT:{
+            if(res >= 0){
+                // multishot accept 不返回对端地址, 连接中只用于记录
+                struct sockaddr_in addr;
+                memset(&addr, 0, sizeof(addr));
+                m_loop->add_conn(res, addr);
+            }else{
+                LOG_WARN("accept failed, errno: %d", -res);
+            }
+            if(!(flags & IORING_CQE_F_MORE)) arm_accept();
+            break;
+        }
+        case OP_WAKE:
+            arm_wake();
+            break;
+        case OP_RECV:
+            on_recv(fd, res, flags);
+            break;
+        case OP_SEND:
+            on_send(fd, res);
+            break;
+        default:
+            // close 的结果不需要处理
+            break;
+    }
+}
+
+void uring_engine::on_recv(int fd, int res, unsigned flags){
+    conn_state& st = m_states[fd];
+    http_conn* conn = m_loop->find_conn(fd);
+    if(!(flags & IORING_CQE_F_MORE)){
+        st.recv_armed = false;
+        st.inflight--;
+    }
+    if(flags & IORING_CQE_F_BUFFER){
+        int bid = (int)(flags >> IORING_CQE_BUFFER_SHIFT);
+        m_buf_free--;
+        if(res <= 0 || st.closing){
+            recycle(bid);
+        }else{
+            // 先放入暂存链表, 连接在线程池中时不能修改它的读缓冲区
+            m_buf_len[bid] = (unsigned)res;
+            m_buf_next[bid] = -1;
+            if(st.stash_head == -1) st.stash_head = bid;
+            else m_buf_next[st.stash_tail] = bid;
+            st.stash_tail = bid;
+        }
+    }
+    if(st.closing){
+        if(st.inflight == 0) finish_close(fd);
+        return;
+    }
+    if(res == -ENOBUFS || (res > 0 && !st.recv_armed)){
+        // 缓冲区耗尽(或内核因其他原因结束了 multishot), 有空闲缓冲区后重新开始
+        m_starved.push_back(fd);
+    }else if(res <= 0){
+        st.eof = true;
+    }
+    if(!conn->m_in_pool.load(std::memory_order_acquire)){
+        proceed(fd);
+    }
+}
+
+/**
+ * @brief 把暂存的数据拷贝到读缓冲区, 读缓冲区已满且无法扩大时停止
+ * @return {int} 拷贝的字节数
+ */
+int uring_engine::absorb(int fd){
+    conn_state& st = m_states[fd];
+    http_conn* conn = m_loop->find_conn(fd);
+    int total = 0;
+    while(st.stash_head != -1){
+        if(conn->m_read_idx >= (int)conn->m_read_buf.capacity()){
+            // 先丢弃已处理完的流水线请求, 仍然没有空间再扩大缓冲区
+            conn->compact_read_buf();
+            if(conn->m_read_idx >= (int)conn->m_read_buf.capacity() && !conn->grow_read_buf()){
+                break;
+            }
+        }
+        int bid = st.stash_head;
+        unsigned len = m_buf_len[bid] - st.stash_off;
+        unsigned room = (unsigned)(conn->m_read_buf.capacity() - conn->m_read_idx);
+        unsigned n = len < room ? len : room;
+        memcpy(conn->m_read_buf.data() + conn->m_read_idx, m_buffers + (size_t)bid * BUFFER_SIZE + st.stash_off, n);
+        conn->m_read_idx += n;
+        total += n;
+        if(n == len){
+            st.stash_head = m_buf_next[bid];
+            if(st.stash_head == -1) st.stash_tail = -1;
+            st.stash_off = 0;
+            recycle(bid);
+        }else{
+            st.stash_off += n;
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief 连接由 reactor 持有时处理收到的数据: 正在发送时只拷贝, 发完后再交给线程池
+ */
+void uring_engine::proceed(int fd){
+    conn_state& st = m_states[fd];
+    http_conn* conn = m_loop->find_conn(fd);
+    if(st.eof){
+        m_loop->close_conn(conn);
+        return;
+    }
+    int n = absorb(fd);
+    rearm(fd);
+    if(conn->m_response_count > 0) return;
+    if(n > 0){
+        LOG_DEBUG("fd %d read %d bytes, %d buffered", fd, n, conn->m_read_idx);
+        m_loop->dispatch(conn);
+    }else if(st.stash_head != -1){
+        // 读缓冲区已达上限, 单个请求超过上限
+        m_loop->close_conn(conn);
+    }
+}
+
+void uring_engine::on_resume(http_conn* conn){
+    int fd = conn->m_sockfd;
+    conn->m_in_pool.store(false, std::memory_order_relaxed);
+    if(m_states[fd].eof){
+        m_loop->close_conn(conn);
+    }else if(conn->m_response_count > 0){
+        // 与 epoll 引擎一致, 进入发送阶段后按发送超时计时; start_send() 出错时会释放连接, 先重置定时器
+        m_loop->refresh_timer(conn);
+        start_send(fd);
+    }else{
+        proceed(fd);
+    }
+}
+
+/**
+ * @brief 把响应队列中的下一段数据作为一个 sendmsg 提交
+ */
+void uring_engine::start_send(int fd){
+    conn_state& st = m_states[fd];
+    http_conn* conn = m_loop->find_conn(fd);
+    send_state* s = m_free_sends;
+    if(s) m_free_sends = s->next;
+    else s = new send_state();
+    if(!conn->prepare_send(s->op) || s->op.file_fd != -1){
+        // io_uring 引擎下文件实体都已映射, 不会出现需要 sendfile 的数据
+        s->next = m_free_sends;
+        m_free_sends = s;
+        if(s->op.file_fd != -1) LOG_ERROR("fd %d: sendfile body is not supported by io_uring engine", fd);
+        m_loop->close_conn(conn);
+        return;
+    }
+    memset(&s->msg, 0, sizeof(s->msg));
+    s->msg.msg_iov = s->op.iov;
+    s->msg.msg_iovlen = s->op.iov_count;
+    io_uring_sqe* sqe = get_sqe(make_data(fd, OP_SEND));
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)&s->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    st.send = s;
+    st.inflight++;
+}
+
+void uring_engine::on_send(int fd, int res){
+    conn_state& st = m_states[fd];
+    http_conn* conn = m_loop->find_conn(fd);
+    st.inflight--;
+    st.send->next = m_free_sends;
+    m_free_sends = st.send;
+    st.send = nullptr;
+    if(st.closing){
+        if(st.inflight == 0) finish_close(fd);
+        return;
+    }
+    if(res <= 0){
+        m_loop->close_conn(conn);
+        return;
+    }
+    metrics::add(METRIC_BYTES_SENT, res);
+    if(!conn->advance(res)){
+        m_loop->close_conn(conn);
+        return;
+    }
+    if(conn->m_send_idx < conn->m_response_count){
+        m_loop->refresh_timer(conn);
+        start_send(fd);
+        return;
+    }
+    conn->finish_write();
+    if(st.eof){
+        m_loop->close_conn(conn);
+        return;
+    }
+    absorb(fd);
+    rearm(fd);
+    if(conn->has_pending_request()){
+        // 响应发完, 读缓冲区中还有流水线请求(或发送期间收到的数据), 直接处理
+        m_loop->dispatch(conn);
+    }else{
+        m_loop->refresh_timer(conn);
+    }
+}
@@ -0,0 +1,228 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 请求体接收的测试: 留在读缓冲区、超过阈值写入临时文件、splice 接收、按块交给路由的处理函数与长度校验
+ * @Date: 2026-10-17 19:35:20
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 19:35:20
+ */
+#include "test.h"
+
+static std::string digest(const char* data, size_t len){
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < len; i++) h = (h ^ (unsigned char)data[i]) * 16777619u;
+    return std::to_string(len) + "/" + std::to_string(h);
+}
+
+/**
+ * @brief 读缓冲区中的请求体原样返回("buffer:" 开头); 临时文件中的返回长度与哈希("file:" 开头),
+ *        处理函数的应答放在写缓冲区中, 不能超过其上限
+ */
+static void body_echo_handler(const http_conn& conn, route_reply& reply){
+    if(conn.body_fd() != -1){
+        std::string data(conn.body_length(), '\0');
+        ssize_t n = pread(conn.body_fd(), &data[0], data.size(), 0);
+        reply.body.append("file:");
+        reply.body.append(digest(data.data(), n > 0 ? n : 0));
+    }else{
+        reply.body.append("buffer:");
+        if(conn.body()) reply.body.append(conn.body(), conn.body_length());
+    }
+}
+
+static std::string post(size_t len, const std::string& body, const char* path = "/echo-body"){
+    return std::string("POST ") + path + " HTTP/1.1\r\nHost: x\r\nContent-Length: " + std::to_string(len) + "\r\n\r\n" + body;
+}
+
+static std::string g_chunks;            // 请求体处理函数收到的各块长度, 以 ',' 分隔
+static std::string g_streamed;          // 请求体处理函数收到的内容
+static long g_fail_at = -1;             // 收到的内容达到该长度时返回 false
+
+static bool stream_body_handler(http_conn* conn, const char* data, size_t len){
+    (void)conn;
+    g_chunks += std::to_string(len) + ",";
+    g_streamed.append(data ? data : "", len);
+    return g_fail_at < 0 || (long)g_streamed.size() < g_fail_at;
+}
+
+/**
+ * @brief 请求体已交给 stream_body_handler, 不在读缓冲区也不在临时文件中
+ */
+static void stream_handler(const http_conn& conn, route_reply& reply){
+    reply.body.append(conn.body() == nullptr && conn.body_fd() == -1 ? "stream:" : "leaked:");
+    reply.body.append(g_chunks);
+    reply.body.append(digest(g_streamed.data(), g_streamed.size()));
+    g_chunks.clear();
+    g_streamed.clear();
+}
+
+static void test_body_in_buffer(){
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+
+    std::string resp = http_conn_probe::serve(hc, post(5, "hello"));
+    CHECK_HAS(resp, "HTTP/1.1 200");
+    CHECK_HAS(resp, "\r\n\r\nbuffer:hello");
+    http_conn_probe::reset(hc);
+
+    // 请求体分两次到达, 之后紧跟下一个流水线请求
+    resp = http_conn_probe::serve(hc, post(6, "abc"));
+    CHECK_EQ(http_conn_probe::response_count(hc), 0);
+    resp = http_conn_probe::serve(hc, "defGET /missing.html HTTP/1.1\r\nHost: x\r\n\r\n");
+    CHECK_HAS(resp, "\r\n\r\nbuffer:abcdef");
+    CHECK_HAS(resp, "HTTP/1.1 404");
+    CHECK_EQ(http_conn_probe::response_count(hc), 2);
+    http_conn_probe::reset(hc);
+
+    http_conn_probe::close(hc, peer);
+    delete hc;
+}
+
+static void test_body_spill(){
+    long threshold = http_conn::m_spill_threshold;
+    http_conn::m_spill_threshold = 64;
+
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+
+    // 刚好等于阈值时留在读缓冲区
+    std::string body(64, 'a');
+    std::string resp = http_conn_probe::serve(hc, post(body.size(), body));
+    CHECK_HAS(resp, "\r\n\r\nbuffer:" + body);
+    http_conn_probe::reset(hc);
+
+    // 超过阈值, 已在读缓冲区中的部分写入临时文件, 下一个请求随后处理
+    body.assign(200, 'b');
+    resp = http_conn_probe::serve(hc, post(body.size(), body) + "GET " HEALTH_URL " HTTP/1.1\r\nHost: x\r\n\r\n");
+    CHECK_HAS(resp, "\r\n\r\nfile:" + digest(body.data(), body.size()));
+    CHECK_HAS(resp, "application/json");
+    CHECK_EQ(http_conn_probe::response_count(hc), 2);
+    http_conn_probe::reset(hc);
+
+    // 读缓冲区中的部分写入后, 剩余部分由 splice 从 socket 直接写入临时文件
+    body.clear();
+    for(int i = 0; i < 100000; i++) body.push_back('0' + i % 10);
+    resp = http_conn_probe::serve(hc, post(body.size(), body.substr(0, 1000)));
+    CHECK_EQ(http_conn_probe::response_count(hc), 0);
+    CHECK(hc->body_streaming());
+    size_t sent = 1000;
+    long received = 0;
+    while(sent < body.size() || received < (long)body.size() - 1000){
+        if(sent < body.size()){
+            ssize_t n = ::write(peer, body.data() + sent, body.size() - sent);
+            if(n > 0) sent += n;
+        }
+        ssize_t n = hc->splice_body();
+        if(n > 0) received += n;
+        else if(n == 0 || errno != EAGAIN) break;
+    }
+    CHECK_EQ(received, body.size() - 1000);
+    CHECK(!hc->body_streaming());
+    resp = http_conn_probe::serve(hc, "");
+    CHECK_EQ(http_conn_probe::response_count(hc), 1);
+    CHECK_HAS(resp, "\r\n\r\nfile:" + digest(body.data(), body.size()));
+    http_conn_probe::reset(hc);
+
+    http_conn_probe::close(hc, peer);
+    delete hc;
+    http_conn::m_spill_threshold = threshold;
+}
+
+static void test_body_rejected(){
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+
+    long max_body = http_conn::m_max_body;
+    http_conn::m_max_body = 100;
+    std::string resp = http_conn_probe::serve(hc, post(101, ""));
+    CHECK_HAS(resp, "HTTP/1.1 413");
+    CHECK(http_conn_probe::closes(hc, 0));
+    http_conn_probe::reset(hc);
+    http_conn::m_max_body = max_body;
+    http_conn_probe::close(hc, peer);
+
+    // 每种错误使用新的连接, 400 之后无法确定下一个请求的位置
+    const char* bad[] = {
+        "POST /echo-body HTTP/1.1\r\nHost: x\r\nContent-Length: -3\r\n\r\n",
+        "POST /echo-body HTTP/1.1\r\nHost: x\r\nContent-Length: +3\r\n\r\n",
+        "POST /echo-body HTTP/1.1\r\nHost: x\r\nContent-Length: 3x\r\n\r\n",
+        "POST /echo-body HTTP/1.1\r\nHost: x\r\nContent-Length: 99999999999999999999999\r\n\r\n",
+        "POST /echo-body HTTP/1.1\r\nHost: x\r\nContent-Length: 3\r\nContent-Length: 4\r\n\r\n",
+    };
+    for(const char* request : bad){
+        peer = http_conn_probe::open(hc);
+        CHECK_HAS(http_conn_probe::serve(hc, request), "HTTP/1.1 400");
+        http_conn_probe::close(hc, peer);
+    }
+
+    peer = http_conn_probe::open(hc);
+    resp = http_conn_probe::serve(hc, "POST /echo-body HTTP/1.1\r\nHost: x\r\nContent-Length: 3\r\nContent-Length: 3\r\n\r\nabc");
+    CHECK_HAS(resp, "\r\n\r\nbuffer:abc");
+    http_conn_probe::reset(hc);
+    resp = http_conn_probe::serve(hc, "POST /echo-body HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 411");
+    http_conn_probe::close(hc, peer);
+    delete hc;
+}
+
+/**
+ * @brief 有 route::body 的路由按固定块长收到请求体, 不受写入临时文件的阈值影响; 其他路由照常写入临时文件
+ */
+static void test_body_handler(){
+    long threshold = http_conn::m_spill_threshold;
+    long chunk = http_conn::m_body_chunk;
+    http_conn::m_spill_threshold = 16;
+    http_conn::m_body_chunk = 10;
+
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+
+    // 一次到达: 整块交出, 最后一块为剩余部分, 之后以 len 为 0 结束
+    std::string body;
+    for(int i = 0; i < 35; i++) body.push_back('a' + i % 26);
+    std::string resp = http_conn_probe::serve(hc, post(body.size(), body, "/stream-body"));
+    CHECK_HAS(resp, "\r\n\r\nstream:10,10,10,5,0," + digest(body.data(), body.size()));
+    http_conn_probe::reset(hc);
+
+    // 分多次到达: 不足一块时等待后续数据, 块长不随每次收到的长度变化; 请求体之后的流水线请求照常处理
+    resp = http_conn_probe::serve(hc, post(body.size(), body.substr(0, 3), "/stream-body"));
+    CHECK_EQ(http_conn_probe::response_count(hc), 0);
+    CHECK(g_chunks.empty());
+    resp = http_conn_probe::serve(hc, body.substr(3, 12));
+    CHECK_EQ(http_conn_probe::response_count(hc), 0);
+    CHECK(g_chunks == "10,");
+    CHECK(!hc->body_streaming());
+    resp = http_conn_probe::serve(hc, body.substr(15) + "GET " HEALTH_URL " HTTP/1.1\r\nHost: x\r\n\r\n");
+    CHECK_HAS(resp, "\r\n\r\nstream:10,10,10,5,0," + digest(body.data(), body.size()));
+    CHECK_HAS(resp, "application/json");
+    CHECK_EQ(http_conn_probe::response_count(hc), 2);
+    http_conn_probe::reset(hc);
+
+    // 同一连接上没有 route::body 的路由仍写入临时文件
+    resp = http_conn_probe::serve(hc, post(body.size(), body));
+    CHECK_HAS(resp, "\r\n\r\nfile:" + digest(body.data(), body.size()));
+    http_conn_probe::reset(hc);
+
+    // 处理函数返回 false 时以 500 结束并关闭连接
+    g_fail_at = 20;
+    resp = http_conn_probe::serve(hc, post(body.size(), body, "/stream-body"));
+    CHECK_HAS(resp, "HTTP/1.1 500");
+    CHECK(http_conn_probe::closes(hc, 0));
+    g_fail_at = -1;
+    g_chunks.clear();
+    g_streamed.clear();
+
+    http_conn_probe::close(hc, peer);
+    delete hc;
+    http_conn::m_spill_threshold = threshold;
+    http_conn::m_body_chunk = chunk;
+}
+
+void test_body(){
+    CHECK(router::add("/echo-body", ROUTE_POST | ROUTE_PUT, body_echo_handler));
+    CHECK(router::add("/stream-body", ROUTE_POST, stream_handler, stream_body_handler));
+    test_body_in_buffer();
+    test_body_spill();
+    test_body_rejected();
+    test_body_handler();
+}
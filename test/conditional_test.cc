@@ -0,0 +1,108 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 条件请求(If-None-Match、If-Modified-Since、If-Range)的测试, 分别经过与不经过文件缓存
+ * @Date: 2026-10-17 19:31:48
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 19:31:48
+ */
+#include "test.h"
+
+/**
+ * @brief 取响应头中某个字段的值
+ */
+static std::string header_value(const std::string& resp, const char* name){
+    size_t pos = resp.find(std::string("\r\n") + name + ": ");
+    if(pos == std::string::npos) return std::string();
+    pos += strlen(name) + 4;
+    return resp.substr(pos, resp.find("\r\n", pos) - pos);
+}
+
+static std::string get(http_conn* hc, const std::string& headers){
+    std::string resp = http_conn_probe::serve(hc, "GET /page.html HTTP/1.1\r\nHost: x\r\n" + headers + "\r\n");
+    http_conn_probe::reset(hc);
+    return resp;
+}
+
+static void test_validators(){
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+
+    std::string resp = get(hc, "");
+    CHECK_HAS(resp, "HTTP/1.1 200");
+    std::string etag = header_value(resp, "ETag");
+    std::string modified = header_value(resp, "Last-Modified");
+    CHECK(etag.size() > 2 && etag.front() == '"' && etag.back() == '"');
+    CHECK(!modified.empty());
+    std::string gz_etag = etag.substr(0, etag.size() - 1) + "-gz\"";
+
+    resp = get(hc, "If-None-Match: " + etag + "\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 304");
+    CHECK_HAS(resp, "ETag: " + etag + "\r\n");
+    CHECK(resp.find("Content-Length") == std::string::npos);
+
+    // 弱比较, 列表中任意一个一致即可
+    CHECK_HAS(get(hc, "If-None-Match: \"a\", W/" + etag + "\r\n"), "HTTP/1.1 304");
+    CHECK_HAS(get(hc, "If-None-Match: *\r\n"), "HTTP/1.1 304");
+    CHECK_HAS(get(hc, "If-None-Match: \"other\"\r\n"), "HTTP/1.1 200");
+
+    // client 持有 gzip 版本时返回 gzip 版本的验证器
+    resp = get(hc, "Accept-Encoding: gzip\r\nIf-None-Match: " + gz_etag + "\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 304");
+    CHECK_HAS(resp, "ETag: " + gz_etag + "\r\n");
+
+    CHECK_HAS(get(hc, "If-Modified-Since: " + modified + "\r\n"), "HTTP/1.1 304");
+    CHECK_HAS(get(hc, "If-Modified-Since: Thu, 01 Jan 1970 00:00:00 GMT\r\n"), "HTTP/1.1 200");
+    CHECK_HAS(get(hc, "If-Modified-Since: not a date\r\n"), "HTTP/1.1 200");
+    // 有 If-None-Match 时忽略 If-Modified-Since
+    CHECK_HAS(get(hc, "If-None-Match: \"other\"\r\nIf-Modified-Since: " + modified + "\r\n"), "HTTP/1.1 200");
+
+    // If-Range 使用强比较
+    CHECK_HAS(get(hc, "Range: bytes=0-9\r\nIf-Range: " + etag + "\r\n"), "HTTP/1.1 206");
+    CHECK_HAS(get(hc, "Range: bytes=0-9\r\nIf-Range: W/" + etag + "\r\n"), "HTTP/1.1 200");
+    CHECK_HAS(get(hc, "Range: bytes=0-9\r\nIf-Range: " + gz_etag + "\r\n"), "HTTP/1.1 200");
+    CHECK_HAS(get(hc, "Range: bytes=0-9\r\nIf-Range: " + modified + "\r\n"), "HTTP/1.1 206");
+    CHECK_HAS(get(hc, "Range: bytes=0-9\r\nIf-Range: Thu, 01 Jan 1970 00:00:00 GMT\r\n"), "HTTP/1.1 200");
+
+    http_conn_probe::close(hc, peer);
+    delete hc;
+}
+
+/**
+ * @brief 304 不发送实体, 不应为它生成 gzip 版本
+ */
+static void test_not_modified_skips_gzip(){
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+
+    std::string etag = header_value(get(hc, ""), "ETag");
+    std::string gz_etag = etag.substr(0, etag.size() - 1) + "-gz\"";
+    CHECK_HAS(get(hc, "Accept-Encoding: gzip\r\nIf-None-Match: " + gz_etag + "\r\n"), "HTTP/1.1 304");
+
+    int err = 0;
+    std::string path = std::string(test_root()) + "/page.html";
+    file_entry* entry = http_conn::m_file_cache->acquire(path.c_str(), err);
+    CHECK(entry && entry->compressible && entry->gzip == nullptr);
+
+    CHECK_HAS(get(hc, "Accept-Encoding: gzip\r\n"), "Content-Encoding: gzip\r\n");
+    CHECK(entry && entry->gzip != nullptr);
+    if(entry) file_cache::release(entry);
+
+    http_conn_probe::close(hc, peer);
+    delete hc;
+}
+
+void test_conditional(){
+    std::string content;
+    for(int i = 0; i < 200; i++) content += "<p>conditional request</p>\n";
+    write_file("page.html", content);
+
+    // 不经过缓存时先 stat, 未修改的文件不打开
+    test_validators();
+
+    file_cache cache(16, 1 << 20, !http_conn::m_use_sendfile);
+    http_conn::m_file_cache = &cache;
+    test_validators();
+    test_not_modified_skips_gzip();
+    http_conn::m_file_cache = nullptr;
+}
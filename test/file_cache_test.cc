@@ -0,0 +1,361 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 静态文件缓存的测试: 只提供普通文件、命中、LRU 淘汰、generation、inotify 失效与 gzip 版本
+ * @Date: 2026-10-17 19:52:10
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 19:52:10
+ */
+#include "test.h"
+#include <unistd.h>
+#include <zlib.h>
+
+/**
+ * 通过 file_cache 的友元检查分片内容
+ */
+struct file_cache_probe{
+    static const void* shard(file_cache& cache, const std::string& path){ return &cache.shard_of(path); }
+
+    static bool cached(file_cache& cache, const std::string& path){
+        file_cache::shard& s = cache.shard_of(path);
+        s.mutex.lock();
+        bool found = s.index.count(path) != 0;
+        s.mutex.unlock();
+        return found;
+    }
+
+    static unsigned long generation(file_cache& cache, const std::string& path){
+        file_cache::shard& s = cache.shard_of(path);
+        s.mutex.lock();
+        unsigned long generation = s.generation;
+        s.mutex.unlock();
+        return generation;
+    }
+
+    static file_entry* insert(file_cache& cache, const std::string& path, file_entry* entry, unsigned long generation){
+        return cache.insert(path, entry, generation);
+    }
+};
+
+/**
+ * @brief 在 test_root() 下找出 n 个落在同一分片中的文件名并写入文件
+ */
+static std::vector<std::string> same_shard(file_cache& cache, const char* prefix, int n, size_t size){
+    std::vector<std::string> paths;
+    const void* shard = nullptr;
+    for(int i = 0; (int)paths.size() < n; i++){
+        std::string name = prefix + std::to_string(i) + ".txt";
+        std::string path = std::string(test_root()) + "/" + name;
+        if(shard && file_cache_probe::shard(cache, path) != shard) continue;
+        shard = file_cache_probe::shard(cache, path);
+        paths.push_back(write_file(name.c_str(), std::string(size, 'a' + i % 26)));
+    }
+    return paths;
+}
+
+static std::string gunzip(const char* data, size_t len){
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if(inflateInit2(&zs, 15 + 16) != Z_OK) return std::string();
+    std::string out;
+    char buf[4096];
+    zs.next_in = (Bytef*)data;
+    zs.avail_in = len;
+    int ret = Z_OK;
+    while(ret == Z_OK){
+        zs.next_out = (Bytef*)buf;
+        zs.avail_out = sizeof(buf);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    }
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END ? out : std::string();
+}
+
+/**
+ * @brief 只提供普通文件: FIFO 不能阻塞工作线程, 设备与 socket 同样拒绝
+ */
+static void test_special_files(){
+    std::string fifo = std::string(test_root()) + "/pipe.html";
+    std::string device = std::string(test_root()) + "/null.html";
+    CHECK(mkfifo(fifo.c_str(), 0644) == 0);
+    CHECK(symlink("/dev/null", device.c_str()) == 0);
+
+    int err = 0;
+    CHECK(file_cache::load(fifo.c_str(), false, err) == nullptr);
+    CHECK_EQ(err, EACCES);
+    CHECK(file_cache::load(device.c_str(), true, err) == nullptr);
+    CHECK_EQ(err, EACCES);
+
+    file_cache cache(16, 1 << 20, false);
+    CHECK(cache.acquire(fifo.c_str(), err) == nullptr);
+    CHECK_EQ(err, EACCES);
+
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+    CHECK_HAS(http_conn_probe::serve(hc, "GET /pipe.html HTTP/1.1\r\nHost: x\r\n\r\n"), "HTTP/1.1 403");
+    http_conn_probe::reset(hc);
+    CHECK_HAS(http_conn_probe::serve(hc, "GET /null.html HTTP/1.1\r\nHost: x\r\n\r\n"), "HTTP/1.1 403");
+    http_conn_probe::reset(hc);
+    http_conn_probe::close(hc, peer);
+    delete hc;
+
+    unlink(fifo.c_str());
+    unlink(device.c_str());
+}
+
+/**
+ * @brief 命中时返回同一条目, 不再打开文件
+ */
+static void test_hit(){
+    file_cache cache(16, 1 << 20, false);
+    std::string path = write_file("hit.txt", "hit");
+    int err = 0;
+    file_entry* first = cache.acquire(path.c_str(), err);
+    CHECK(first && first->cached && first->refcount.load() == 2);
+
+    // 删除后(没有 watch)仍然命中
+    unlink(path.c_str());
+    file_entry* second = cache.acquire(path.c_str(), err);
+    CHECK(second == first);
+    CHECK(first && first->refcount.load() == 3);
+    if(second) file_cache::release(second);
+
+    // 不规范的路径不缓存, 每次重新打开
+    write_file("hit.txt", "hit");
+    std::string odd = std::string(test_root()) + "/./hit.txt";
+    file_entry* entry = cache.acquire(odd.c_str(), err);
+    CHECK(entry && !entry->cached && entry != first);
+    CHECK(!file_cache_probe::cached(cache, odd));
+    if(entry) file_cache::release(entry);
+
+    // 失效后重新加载
+    cache.invalidate(path);
+    CHECK(!file_cache_probe::cached(cache, path));
+    entry = cache.acquire(path.c_str(), err);
+    CHECK(entry && entry != first && entry->cached);
+    if(entry) file_cache::release(entry);
+    // 失效的条目在最后一个引用释放前仍然可用
+    CHECK(first && first->refcount.load() == 1 && first->fd != -1);
+    if(first) file_cache::release(first);
+}
+
+/**
+ * @brief 每个分片按 LRU 淘汰, 条目数与总大小都有上限
+ */
+static void test_lru(){
+    // 每个分片最多 16 / 16 + 1 = 2 个文件
+    file_cache cache(16, 1 << 20, false);
+    std::vector<std::string> paths = same_shard(cache, "lru", 3, 10);
+    int err = 0;
+    for(int i = 0; i < 2; i++){
+        file_entry* entry = cache.acquire(paths[i].c_str(), err);
+        CHECK(entry != nullptr);
+        if(entry) file_cache::release(entry);
+    }
+    // 再次使用第一个, 第二个成为最久未使用
+    file_entry* entry = cache.acquire(paths[0].c_str(), err);
+    if(entry) file_cache::release(entry);
+    entry = cache.acquire(paths[2].c_str(), err);
+    if(entry) file_cache::release(entry);
+    CHECK(file_cache_probe::cached(cache, paths[0]));
+    CHECK(!file_cache_probe::cached(cache, paths[1]));
+    CHECK(file_cache_probe::cached(cache, paths[2]));
+
+    // 每个分片最多 (16 * 1024) / 16 + 1 = 1025 字节: 两个 600 字节的文件放不下, 先加入的被淘汰
+    file_cache small(64, 16 * 1024, false);
+    paths = same_shard(small, "big", 2, 600);
+    entry = small.acquire(paths[0].c_str(), err);
+    file_entry* kept = entry;
+    entry = small.acquire(paths[1].c_str(), err);
+    CHECK(!file_cache_probe::cached(small, paths[0]));
+    CHECK(file_cache_probe::cached(small, paths[1]));
+    // 被淘汰的条目在释放前仍然有效
+    CHECK(kept && kept->refcount.load() == 1 && kept->st.st_size == 600);
+    if(kept) file_cache::release(kept);
+    if(entry) file_cache::release(entry);
+
+    // 超过分片容量的文件不缓存
+    std::string huge = write_file("huge.txt", std::string(2000, 'h'));
+    entry = small.acquire(huge.c_str(), err);
+    CHECK(entry && !entry->cached);
+    CHECK(!file_cache_probe::cached(small, huge));
+    if(entry) file_cache::release(entry);
+}
+
+/**
+ * @brief 加载期间分片失效过(generation 变化)时不加入缓存, 避免缓存已被修改的旧内容
+ */
+static void test_generation(){
+    file_cache cache(16, 1 << 20, false);
+    std::string path = write_file("generation.txt", "old");
+    int err = 0;
+
+    unsigned long generation = file_cache_probe::generation(cache, path);
+    file_entry* entry = file_cache::load(path.c_str(), false, err);
+    cache.invalidate(path);
+    CHECK_EQ(file_cache_probe::generation(cache, path), generation + 1);
+    CHECK(entry != nullptr);
+    if(!entry) return;
+    file_entry* used = file_cache_probe::insert(cache, path, entry, generation);
+    CHECK(used == entry && !entry->cached);
+    CHECK(!file_cache_probe::cached(cache, path));
+    file_cache::release(entry);
+
+    // generation 未变化时加入; 其他线程已加入时使用已缓存的条目
+    generation = file_cache_probe::generation(cache, path);
+    entry = file_cache::load(path.c_str(), false, err);
+    used = file_cache_probe::insert(cache, path, entry, generation);
+    CHECK(used == entry && entry->cached);
+    file_entry* other = file_cache::load(path.c_str(), false, err);
+    used = file_cache_probe::insert(cache, path, other, generation);
+    CHECK(used == entry);
+    file_cache::release(used);
+    file_cache::release(entry);
+
+    // clear() 使所有分片失效
+    generation = file_cache_probe::generation(cache, path);
+    cache.clear();
+    CHECK_EQ(file_cache_probe::generation(cache, path), generation + 1);
+    CHECK(!file_cache_probe::cached(cache, path));
+}
+
+/**
+ * @brief 等待 watcher 线程处理 inotify 事件, 最多 2 秒
+ */
+static bool wait_evicted(file_cache& cache, const std::string& path){
+    for(int i = 0; i < 200; i++){
+        if(!file_cache_probe::cached(cache, path)) return true;
+        usleep(10 * 1000);
+    }
+    return false;
+}
+
+static void test_inotify(){
+    std::string dir = std::string(test_root()) + "/watched";
+    CHECK(mkdir(dir.c_str(), 0755) == 0);
+    std::string path = write_file("watched/page.txt", "first");
+
+    file_cache cache(16, 1 << 20, false);
+    CHECK(cache.watch(test_root()));
+    int err = 0;
+    file_entry* entry = cache.acquire(path.c_str(), err);
+    if(entry) file_cache::release(entry);
+    CHECK(file_cache_probe::cached(cache, path));
+
+    // 修改后失效, 再次获取得到新内容
+    write_file("watched/page.txt", "second version");
+    CHECK(wait_evicted(cache, path));
+    entry = cache.acquire(path.c_str(), err);
+    CHECK(entry && entry->st.st_size == (off_t)strlen("second version"));
+    if(entry) file_cache::release(entry);
+
+    // 删除后失效, 之后返回 ENOENT
+    CHECK(file_cache_probe::cached(cache, path));
+    unlink(path.c_str());
+    CHECK(wait_evicted(cache, path));
+    CHECK(cache.acquire(path.c_str(), err) == nullptr);
+    CHECK_EQ(err, ENOENT);
+
+    // 监听开始后新建的子目录也被监听
+    std::string sub = dir + "/sub";
+    CHECK(mkdir(sub.c_str(), 0755) == 0);
+    usleep(100 * 1000);
+    path = write_file("watched/sub/new.txt", "new");
+    entry = cache.acquire(path.c_str(), err);
+    if(entry) file_cache::release(entry);
+    CHECK(file_cache_probe::cached(cache, path));
+    write_file("watched/sub/new.txt", "newer");
+    CHECK(wait_evicted(cache, path));
+}
+
+/**
+ * @brief gzip 版本: 只为缓存中的可压缩文件生成, 内容可以解压回原文件, ETag 与原文件不同
+ */
+static void test_gzip_variant(){
+    std::string content;
+    for(int i = 0; i < 100; i++) content += "<li>compressible line " + std::to_string(i % 7) + "</li>\n";
+    std::string path = write_file("gzip.html", content);
+
+    for(int map = 0; map < 2; map++){
+        file_cache cache(16, 1 << 20, map);
+        int err = 0;
+        file_entry* entry = cache.acquire(path.c_str(), err);
+        CHECK(entry && entry->compressible);
+        if(!entry) continue;
+        const file_variant* gzip = file_cache::gzip_variant(entry);
+        CHECK(gzip != nullptr);
+        if(!gzip){
+            file_cache::release(entry);
+            continue;
+        }
+        CHECK(gzip->size < entry->st.st_size);
+        CHECK(file_cache::gzip_variant(entry) == gzip);     // 只压缩一次
+
+        std::string data(gzip->size, '\0');
+        if(map) memcpy(&data[0], gzip->address, gzip->size);
+        else CHECK_EQ(pread(gzip->fd, &data[0], data.size(), 0), gzip->size);
+        CHECK(gunzip(data.data(), data.size()) == content);
+
+        // ETag 为原文件的 ETag 加上 "-gz", 其余验证器相同
+        char etag[file_cache::MAX_ETAG_LEN];
+        std::string plain(etag, file_cache::format_etag(etag, entry->st));
+        std::string gz = plain.substr(0, plain.size() - 1) + "-gz\"";
+        CHECK_HAS(entry->validators, "ETag: " + plain + "\r\n");
+        CHECK_HAS(gzip->validators, "ETag: " + gz + "\r\n");
+        CHECK_HAS(gzip->validators, "Vary: Accept-Encoding\r\n");
+        CHECK_HAS(gzip->headers, "Content-Length: " + std::to_string(gzip->size) + "\r\n");
+        CHECK_HAS(gzip->headers, "Content-Encoding: gzip\r\n");
+        CHECK(gzip->headers.find("Accept-Ranges") == std::string::npos);
+        file_cache::release(entry);
+
+        // 不在缓存中的条目不压缩
+        entry = file_cache::load(path.c_str(), map, err);
+        CHECK(entry && file_cache::gzip_variant(entry) == nullptr);
+        if(entry) file_cache::release(entry);
+    }
+
+    // 二进制类型与压缩后没有变小的文件没有 gzip 版本
+    file_cache cache(16, 1 << 20, false);
+    int err = 0;
+    std::string png = write_file("gzip.png", content);
+    file_entry* entry = cache.acquire(png.c_str(), err);
+    CHECK(entry && !entry->compressible && file_cache::gzip_variant(entry) == nullptr);
+    if(entry) file_cache::release(entry);
+    std::string noise;
+    uint32_t x = 12345;
+    for(int i = 0; i < 256; i++){
+        x = x * 1103515245u + 12345u;
+        noise.push_back((char)(x >> 24));
+    }
+    std::string txt = write_file("gzip-noise.txt", noise);
+    entry = cache.acquire(txt.c_str(), err);
+    CHECK(entry && entry->compressible && file_cache::gzip_variant(entry) == nullptr);
+    if(entry) file_cache::release(entry);
+
+    // 响应中按 Accept-Encoding 选择版本
+    http_conn::m_file_cache = &cache;
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+    std::string resp = http_conn_probe::serve(hc, "GET /gzip.html HTTP/1.1\r\nHost: x\r\nAccept-Encoding: br, gzip\r\n\r\n");
+    CHECK_HAS(resp, "Content-Encoding: gzip\r\n");
+    CHECK_HAS(resp, "-gz\"\r\n");
+    CHECK(http_conn_probe::body_size(hc, 0) < (off_t)content.size());
+    http_conn_probe::reset(hc);
+    resp = http_conn_probe::serve(hc, "GET /gzip.html HTTP/1.1\r\nHost: x\r\nAccept-Encoding: gzip;q=0\r\n\r\n");
+    CHECK(resp.find("Content-Encoding") == std::string::npos);
+    CHECK_EQ(http_conn_probe::body_size(hc, 0), content.size());
+    http_conn_probe::reset(hc);
+    http_conn_probe::close(hc, peer);
+    delete hc;
+    http_conn::m_file_cache = nullptr;
+}
+
+void test_file_cache(){
+    test_special_files();
+    test_hit();
+    test_lru();
+    test_generation();
+    test_inotify();
+    test_gzip_variant();
+}
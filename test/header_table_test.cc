@@ -0,0 +1,121 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 请求头部表与头部名识别的测试
+ * @Date: 2026-10-17 21:32:08
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 21:32:08
+ */
+#include "test.h"
+
+static HEADER_NAME name_id(const char* name){
+    return http_scan::header_name(name, strlen(name));
+}
+
+static void test_header_name(){
+    CHECK_EQ(name_id("Host"), HEADER_HOST);
+    CHECK_EQ(name_id("Content-Length"), HEADER_CONTENT_LENGTH);
+    CHECK_EQ(name_id("If-Modified-Since"), HEADER_IF_MODIFIED_SINCE);
+    CHECK_EQ(name_id("Transfer-Encoding"), HEADER_TRANSFER_ENCODING);
+    // 不区分大小写
+    CHECK_EQ(name_id("cOnTeNt-lEnGtH"), HEADER_CONTENT_LENGTH);
+    CHECK_EQ(name_id("ACCEPT-ENCODING"), HEADER_ACCEPT_ENCODING);
+    CHECK_EQ(name_id("if-none-match"), HEADER_IF_NONE_MATCH);
+    // 前缀、同长度的其他名字与空名字都不是已知头部
+    CHECK_EQ(name_id("Hos"), HEADER_UNKNOWN);
+    CHECK_EQ(name_id("Hosts"), HEADER_UNKNOWN);
+    CHECK_EQ(name_id("Rangf"), HEADER_UNKNOWN);
+    CHECK_EQ(name_id("X-Request-Id"), HEADER_UNKNOWN);
+    CHECK_EQ(name_id(""), HEADER_UNKNOWN);
+}
+
+static void test_table(){
+    header_table table;
+    table.clear();
+    CHECK_EQ(table.size(), 0);
+    CHECK(table.get(HEADER_HOST) == nullptr);
+    CHECK(table.find("Host") == nullptr);
+
+    CHECK(table.add("Host", 4, "a", 1, HEADER_HOST));
+    CHECK(table.add("X-Trace", 7, "t1", 2, HEADER_UNKNOWN));
+    CHECK(table.add("host", 4, "b", 1, HEADER_HOST));
+    CHECK(table.add("x-trace", 7, "t2", 2, HEADER_UNKNOWN));
+    CHECK_EQ(table.size(), 4);
+
+    // 重复的头部都保留, 已知头部的下标与按名字查找都指向第一个
+    const header_view* h = table.get(HEADER_HOST);
+    CHECK(h && strcmp(h->value, "a") == 0 && h->value_len == 1);
+    h = table.find("HOST");
+    CHECK(h && strcmp(h->value, "a") == 0);
+    h = table.find("X-TRACE");
+    CHECK(h && strcmp(h->value, "t1") == 0 && h->id == HEADER_UNKNOWN);
+    CHECK(strcmp(table[3].value, "t2") == 0);
+    CHECK(table.find("X-Trac") == nullptr);
+    CHECK(table.get(HEADER_RANGE) == nullptr);
+
+    // 名字与值随读缓冲区移动
+    char buf[] = "Accept\0*/*";
+    table.clear();
+    CHECK(table.add(buf, 6, buf + 7, 3, HEADER_ACCEPT));
+    char moved[sizeof(buf)];
+    memcpy(moved, buf, sizeof(buf));
+    table.rebase(moved - buf);
+    h = table.get(HEADER_ACCEPT);
+    CHECK(h && h->name == moved && h->value == moved + 7);
+
+    // 超过 MAX_HEADERS 时拒绝, 已登记的不受影响
+    table.clear();
+    for(int i = 0; i < header_table::MAX_HEADERS; i++){
+        CHECK(table.add("X-N", 3, "v", 1, HEADER_UNKNOWN));
+    }
+    CHECK(!table.add("Range", 5, "bytes=0-0", 9, HEADER_RANGE));
+    CHECK_EQ(table.size(), header_table::MAX_HEADERS);
+    CHECK(table.get(HEADER_RANGE) == nullptr);
+
+    // clear() 之后下标也一起清空
+    table.clear();
+    CHECK(table.get(HEADER_ACCEPT) == nullptr);
+    CHECK_EQ(table.size(), 0);
+}
+
+static void test_request_headers(){
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+
+    http_conn_probe::read(hc, "GET /no-such-file.html HTTP/1.1\r\nhOST: first\r\nX-Trace:  t1 \r\nHost: second\r\n\r\n");
+    const header_table& headers = hc->headers();
+    CHECK_EQ(headers.size(), 3);
+    const header_view* h = headers.get(HEADER_HOST);
+    CHECK(h && strcmp(h->value, "first") == 0);
+    h = headers.find("x-trace");
+    CHECK(h && strcmp(h->value, "t1") == 0 && h->value_len == 2);
+    http_conn_probe::close(hc, peer);
+
+    // 头部数超过 MAX_HEADERS 时返回 431 并关闭连接
+    peer = http_conn_probe::open(hc);
+    std::string request = "GET / HTTP/1.1\r\n";
+    for(int i = 0; i <= header_table::MAX_HEADERS; i++) request += "X-N" + std::to_string(i) + ": v\r\n";
+    request += "\r\n";
+    std::string resp = http_conn_probe::serve(hc, request);
+    CHECK_HAS(resp, "HTTP/1.1 431");
+    CHECK_EQ(http_conn_probe::response_count(hc), 1);
+    CHECK(http_conn_probe::closes(hc, 0));
+    http_conn_probe::reset(hc);
+    http_conn_probe::close(hc, peer);
+
+    // 刚好 MAX_HEADERS 个可以接受
+    peer = http_conn_probe::open(hc);
+    request = "GET " HEALTH_URL " HTTP/1.1\r\n";
+    for(int i = 0; i < header_table::MAX_HEADERS; i++) request += "X-N" + std::to_string(i) + ": v\r\n";
+    request += "\r\n";
+    CHECK_HAS(http_conn_probe::serve(hc, request), "HTTP/1.1 200");
+    http_conn_probe::reset(hc);
+    http_conn_probe::close(hc, peer);
+    delete hc;
+}
+
+void test_header_table(){
+    test_header_name();
+    test_table();
+    test_request_headers();
+}
@@ -1,36 +1,155 @@
 /*
  * @Author: fs1n
  * @Email: fs1n@qq.com
- * @Description: {To be filled in}
+ * @Description: 请求解析与静态文件映射的测试, 以及测试程序的 main()
  * @Date: 2023-03-22 16:05:55
  * @LastEditors: fs1n
- * @LastEditTime: 2023-03-22 17:26:06
+ * @LastEditTime: 2026-10-17 19:20:12
  */
-#include "../include/http_conn.h"
+#include "test.h"
+#include <ftw.h>
 
-void test_parse_request_line(){
-    char text[1024];
-    memset(text, '\0', sizeof(text));
-    strcpy(text, "GET /index.html HTTP/1.1\0");
-    http_conn *hc = new http_conn();
-    hc->init();
-    std::cout << "text: " << text << std::endl;
-    hc->parse_request_line(text);
+int g_failures = 0;
+
+static char s_root[] = "/tmp/nktest.XXXXXX";
+static bool s_root_created = false;
+
+const char* test_root(){
+    if(!s_root_created){
+        if(!mkdtemp(s_root)){
+            perror("mkdtemp");
+            exit(1);
+        }
+        s_root_created = true;
+    }
+    return s_root;
+}
+
+std::string write_file(const char* name, const std::string& content){
+    std::string path = std::string(test_root()) + "/" + name;
+    // 逐级创建所在目录
+    for(size_t pos = strlen(test_root()) + 1; (pos = path.find('/', pos)) != std::string::npos; pos++){
+        mkdir(path.substr(0, pos).c_str(), 0755);
+    }
+    FILE* fp = fopen(path.c_str(), "w");
+    if(!fp){
+        perror(path.c_str());
+        exit(1);
+    }
+    fwrite(content.data(), 1, content.size(), fp);
+    fclose(fp);
+    return path;
+}
+
+static int remove_entry(const char* path, const struct stat* st, int flag, struct FTW* ftw){
+    (void)st; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+static void test_parse_request_line(){
+    http_conn* hc = new http_conn();
+    http_conn_probe::init(hc);
+    char text[] = "GET /index.html?a=1 HTTP/1.1";
+    CHECK_EQ(http_conn_probe::parse_request_line(hc, text), http_conn::NO_REQUEST);
+    CHECK(strcmp(hc->path(), "/index.html") == 0);
+    CHECK(hc->query() && strcmp(hc->query(), "a=1") == 0);
+
+    http_conn_probe::init(hc);
+    char absolute[] = "GET http://localhost:9006/index.html HTTP/1.1";
+    CHECK_EQ(http_conn_probe::parse_request_line(hc, absolute), http_conn::NO_REQUEST);
+    CHECK(strcmp(hc->path(), "/index.html") == 0);
+
+    http_conn_probe::init(hc);
+    char version[] = "GET /index.html HTTP/1.0";
+    CHECK_EQ(http_conn_probe::parse_request_line(hc, version), http_conn::BAD_REQUEST);
+
+    http_conn_probe::init(hc);
+    char method[] = "DELETE /index.html HTTP/1.1";
+    CHECK_EQ(http_conn_probe::parse_request_line(hc, method), http_conn::BAD_REQUEST);
+    delete hc;
+}
+
+static void test_parse_header(){
+    http_conn* hc = new http_conn();
+    http_conn_probe::init(hc);
+    char length[] = "Content-Length: 1024";
+    CHECK_EQ(http_conn_probe::parse_header(hc, length), http_conn::NO_REQUEST);
+    char invalid[] = "Content-Length: 10x";
+    CHECK_EQ(http_conn_probe::parse_header(hc, invalid), http_conn::BAD_REQUEST);
+    delete hc;
+}
+
+/**
+ * @brief URL 中的 ".." 段不能离开 DOC_ROOT
+ */
+static void test_path_traversal(){
+    std::string content(1000, 'x');
+    write_file("index.html", content);
+    write_file("a..b.txt", "dots");
+
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+    CHECK(peer >= 0);
+
+    std::string resp = http_conn_probe::serve(hc, "GET /index.html HTTP/1.1\r\nHost: x\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 200");
+    CHECK_EQ(http_conn_probe::body_size(hc, 0), content.size());
+    http_conn_probe::reset(hc);
+
+    // 名字中含 ".." 但不是 ".." 段的文件正常返回
+    resp = http_conn_probe::serve(hc, "GET /a..b.txt HTTP/1.1\r\nHost: x\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 200");
+    http_conn_probe::reset(hc);
+
+    const char* escapes[] = {
+        "GET /../../../etc/passwd HTTP/1.1\r\nHost: x\r\n\r\n",
+        "GET /sub/../index.html HTTP/1.1\r\nHost: x\r\n\r\n",
+        "GET /.. HTTP/1.1\r\nHost: x\r\n\r\n",
+        "GET http://x/../etc/passwd HTTP/1.1\r\nHost: x\r\n\r\n",
+    };
+    for(const char* request : escapes){
+        resp = http_conn_probe::serve(hc, request);
+        CHECK_HAS(resp, "HTTP/1.1 403");
+        http_conn_probe::reset(hc);
+    }
+
+    // 不以 '/' 开头的路径会拼接成 DOC_ROOT 的兄弟目录
+    resp = http_conn_probe::serve(hc, "GET index.html HTTP/1.1\r\nHost: x\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 400");
+    http_conn_probe::reset(hc);
+
+    http_conn_probe::close(hc, peer);
+    delete hc;
 }
 
-void test_parse_header(){
-    char text[1024];
-    memset(text, '\0', sizeof(text));
-    strcpy(text, "Content-Length:1024");
-    http_conn *hc = new http_conn();
-    hc->init();
-    std::cout << "text: " << text << std::endl;
-    hc->parse_header(text);
+void test_http_conn(){
+    test_parse_request_line();
+    test_parse_header();
+    test_path_traversal();
 }
 
 int main(){
-    // test_parse_request_line();
-    // test_parse_header();
+    DOC_ROOT = test_root();
+
+    test_http_conn();
+    test_pipeline();
+    test_header_table();
+    test_response();
+    test_http_scan();
+    test_router();
+    test_ranges();
+    test_conditional();
+    test_file_cache();
+    test_body();
+    test_timer_wheel();
+    test_mpmc_queue();
+    test_slab_pool();
 
+    nftw(test_root(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    if(g_failures){
+        fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("all tests passed\n");
     return 0;
-}
\ No newline at end of file
+}
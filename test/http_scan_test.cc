@@ -0,0 +1,120 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: http_scan 各指令集实现的一致性测试: find 与逐字节查找一致, 请求语料在各指令集下的解析结果一致
+ * @Date: 2026-10-17 22:21:15
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 22:21:15
+ */
+#include "test.h"
+
+static const char* CORPUS[] = {
+    // curl
+    "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1:9006\r\nUser-Agent: curl/8.5.0\r\nAccept: */*\r\n\r\n",
+    // 浏览器
+    "GET /images/tmp1.jpg HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"118\", \"Google Chrome\";v=\"118\", \"Not=A?Brand\";v=\"99\"\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/118.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Cookie: _ga=GA1.1.1234567890.1697500000; session=0123456789abcdef0123456789abcdef; theme=dark\r\n"
+    "\r\n",
+    // 大小写, 多余空格, 绝对 URL
+    "get http://example.com/a/b/c.html http/1.1\r\nhost:   example.com\r\nCONNECTION: close\r\ncontent-length: 0\r\n\r\n",
+    "GET /a HTTP/1.1\r\nContent-Length:  0\r\nAccept-Encoding:gzip\r\nHost:\r\nX-Host: no\r\nHostname: no\r\n\r\n",
+    // 相似但不同的头部名
+    "GET / HTTP/1.1\r\nConnection-Foo: close\r\nContent-Lengthx: 5\r\nAccept: gzip\r\nHost : a\r\nNoColon\r\n\r\n",
+    // 流水线
+    "GET /1 HTTP/1.1\r\nHost: a\r\n\r\nGET /2 HTTP/1.1\r\nHost: b\r\n\r\nGET /3 HTTP/1.1\r\nConnection: close\r\n\r\n",
+    // 不完整
+    "GET /index.html HTTP/1.1\r\nHost: a\r\nUser-Agent: partial",
+    "GET /index.html HTTP/1.1\r\nHost: a\r",
+    // 非 ASCII 字节
+    "GET /\xe4\xb8\xad\xe6\x96\x87.html HTTP/1.1\r\nX-Bytes: \x80\xff\xfe\r\nHost: \xc3\xa9\r\n\r\n",
+    // 错误
+    "GET /index.html HTTP/1.0\r\n\r\n",
+    "DELETE /index.html HTTP/1.1\r\n\r\n",
+    "GET\r\n\r\n",
+    "GET /index.html\r\n\r\n",
+    "GET /index.html HTTP/1.1\rX\r\n\r\n",
+};
+
+/**
+ * @brief 每个指令集的 find 与逐字节查找在所有对齐/长度/位置上结果一致, 包括最高位为 1 的字节
+ */
+static void check_find(http_scan::ISA isa){
+    char buf[256];
+    for(int i = 0; i < (int)sizeof(buf); i++) buf[i] = i % 3 ? 'a' + i % 26 : (char)(0x80 + i % 128);
+    for(int begin = 0; begin < 40; begin++){
+        for(int end = begin; end <= (int)sizeof(buf); end += 7){
+            for(int pos = begin; pos <= end; pos++){
+                char saved = 0;
+                if(pos < end){ saved = buf[pos]; buf[pos] = '\r'; }
+                const char* got = http_scan::find((const char*)buf + begin, buf + end, '\r');
+                if(pos < end) buf[pos] = saved;
+                if(got != buf + pos){
+                    fprintf(stderr, "%s:%d: %s find mismatch: begin %d end %d pos %d got %ld\n",
+                            __FILE__, __LINE__, http_scan::isa_name(isa), begin, end, pos, (long)(got - buf));
+                    g_failures++;
+                    return;
+                }
+            }
+        }
+    }
+    // 查找最高位为 1 的字符
+    char* found = http_scan::find(buf, buf + sizeof(buf), (char)0xfe);
+    const char* expect = (const char*)memchr(buf, 0xfe, sizeof(buf));
+    CHECK(found == (expect ? expect : buf + sizeof(buf)));
+}
+
+/**
+ * @brief 用当前指令集处理语料中的请求, 返回去掉 Date 后的响应与读缓冲区中剩余的数据
+ */
+static std::string serve_corpus(const char* request){
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+    std::string resp = http_conn_probe::serve(hc, request);
+    size_t pos;
+    while((pos = resp.find("\r\nDate: ")) != std::string::npos){
+        resp.erase(pos + 2, resp.find("\r\n", pos + 2) - pos);
+    }
+    std::string text = std::to_string(http_conn_probe::response_count(hc)) + "\n" + resp
+                     + "\npending: " + http_conn_probe::pending(hc);
+    http_conn_probe::reset(hc);
+    http_conn_probe::close(hc, peer);
+    delete hc;
+    return text;
+}
+
+void test_http_scan(){
+    http_scan::ISA best = http_scan::isa();
+    const int corpus_size = sizeof(CORPUS) / sizeof(CORPUS[0]);
+    std::string expect[corpus_size];
+
+    CHECK(http_scan::select(http_scan::SCALAR));
+    for(int i = 0; i < corpus_size; i++) expect[i] = serve_corpus(CORPUS[i]);
+    // 语料覆盖了完整、流水线、不完整与错误的请求
+    CHECK(expect[0].compare(0, 2, "1\n") == 0);
+    CHECK(expect[5].compare(0, 2, "3\n") == 0);
+    CHECK(expect[6].compare(0, 2, "0\n") == 0);
+
+    // 测试所有可用的指令集, CPU 不支持的跳过
+    for(int isa = http_scan::SCALAR; isa <= http_scan::AVX2; isa++){
+        if(!http_scan::select((http_scan::ISA)isa)) continue;
+        check_find((http_scan::ISA)isa);
+        for(int i = 0; i < corpus_size; i++){
+            std::string got = serve_corpus(CORPUS[i]);
+            if(got != expect[i]){
+                fprintf(stderr, "%s:%d: %s corpus %d mismatch:\n%s\n---\n%s\n", __FILE__, __LINE__,
+                        http_scan::isa_name((http_scan::ISA)isa), i, expect[i].c_str(), got.c_str());
+                g_failures++;
+            }
+        }
+    }
+    http_scan::select(best);
+}
@@ -0,0 +1,105 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 有界 MPMC 环形队列的测试
+ * @Date: 2026-10-17 19:43:02
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 19:43:02
+ */
+#include "test.h"
+#include "mpmc_queue.h"
+#include <thread>
+#include <vector>
+
+static void test_bounds(){
+    bool thrown = false;
+    try{
+        mpmc_queue<int> empty(0);
+    }catch(const std::exception&){
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    // 容量不要求是 2 的幂, 多次绕回后仍保持 FIFO
+    mpmc_queue<int> q(3);
+    CHECK_EQ(q.capacity(), 3);
+    int value = -1;
+    CHECK(!q.pop(value));
+    int next_push = 0, next_pop = 0;
+    for(int round = 0; round < 100; round++){
+        while(q.push(next_push)) next_push++;
+        CHECK_EQ(q.size(), 3);
+        int n = round % 3 + 1;
+        for(int i = 0; i < n; i++){
+            CHECK(q.pop(value));
+            CHECK_EQ(value, next_pop);
+            next_pop++;
+        }
+    }
+    while(q.pop(value)){
+        CHECK_EQ(value, next_pop);
+        next_pop++;
+    }
+    CHECK_EQ(next_pop, next_push);
+    CHECK_EQ(q.size(), 0);
+}
+
+/**
+ * @brief 多个生产者与消费者并发: 每个值恰好取出一次, 同一生产者的值在每个消费者中保持入队顺序
+ */
+static void test_concurrent(){
+    const int PRODUCERS = 3, CONSUMERS = 3, PER_PRODUCER = 100000;
+    mpmc_queue<uint64_t> q(64);
+    std::atomic<int> consumed(0);
+    std::vector<std::vector<uint64_t>> received(CONSUMERS);
+
+    std::vector<std::thread> threads;
+    for(int p = 0; p < PRODUCERS; p++){
+        threads.emplace_back([&q, p](){
+            for(uint64_t i = 0; i < PER_PRODUCER; i++){
+                while(!q.push((uint64_t)p << 32 | i)) std::this_thread::yield();
+            }
+        });
+    }
+    for(int c = 0; c < CONSUMERS; c++){
+        threads.emplace_back([&, c](){
+            uint64_t value;
+            while(consumed.load(std::memory_order_relaxed) < PRODUCERS * PER_PRODUCER){
+                if(q.pop(value)){
+                    received[c].push_back(value);
+                    consumed.fetch_add(1, std::memory_order_relaxed);
+                }else{
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for(std::thread& t : threads) t.join();
+
+    std::vector<int> seen((size_t)PRODUCERS * PER_PRODUCER, 0);
+    for(const std::vector<uint64_t>& values : received){
+        std::vector<int64_t> last(PRODUCERS, -1);
+        for(uint64_t value : values){
+            int p = (int)(value >> 32);
+            int64_t i = (int64_t)(value & 0xffffffffu);
+            CHECK(p < PRODUCERS && i < PER_PRODUCER);
+            if(p >= PRODUCERS || i >= PER_PRODUCER) continue;
+            CHECK(i > last[p]);
+            last[p] = i;
+            seen[(size_t)p * PER_PRODUCER + i]++;
+        }
+    }
+    int missing = 0, duplicated = 0;
+    for(int n : seen){
+        if(n == 0) missing++;
+        if(n > 1) duplicated++;
+    }
+    CHECK_EQ(missing, 0);
+    CHECK_EQ(duplicated, 0);
+    CHECK_EQ(q.size(), 0);
+}
+
+void test_mpmc_queue(){
+    test_bounds();
+    test_concurrent();
+}
@@ -0,0 +1,100 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 流水线请求的测试: 一次读到多个请求、保留未完整的请求、响应按顺序合并发送、请求分多次到达
+ * @Date: 2026-10-17 21:14:36
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 21:14:36
+ */
+#include "test.h"
+
+#define HEALTH_GET "GET " HEALTH_URL " HTTP/1.1\r\nHost: x\r\n\r\n"
+
+/**
+ * @brief 读出对端收到的全部数据
+ */
+static std::string drain(int peer){
+    std::string text;
+    char buf[4096];
+    ssize_t n;
+    while((n = ::read(peer, buf, sizeof(buf))) > 0) text.append(buf, n);
+    return text;
+}
+
+static void test_batch(){
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+
+    // 三个完整的请求与第四个请求的开头一起到达
+    std::string resp = http_conn_probe::serve(hc,
+        HEALTH_GET
+        "GET /no-such-file.html HTTP/1.1\r\nHost: x\r\n\r\n"
+        "POST " HEALTH_URL " HTTP/1.1\r\nHost: x\r\nContent-Length: 0\r\n\r\n"
+        "GET " HEALTH_URL " HT");
+    CHECK_EQ(http_conn_probe::response_count(hc), 3);
+    size_t ok = resp.find("HTTP/1.1 200");
+    size_t not_found = resp.find("HTTP/1.1 404");
+    size_t not_allowed = resp.find("HTTP/1.1 405");
+    CHECK(ok != std::string::npos && not_found != std::string::npos && not_allowed != std::string::npos);
+    CHECK(ok < not_found && not_found < not_allowed);
+    for(int i = 0; i < 3; i++) CHECK(!http_conn_probe::closes(hc, i));
+    CHECK(http_conn_probe::pending(hc) == "GET " HEALTH_URL " HT");
+
+    // 三个响应都在写缓冲区中, 一次 sendmsg 按顺序发出
+    http_conn_probe::send_op op;
+    CHECK(http_conn_probe::prepare_send(hc, op));
+    CHECK_EQ(op.file_fd, -1);
+    CHECK_EQ(op.iov_count, 3);
+    size_t total = 0;
+    for(int i = 0; i < op.iov_count; i++) total += op.iov[i].iov_len;
+    CHECK_EQ(total, resp.size());
+    CHECK(hc->write());
+    CHECK_EQ(http_conn_probe::response_count(hc), 0);
+    CHECK(drain(peer) == resp);
+
+    // 剩余部分到达后完成第四个请求
+    resp = http_conn_probe::serve(hc, "TP/1.1\r\nHost: x\r\n\r\n");
+    CHECK_EQ(http_conn_probe::response_count(hc), 1);
+    CHECK_HAS(resp, "application/json");
+    CHECK(http_conn_probe::pending(hc).empty());
+    http_conn_probe::reset(hc);
+
+    http_conn_probe::close(hc, peer);
+    delete hc;
+}
+
+/**
+ * @brief 请求逐字节到达, 包括 "\r" 与 "\n" 分在两次读中
+ */
+static void test_split(){
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+
+    std::string request = "GET " HEALTH_URL "?a=1 HTTP/1.1\r\nHost: x\r\nAccept: */*\r\n\r\n";
+    std::string resp;
+    for(size_t i = 0; i < request.size(); i++){
+        resp = http_conn_probe::serve(hc, request.substr(i, 1));
+        if(i + 1 < request.size()) CHECK_EQ(http_conn_probe::response_count(hc), 0);
+    }
+    CHECK_EQ(http_conn_probe::response_count(hc), 1);
+    CHECK_HAS(resp, "HTTP/1.1 200");
+    CHECK_HAS(resp, "application/json");
+    http_conn_probe::reset(hc);
+
+    // 响应发出前下一个请求就已到达
+    resp = http_conn_probe::serve(hc, HEALTH_GET "GET /no-such-file.html");
+    CHECK_EQ(http_conn_probe::response_count(hc), 1);
+    resp += http_conn_probe::serve(hc, " HTTP/1.1\r\nHost: x\r\n\r\n");
+    CHECK_EQ(http_conn_probe::response_count(hc), 2);
+    CHECK(resp.find("HTTP/1.1 200") < resp.find("HTTP/1.1 404"));
+    CHECK(hc->write());
+    CHECK(drain(peer) == resp);
+
+    http_conn_probe::close(hc, peer);
+    delete hc;
+}
+
+void test_pipeline(){
+    test_batch();
+    test_split();
+}
@@ -0,0 +1,133 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: Range 解析与 206、416、multipart/byteranges 响应的测试
+ * @Date: 2026-10-17 19:27:05
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 19:27:05
+ */
+#include "test.h"
+
+static const off_t FILE_SIZE = 1000;
+
+static void test_parse_ranges(){
+    http_conn_probe::byte_range r[http_conn::MAX_RANGES];
+    const int max = http_conn::MAX_RANGES;
+
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=0-499", FILE_SIZE, r, max), 1);
+    CHECK(r[0].first == 0 && r[0].last == 499);
+
+    // 最后 n 个字节, 超过文件长度时为整个文件
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=-100", FILE_SIZE, r, max), 1);
+    CHECK(r[0].first == 900 && r[0].last == 999);
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=-5000", FILE_SIZE, r, max), 1);
+    CHECK(r[0].first == 0 && r[0].last == 999);
+
+    // 到文件末尾, 超出的部分截去
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=990-", FILE_SIZE, r, max), 1);
+    CHECK(r[0].first == 990 && r[0].last == 999);
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=990-5000", FILE_SIZE, r, max), 1);
+    CHECK(r[0].first == 990 && r[0].last == 999);
+
+    // 重叠的范围按请求中的顺序保留
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=0-99, 50-149,-10", FILE_SIZE, r, max), 3);
+    CHECK(r[0].first == 0 && r[0].last == 99);
+    CHECK(r[1].first == 50 && r[1].last == 149);
+    CHECK(r[2].first == 990 && r[2].last == 999);
+
+    // 完全在文件之外的范围跳过, 都在之外时为 0(416)
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=1000-1100,0-0", FILE_SIZE, r, max), 1);
+    CHECK(r[0].first == 0 && r[0].last == 0);
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=1000-", FILE_SIZE, r, max), 0);
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=-0", FILE_SIZE, r, max), 0);
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=0-", 0, r, max), 0);
+
+    // 格式错误、单位不是 bytes 或范围过多时忽略 Range
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=500-100", FILE_SIZE, r, max), -1);
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=abc", FILE_SIZE, r, max), -1);
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=0-1;", FILE_SIZE, r, max), -1);
+    CHECK_EQ(http_conn_probe::parse_ranges("items=0-1", FILE_SIZE, r, max), -1);
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=", FILE_SIZE, r, max), -1);
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=0-0,1-1,2-2", FILE_SIZE, r, 2), -1);
+    // 超过 off_t 的数取最大值, 不会溢出
+    CHECK_EQ(http_conn_probe::parse_ranges("bytes=0-99999999999999999999999", FILE_SIZE, r, max), 1);
+    CHECK(r[0].first == 0 && r[0].last == 999);
+}
+
+/**
+ * @brief 取响应头中某个字段的值
+ */
+static std::string header_value(const std::string& resp, const char* name){
+    size_t pos = resp.find(std::string("\r\n") + name + ": ");
+    if(pos == std::string::npos) return std::string();
+    pos += strlen(name) + 4;
+    return resp.substr(pos, resp.find("\r\n", pos) - pos);
+}
+
+static void test_range_responses(){
+    std::string content;
+    for(off_t i = 0; i < FILE_SIZE; i++) content.push_back('a' + i % 26);
+    write_file("range.txt", content);
+
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+
+    std::string resp = http_conn_probe::serve(hc, "GET /range.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=-100\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 206");
+    CHECK_HAS(resp, "Content-Range: bytes 900-999/1000\r\n");
+    CHECK_HAS(resp, "Content-Length: 100\r\n");
+    CHECK_EQ(http_conn_probe::response_count(hc), 1);
+    CHECK_EQ(http_conn_probe::body_offset(hc, 0), 900);
+    CHECK_EQ(http_conn_probe::body_size(hc, 0), 100);
+    http_conn_probe::reset(hc);
+
+    resp = http_conn_probe::serve(hc, "GET /range.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=500-\r\n\r\n");
+    CHECK_HAS(resp, "Content-Range: bytes 500-999/1000\r\n");
+    CHECK_EQ(http_conn_probe::body_size(hc, 0), 500);
+    http_conn_probe::reset(hc);
+
+    resp = http_conn_probe::serve(hc, "GET /range.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=1000-2000\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 416");
+    CHECK_HAS(resp, "Content-Range: bytes */1000\r\n");
+    CHECK_EQ(http_conn_probe::body_size(hc, 0), 0);
+    http_conn_probe::reset(hc);
+
+    // 格式错误时忽略 Range, 返回整个文件
+    resp = http_conn_probe::serve(hc, "GET /range.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=9-1\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 200");
+    CHECK_EQ(http_conn_probe::body_size(hc, 0), FILE_SIZE);
+    http_conn_probe::reset(hc);
+
+    // 多段(含重叠的范围): 第一项是响应头, 每段一项, 最后一项是结束分隔行
+    resp = http_conn_probe::serve(hc, "GET /range.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=0-9,5-14,-3\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 206");
+    CHECK_HAS(resp, "Content-Type: multipart/byteranges; boundary=");
+    CHECK_HAS(resp, "Content-Range: bytes 0-9/1000\r\n");
+    CHECK_HAS(resp, "Content-Range: bytes 5-14/1000\r\n");
+    CHECK_HAS(resp, "Content-Range: bytes 997-999/1000\r\n");
+    CHECK_EQ(http_conn_probe::response_count(hc), 4);
+    CHECK_EQ(http_conn_probe::body_offset(hc, 1), 5);
+    CHECK_EQ(http_conn_probe::body_size(hc, 1), 10);
+    // Content-Length 与实际发送的实体一致
+    long length = 0;
+    for(int i = 0; i < http_conn_probe::response_count(hc); i++) length += http_conn_probe::body_size(hc, i);
+    length += resp.size() - (resp.find("\r\n\r\n") + 4);
+    CHECK_EQ(atol(header_value(resp, "Content-Length").c_str()), length);
+    std::string boundary = header_value(resp, "Content-Type").substr(strlen("multipart/byteranges; boundary="));
+    CHECK(resp.size() > boundary.size() + 8 && resp.compare(resp.size() - boundary.size() - 8, std::string::npos,
+                                                          "\r\n--" + boundary + "--\r\n") == 0);
+    http_conn_probe::reset(hc);
+
+    // If-Range 不一致时忽略 Range
+    resp = http_conn_probe::serve(hc, "GET /range.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=0-9\r\nIf-Range: \"stale\"\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 200");
+    http_conn_probe::reset(hc);
+
+    http_conn_probe::close(hc, peer);
+    delete hc;
+}
+
+void test_ranges(){
+    test_parse_ranges();
+    test_range_responses();
+}
@@ -0,0 +1,145 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 响应生成的测试: 扩展名对应的 Content-Type、预先生成的状态行与错误响应、Date 头与整数/日期格式化
+ * @Date: 2026-10-17 21:47:52
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 21:47:52
+ */
+#include "test.h"
+
+static std::string blob_text(const response_blob& blob){
+    return std::string(blob.data, blob.len);
+}
+
+static void test_content_type(){
+    const char* types[][2] = {
+        {"/www/index.html", "text/html"},
+        {"/www/index.htm", "text/html"},
+        {"/www/style.css", "text/css"},
+        {"/www/app.js", "application/javascript"},
+        {"/www/data.json", "application/json"},
+        {"/www/logo.png", "image/png"},
+        {"/www/photo.jpg", "image/jpeg"},
+        {"/www/icon.svg", "image/svg+xml"},
+        {"/www/font.woff2", "font/woff2"},
+        {"/www/font.woff", "font/woff"},
+        {"/www/notes.txt", "text/plain"},
+        {"/www/archive.tar.gz", "application/gzip"},
+        {"/www/PHOTO.JPEG", "image/jpeg"},          // 不区分大小写
+        // 不认识或没有扩展名时按二进制数据处理
+        {"/www/file.xyz", "application/octet-stream"},
+        {"/www/README", "application/octet-stream"},
+        {"/www/dir.html/README", "application/octet-stream"},
+        {"/www/file.", "application/octet-stream"},
+        {"/www/file.htmlx", "application/octet-stream"},
+        {"index.html", "text/html"},
+    };
+    for(auto& t : types){
+        const char* mime = file_cache::content_type(t[0]);
+        if(strcmp(mime, t[1]) != 0){
+            fprintf(stderr, "%s:%d: content_type(%s) = %s, expected %s\n", __FILE__, __LINE__, t[0], mime, t[1]);
+            g_failures++;
+        }
+    }
+
+    // 静态文件响应使用同一张表, 经过与不经过文件缓存都一样
+    write_file("style.css", "body{}\n");
+    write_file("blob.xyz", "data");
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+    for(int cached = 0; cached < 2; cached++){
+        file_cache cache(16, 1 << 20, !http_conn::m_use_sendfile);
+        http_conn::m_file_cache = cached ? &cache : nullptr;
+        CHECK_HAS(http_conn_probe::serve(hc, "GET /style.css HTTP/1.1\r\nHost: x\r\n\r\n"), "\r\nContent-Type: text/css\r\n");
+        http_conn_probe::reset(hc);
+        CHECK_HAS(http_conn_probe::serve(hc, "GET /blob.xyz HTTP/1.1\r\nHost: x\r\n\r\n"), "\r\nContent-Type: application/octet-stream\r\n");
+        http_conn_probe::reset(hc);
+        http_conn::m_file_cache = nullptr;
+    }
+    http_conn_probe::close(hc, peer);
+    delete hc;
+}
+
+static void test_error_blobs(){
+    CHECK(blob_text(http_response::status_line(200)) == "HTTP/1.1 200 OK\r\n");
+    CHECK(blob_text(http_response::status_line(400)) == "HTTP/1.1 400 Bad Request\r\n");
+    CHECK(blob_text(http_response::status_line(403)) == "HTTP/1.1 403 Forbidden\r\n");
+    CHECK(blob_text(http_response::status_line(404)) == "HTTP/1.1 404 Not Found\r\n");
+    CHECK(blob_text(http_response::status_line(500)) == "HTTP/1.1 500 Internal Error\r\n");
+    CHECK(blob_text(http_response::status_line(418)) == "HTTP/1.1 500 Internal Error\r\n");
+
+    const char* tails[][2] = {
+        {"400", "Content-Length: 68\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n"
+                "Your request has bad syntax or is inherently impossible to satisfy.\n"},
+        {"403", "Content-Length: 57\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n"
+                "You do not have permission to get file from this server.\n"},
+        {"404", "Content-Length: 49\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n"
+                "The requested file was not found on this server.\n"},
+        {"500", "Content-Length: 57\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n"
+                "There was an unusual problem serving the requested file.\n"},
+    };
+    for(auto& t : tails){
+        int status = atoi(t[0]);
+        std::string closed = t[1];
+        std::string kept = closed;
+        kept.replace(kept.find("close"), 5, "keep-alive");
+        CHECK(blob_text(http_response::error_tail(status, false)) == closed);
+        CHECK(blob_text(http_response::error_tail(status, true)) == kept);
+    }
+    // 不认识的状态码与没有错误页面的状态码使用 500 的页面
+    CHECK(blob_text(http_response::error_tail(418, true)) == blob_text(http_response::error_tail(500, true)));
+    CHECK(blob_text(http_response::error_tail(200, false)) == blob_text(http_response::error_tail(500, false)));
+
+    // 完整的错误响应: 状态行、Date 与尾部, 没有其他内容
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+    std::string resp = http_conn_probe::serve(hc, "GET /no-such-file.html HTTP/1.1\r\nHost: x\r\n\r\n");
+    const char* status = "HTTP/1.1 404 Not Found\r\n";
+    std::string date = resp.substr(strlen(status), 6 + http_response::MAX_DATE_LEN + 2);
+    time_t t;
+    CHECK(date.compare(0, 6, "Date: ") == 0 && http_response::parse_date(date.substr(6, http_response::MAX_DATE_LEN).c_str(), t));
+    CHECK(resp == status + date + blob_text(http_response::error_tail(404, true)));
+    http_conn_probe::reset(hc);
+    http_conn_probe::close(hc, peer);
+    delete hc;
+}
+
+static void test_date(){
+    char buf[http_response::MAX_DATE_LEN];
+    CHECK(std::string(buf, http_response::format_date(buf, 0)) == "Thu, 01 Jan 1970 00:00:00 GMT");
+    CHECK(std::string(buf, http_response::format_date(buf, 784111777)) == "Sun, 06 Nov 1994 08:49:37 GMT");
+    time_t t = 0;
+    CHECK(http_response::parse_date("Sun, 06 Nov 1994 08:49:37 GMT", t) && t == 784111777);
+    CHECK(!http_response::parse_date("Sun, 06 Nov 1994 08:49:37", t));
+    CHECK(!http_response::parse_date("Sunday, 06-Nov-94 08:49:37 GMT", t));
+    CHECK(!http_response::parse_date("Sun, 06 Nov 1994 08:49:37 GMT x", t));
+
+    // 缓存的 Date 头: 固定长度, 值是当前时间, 同一秒内复用同一段内容
+    time_t before = time(nullptr);
+    const response_blob& date = http_response::date_header();
+    std::string text = blob_text(date);
+    time_t after = time(nullptr);
+    CHECK_EQ(text.size(), 6 + http_response::MAX_DATE_LEN + 2);
+    CHECK(text.compare(0, 6, "Date: ") == 0 && text.compare(text.size() - 2, 2, "\r\n") == 0);
+    CHECK(http_response::parse_date(text.substr(6, http_response::MAX_DATE_LEN).c_str(), t));
+    // CLOCK_REALTIME_COARSE 可能比 time() 慢一个时钟周期
+    CHECK(t >= before - 1 && t <= after);
+    const response_blob& again = http_response::date_header();
+    CHECK(&again == &date && again.data == date.data);
+    if(time(nullptr) == after) CHECK(blob_text(again) == text);
+
+    char num[http_response::MAX_UINT_LEN];
+    CHECK(std::string(num, http_response::format_uint(num, 0)) == "0");
+    CHECK(std::string(num, http_response::format_uint(num, 9)) == "9");
+    CHECK(std::string(num, http_response::format_uint(num, 10)) == "10");
+    CHECK(std::string(num, http_response::format_uint(num, 100)) == "100");
+    CHECK(std::string(num, http_response::format_uint(num, 1234567)) == "1234567");
+    CHECK(std::string(num, http_response::format_uint(num, UINT64_MAX)) == "18446744073709551615");
+}
+
+void test_response(){
+    test_content_type();
+    test_error_blobs();
+    test_date();
+}
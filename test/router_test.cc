@@ -0,0 +1,118 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 路由表查找与处理函数应答的测试
+ * @Date: 2026-10-17 19:24:31
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 19:24:31
+ */
+#include "test.h"
+
+static void echo_handler(const http_conn& conn, route_reply& reply){
+    reply.body.append(conn.query() ? conn.query() : "");
+}
+
+// 状态表中没有的状态码
+static void odd_status_handler(const http_conn& conn, route_reply& reply){
+    (void)conn;
+    reply.status = 299;
+    reply.body.append("odd");
+}
+
+static void not_found_handler(const http_conn& conn, route_reply& reply){
+    (void)conn;
+    reply.status = 404;
+}
+
+static void test_route_table(){
+    static constexpr route ROUTES[] = {
+        {"/a", ROUTE_GET, echo_handler, nullptr},
+        {"/b", ROUTE_POST, echo_handler, nullptr},
+        {"/api/v1/items", ROUTE_GET | ROUTE_PUT, echo_handler, nullptr},
+        {"/api/v1/item", ROUTE_GET, echo_handler, nullptr},
+        {"/", ROUTE_GET, echo_handler, nullptr},
+    };
+    static constexpr route_table<sizeof(ROUTES) / sizeof(ROUTES[0])> table(ROUTES);
+
+    for(const route& r : ROUTES){
+        const route* found = table.find(r.path, strlen(r.path));
+        CHECK(found && strcmp(found->path, r.path) == 0 && found->methods == r.methods);
+    }
+    // 前缀、多一个字符、空路径都不命中
+    const char* misses[] = {"", "/c", "/a/", "/api/v1/items/", "/api/v1/ite", "/api/v1/itemz", "a"};
+    for(const char* path : misses){
+        CHECK(table.find(path, strlen(path)) == nullptr);
+    }
+    // 只比较 len 个字节
+    CHECK(table.find("/abc", 2) != nullptr);
+}
+
+static void test_router_find(){
+    const char* builtins[] = {METRICS_URL, UPLOAD_URL, HEALTH_URL};
+    for(const char* path : builtins){
+        const route* r = router::find(path, strlen(path));
+        CHECK(r && strcmp(r->path, path) == 0);
+    }
+    CHECK(router::find("/index.html", 11) == nullptr);
+    CHECK(router::find("/healthz/", 9) == nullptr);
+    CHECK(router::find("/metric", 7) == nullptr);
+
+    CHECK(router::add("/echo", ROUTE_GET, echo_handler));
+    CHECK(router::add("/odd", ROUTE_GET, odd_status_handler));
+    CHECK(router::add("/missing", ROUTE_GET, not_found_handler));
+    CHECK(!router::add("/echo", ROUTE_POST, echo_handler));            // 已存在
+    CHECK(!router::add(HEALTH_URL, ROUTE_POST, echo_handler));         // 与编译期路由重复
+    CHECK(!router::add("noslash", ROUTE_GET, echo_handler));
+    const route* r = router::find("/echo", 5);
+    CHECK(r && r->handler == echo_handler);
+    CHECK(router::find("/ech", 4) == nullptr);
+    CHECK(router::find("/echoo", 6) == nullptr);
+
+    char allow[router::MAX_ALLOW_LEN];
+    char* end = router::format_allow(allow, ROUTE_GET | ROUTE_POST | ROUTE_PUT);
+    CHECK(std::string(allow, end) == "Allow: GET, POST, PUT\r\n");
+}
+
+static void test_dispatch(){
+    http_conn* hc = new http_conn();
+    int peer = http_conn_probe::open(hc);
+
+    std::string resp = http_conn_probe::serve(hc, "GET /echo?x=1 HTTP/1.1\r\nHost: x\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 200");
+    CHECK_HAS(resp, "Content-Length: 3\r\n");
+    CHECK_HAS(resp, "\r\n\r\nx=1");
+    http_conn_probe::reset(hc);
+
+    resp = http_conn_probe::serve(hc, "POST /echo HTTP/1.1\r\nHost: x\r\nContent-Length: 0\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 405");
+    CHECK_HAS(resp, "Allow: GET\r\n");
+    http_conn_probe::reset(hc);
+
+    // 处理函数没有给出内容时使用预先生成的错误页面
+    resp = http_conn_probe::serve(hc, "GET /missing HTTP/1.1\r\nHost: x\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 404");
+    http_conn_probe::reset(hc);
+
+    // 不认识的状态码按 500 发送, 统计的也是 500
+    resp = http_conn_probe::serve(hc, "GET /odd HTTP/1.1\r\nHost: x\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 500");
+    http_conn_probe::reset(hc);
+    std::string text;
+    metrics::render(text);
+    CHECK(text.find("nk_requests_total{code=\"500\"}") != std::string::npos);
+    CHECK(text.find("nk_requests_total{code=\"299\"}") == std::string::npos);
+
+    resp = http_conn_probe::serve(hc, "GET " HEALTH_URL " HTTP/1.1\r\nHost: x\r\n\r\n");
+    CHECK_HAS(resp, "HTTP/1.1 200");
+    CHECK_HAS(resp, "Content-Type: application/json\r\n");
+    http_conn_probe::reset(hc);
+
+    http_conn_probe::close(hc, peer);
+    delete hc;
+}
+
+void test_router(){
+    test_route_table();
+    test_router_find();
+    test_dispatch();
+}
@@ -0,0 +1,115 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: slab 分配器的测试
+ * @Date: 2026-10-17 19:46:30
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 19:46:30
+ */
+#include "test.h"
+#include "slab_pool.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static int s_constructed = 0;
+static int s_destroyed = 0;
+
+struct slab_object{
+    uint64_t id;
+    char payload[56];
+
+    slab_object() : id(0){ s_constructed++; }
+    ~slab_object(){ s_destroyed++; }
+};
+
+static const size_t SLAB_SIZE = 4096;
+static const size_t PER_SLAB = (SLAB_SIZE - 64) / sizeof(slab_object);     // 至少这么多
+
+static void test_grow_and_shrink(){
+    slab_pool<slab_object, SLAB_SIZE> pool;
+    CHECK_EQ(pool.bytes(), 0);
+
+    std::vector<slab_object*> objects;
+    for(size_t i = 0; i < PER_SLAB * 5; i++){
+        slab_object* obj = pool.create();
+        CHECK(obj != nullptr);
+        if(!obj) return;
+        CHECK_EQ(obj->id, 0);
+        obj->id = i;
+        memset(obj->payload, (int)(i & 0xff), sizeof(obj->payload));
+        objects.push_back(obj);
+    }
+    CHECK_EQ(pool.live(), objects.size());
+    CHECK_EQ(s_constructed, objects.size());
+    CHECK(pool.bytes() >= 5 * SLAB_SIZE && pool.bytes() <= 6 * SLAB_SIZE);
+
+    // 对象不重叠, 且都位于按 SLAB_SIZE 对齐的 slab 中, 头部之后
+    for(size_t i = 0; i < objects.size(); i++){
+        CHECK_EQ(objects[i]->id, i);
+        CHECK((uintptr_t)objects[i] % SLAB_SIZE >= sizeof(void*) * 4);
+        CHECK((uintptr_t)objects[i] % alignof(slab_object) == 0);
+    }
+    std::vector<slab_object*> sorted = objects;
+    std::sort(sorted.begin(), sorted.end());
+    for(size_t i = 1; i < sorted.size(); i++){
+        CHECK((char*)sorted[i] - (char*)sorted[i - 1] >= (long)sizeof(slab_object));
+    }
+
+    // 全部释放后只保留一个备用 slab
+    for(slab_object* obj : objects) pool.destroy(obj);
+    CHECK_EQ(pool.live(), 0);
+    CHECK_EQ(s_destroyed, objects.size());
+    CHECK_EQ(pool.bytes(), SLAB_SIZE);
+
+    // 再次分配先使用备用 slab
+    slab_object* obj = pool.create();
+    CHECK_EQ(pool.bytes(), SLAB_SIZE);
+    pool.destroy(obj);
+}
+
+/**
+ * @brief 随机分配与释放, 对象内容不被其他对象或空闲链表覆盖
+ */
+static void test_random(){
+    slab_pool<slab_object, SLAB_SIZE> pool;
+    std::vector<slab_object*> live;
+    std::mt19937 rng(20261017);
+    uint64_t next_id = 1;
+    for(int step = 0; step < 200000; step++){
+        bool create = live.empty() || (rng() % 100) < (live.size() < PER_SLAB * 8 ? 60u : 40u);
+        if(create){
+            slab_object* obj = pool.create();
+            CHECK(obj != nullptr);
+            if(!obj) return;
+            obj->id = next_id++;
+            memset(obj->payload, (int)(obj->id & 0xff), sizeof(obj->payload));
+            live.push_back(obj);
+        }else{
+            size_t i = rng() % live.size();
+            slab_object* obj = live[i];
+            bool intact = true;
+            for(char c : obj->payload) intact = intact && c == (char)(obj->id & 0xff);
+            CHECK(intact);
+            pool.destroy(obj);
+            live[i] = live.back();
+            live.pop_back();
+        }
+        if(pool.live() != live.size()){
+            CHECK_EQ(pool.live(), live.size());
+            return;
+        }
+    }
+    // slab 数随活跃对象数变化, 不超过装下它们所需的数量加一个备用
+    size_t needed = (live.size() + PER_SLAB - 1) / PER_SLAB;
+    CHECK(pool.bytes() >= needed * SLAB_SIZE);
+    for(slab_object* obj : live) pool.destroy(obj);
+    CHECK_EQ(pool.live(), 0);
+    CHECK_EQ(pool.bytes(), SLAB_SIZE);
+}
+
+void test_slab_pool(){
+    test_grow_and_shrink();
+    test_random();
+    CHECK_EQ(s_constructed, s_destroyed);
+}
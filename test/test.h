@@ -0,0 +1,150 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 测试共用的检查宏、临时目录与 http_conn_probe
+ * @Date: 2026-10-17 19:20:12
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 19:20:12
+ */
+#ifndef NK_TEST_H
+#define NK_TEST_H
+
+#include "http_conn.h"
+#include <string>
+
+// 失败的检查数, main() 以它是否为 0 作为退出码
+extern int g_failures;
+
+#define CHECK(cond) do{ \
+    if(!(cond)){ \
+        fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        g_failures++; \
+    } \
+}while(0)
+
+#define CHECK_EQ(a, b) do{ \
+    long long va_ = (long long)(a), vb_ = (long long)(b); \
+    if(va_ != vb_){ \
+        fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, va_, vb_); \
+        g_failures++; \
+    } \
+}while(0)
+
+// 响应文本中包含 text, text 可以是字符串字面量或 std::string
+#define CHECK_HAS(resp, text) do{ \
+    if((resp).find(text) == std::string::npos){ \
+        fprintf(stderr, "%s:%d: response has no \"%s\":\n%s\n", __FILE__, __LINE__, std::string(text).c_str(), (resp).c_str()); \
+        g_failures++; \
+    } \
+}while(0)
+
+/**
+ * @brief 测试用的静态文件根目录(临时目录), 第一次调用时创建, 由 main() 设为 DOC_ROOT 并在结束时删除
+ */
+const char* test_root();
+
+/**
+ * @brief 在 test_root() 下写入一个文件, 返回其绝对路径
+ */
+std::string write_file(const char* name, const std::string& content);
+
+/**
+ * 通过 http_conn 的友元调用私有的解析与响应生成函数;
+ * 连接使用非阻塞 socketpair 的一端, 另一端由测试持有, 不经过事件引擎
+ */
+struct http_conn_probe{
+    typedef http_conn::byte_range byte_range;
+    typedef http_conn::send_op send_op;
+
+    static int open(http_conn* hc){
+        int sv[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) < 0) return -1;
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        hc->init(sv[0], addr, nullptr);
+        return sv[1];
+    }
+
+    static void close(http_conn* hc, int peer){
+        int fd = hc->m_sockfd;
+        hc->release();
+        ::close(fd);
+        ::close(peer);
+    }
+
+    static void init(http_conn* hc){ hc->init(); }
+
+    static http_conn::HTTP_CODE parse_request_line(http_conn* hc, char* text){
+        return hc->parse_request_line(text, text + strlen(text));
+    }
+
+    static http_conn::HTTP_CODE parse_header(http_conn* hc, char* text){
+        return hc->parse_header(text, text + strlen(text));
+    }
+
+    static int parse_ranges(const char* value, off_t size, byte_range* ranges, int max){
+        return http_conn::parse_ranges(value, size, ranges, max);
+    }
+
+    /**
+     * @brief 把请求追加到读缓冲区并解析, 不生成响应
+     */
+    static http_conn::HTTP_CODE read(http_conn* hc, const std::string& request){
+        if(!hc->m_read_buf.reserve(hc->m_read_idx, hc->m_read_idx + request.size())) return http_conn::INTERNAL_ERROR;
+        memcpy(hc->m_read_buf.data() + hc->m_read_idx, request.data(), request.size());
+        hc->m_read_idx += request.size();
+        return hc->process_read();
+    }
+
+    /**
+     * @brief 把请求追加到读缓冲区, 处理其中所有完整的请求, 返回新生成的各响应头(错误响应含页面)连在一起的文本;
+     *        响应留在队列中, 由 response_count()、body_size() 检查, reset() 清空
+     */
+    static std::string serve(http_conn* hc, const std::string& request){
+        if(!hc->m_read_buf.reserve(hc->m_read_idx, hc->m_read_idx + request.size())) return std::string();
+        memcpy(hc->m_read_buf.data() + hc->m_read_idx, request.data(), request.size());
+        hc->m_read_idx += request.size();
+        int first = hc->m_response_count;
+        hc->process_requests();
+        std::string text;
+        for(int i = first; i < hc->m_response_count; i++){
+            const http_conn::response& r = hc->m_responses[i];
+            text.append(hc->m_write_buf.data() + r.header_offset, r.header_len);
+        }
+        return text;
+    }
+
+    static int response_count(http_conn* hc){ return hc->m_response_count; }
+    static off_t body_offset(http_conn* hc, int i){ return hc->m_responses[i].body_offset; }
+    static off_t body_size(http_conn* hc, int i){ return hc->m_responses[i].body_size; }
+    static bool closes(http_conn* hc, int i){ return hc->m_responses[i].close; }
+    static bool prepare_send(http_conn* hc, send_op& op){ return hc->prepare_send(op); }
+
+    /**
+     * @brief 读缓冲区中还没有处理的数据(未完整的流水线请求)
+     */
+    static std::string pending(http_conn* hc){
+        return std::string(hc->m_read_buf.data() + hc->m_request_start, hc->m_read_idx - hc->m_request_start);
+    }
+
+    /**
+     * @brief 相当于响应已全部发出
+     */
+    static void reset(http_conn* hc){ hc->finish_write(); }
+};
+
+void test_http_conn();
+void test_pipeline();
+void test_header_table();
+void test_response();
+void test_http_scan();
+void test_router();
+void test_ranges();
+void test_conditional();
+void test_body();
+void test_timer_wheel();
+void test_mpmc_queue();
+void test_slab_pool();
+void test_file_cache();
+
+#endif // NK_TEST_H
@@ -0,0 +1,171 @@
+/*
+ * @Author: fs1n
+ * @Email: fs1n@qq.com
+ * @Description: 分层时间轮的测试: 跨层下沉(cascade)后定时器恰好在到期的 tick 取出, next_timeout 等到最近的到期或下沉
+ * @Date: 2026-10-17 19:40:16
+ * @LastEditors: fs1n
+ * @LastEditTime: 2026-10-17 19:40:16
+ */
+#include "test.h"
+#include <random>
+#include <vector>
+
+static void test_add_del(){
+    timer_wheel wheel(100, 1000);
+    timer_node a = {nullptr, nullptr, 0, nullptr};
+    timer_node b = {nullptr, nullptr, 0, nullptr};
+    CHECK_EQ(wheel.next_timeout(1000), -1);
+
+    wheel.add(&a, 250);                                 // 向上取整为 3 个 tick
+    CHECK_EQ(wheel.next_timeout(1000), 300);            // 等待到最近的定时器, 而不是每个 tick 唤醒
+    CHECK_EQ(wheel.next_timeout(1250), 50);
+    wheel.add(&b, 0);                                   // 至少一个 tick
+    CHECK_EQ(wheel.size(), 2);
+    CHECK_EQ(wheel.next_timeout(1000), 100);
+    CHECK_EQ(wheel.next_timeout(1050), 50);
+
+    timer_node* expired = wheel.expire(1199);
+    CHECK(expired == &b && b.next == nullptr && !b.linked());
+    CHECK_EQ(wheel.next_timeout(1199), 101);
+    CHECK(wheel.expire(1299) == nullptr);
+    CHECK_EQ(wheel.next_timeout(1400), 0);              // 已过期但还没有推进
+    CHECK(wheel.expire(1300) == &a);
+    CHECK_EQ(wheel.size(), 0);
+    CHECK_EQ(wheel.next_timeout(1300), -1);
+
+    // 重置与删除
+    wheel.add(&a, 1000);
+    wheel.add(&a, 200);
+    CHECK_EQ(wheel.size(), 1);
+    CHECK(wheel.expire(1500) == &a);
+    wheel.add(&a, 100);
+    wheel.del(&a);
+    wheel.del(&a);
+    CHECK_EQ(wheel.size(), 0);
+    CHECK(!a.linked());
+    CHECK(wheel.expire(10000) == nullptr);
+}
+
+/**
+ * @brief 上层的定时器: 第 0 层为空时等到第 0 层转完一圈(tick 256 的倍数), 下沉到第 0 层后等到它到期
+ */
+static void test_next_timeout(){
+    timer_wheel wheel(100, 1000);                       // 当前 tick 10
+    timer_node a = {nullptr, nullptr, 0, nullptr};
+    wheel.add(&a, 100000);                              // tick 1010, 在第 1 层
+    CHECK_EQ(wheel.next_timeout(1000), 25600 - 1000);
+    CHECK(wheel.expire(25600) == nullptr);
+    CHECK_EQ(wheel.next_timeout(25600), 25600);
+    CHECK(wheel.expire(51200) == nullptr);
+    CHECK(wheel.expire(76800) == nullptr);              // tick 768 下沉到第 0 层
+    CHECK_EQ(wheel.next_timeout(76800), 101000 - 76800);
+    CHECK(wheel.expire(100999) == nullptr);
+    CHECK(wheel.expire(101000) == &a);
+
+    // 第 0 层中的定时器跨过一圈的边界时不必在边界唤醒
+    timer_wheel near(1, 250);
+    timer_node b = {nullptr, nullptr, 0, nullptr};
+    near.add(&b, 3);                                    // tick 253
+    CHECK_EQ(near.next_timeout(250), 3);
+    near.add(&b, 10);                                   // tick 260, 在第 0 层的槽位 4
+    CHECK_EQ(near.next_timeout(250), 6);                // tick 256 处唤醒一次
+    CHECK(near.expire(256) == nullptr);
+    CHECK_EQ(near.next_timeout(256), 4);
+    CHECK(near.expire(260) == &b);
+}
+
+/**
+ * @brief 只在 next_timeout() 给出的时间唤醒, 每个定时器都恰好在到期的 tick 取出, 不会提前或错过
+ */
+static void test_wait_exact(){
+    const uint64_t start = 987654321;
+    timer_wheel wheel(1, start);
+    std::mt19937_64 rng(1017);
+    std::vector<timer_node> nodes(300);
+    std::vector<uint64_t> due(nodes.size());
+    for(size_t i = 0; i < nodes.size(); i++){
+        uint64_t timeout = i % 3 ? rng() % 5000 + 1 : rng() % (1u << 22) + 1;
+        nodes[i] = {nullptr, nullptr, 0, (void*)i};
+        wheel.add(&nodes[i], timeout);
+        due[i] = start + timeout;
+    }
+    uint64_t now = start;
+    size_t remaining = nodes.size();
+    int wakeups = 0;
+    while(remaining > 0 && wakeups < 1000000){
+        int wait = wheel.next_timeout(now);
+        CHECK(wait > 0);
+        if(wait <= 0) break;
+        now += wait;
+        wakeups++;
+        for(timer_node* node = wheel.expire(now); node; node = node->next){
+            size_t i = (size_t)node->data;
+            if(due[i] != now){
+                fprintf(stderr, "timer %zu due at %llu fired at %llu\n", i,
+                        (unsigned long long)due[i], (unsigned long long)now);
+                g_failures++;
+            }
+            remaining--;
+        }
+    }
+    CHECK_EQ(remaining, 0);
+    // 每个定时器最多一次, 加上第 0 层每转一圈一次
+    CHECK(wakeups <= (int)nodes.size() + (1 << 22) / 256 + 2);
+}
+
+/**
+ * @brief 各层边界附近与随机的超时, 时间以随机步长推进, 每个定时器都应在第一次越过到期 tick 的 expire() 中取出
+ */
+static void test_cascade(){
+    const uint64_t start = 123456789;                  // 不从槽位边界开始
+    const uint64_t max_ticks = (uint64_t)1 << 26;       // 四层共覆盖的 tick 数
+    timer_wheel wheel(1, start);
+
+    std::vector<uint64_t> timeouts = {
+        1, 2, 255, 256, 257, 16383, 16384, 16385,
+        (1u << 20) - 1, 1u << 20, (1u << 20) + 1, max_ticks - 2, max_ticks - 1, max_ticks * 4,
+    };
+    std::mt19937_64 rng(20261017);
+    for(int i = 0; i < 200; i++) timeouts.push_back(rng() % (max_ticks - 1) + 1);
+    for(int i = 0; i < 200; i++) timeouts.push_back(rng() % 20000 + 1);
+
+    std::vector<timer_node> nodes(timeouts.size());
+    std::vector<uint64_t> due(timeouts.size());
+    for(size_t i = 0; i < nodes.size(); i++){
+        nodes[i] = {nullptr, nullptr, 0, (void*)i};
+        wheel.add(&nodes[i], timeouts[i]);
+        due[i] = start + std::min(timeouts[i], max_ticks - 1);
+    }
+    CHECK_EQ(wheel.size(), nodes.size());
+
+    std::vector<bool> fired(nodes.size(), false);
+    uint64_t now = start;
+    size_t remaining = nodes.size();
+    while(remaining > 0 && now < start + max_ticks + 10){
+        uint64_t prev = now;
+        now += rng() % 5000 + 1;
+        for(timer_node* node = wheel.expire(now); node; ){
+            timer_node* next = node->next;
+            size_t i = (size_t)node->data;
+            CHECK(!fired[i]);
+            if(due[i] <= prev || due[i] > now){
+                fprintf(stderr, "timer %zu (timeout %llu) due at %llu fired in (%llu, %llu]\n", i,
+                        (unsigned long long)timeouts[i], (unsigned long long)due[i],
+                        (unsigned long long)prev, (unsigned long long)now);
+                g_failures++;
+            }
+            fired[i] = true;
+            remaining--;
+            node = next;
+        }
+        CHECK_EQ(wheel.size(), remaining);
+    }
+    CHECK_EQ(remaining, 0);
+}
+
+void test_timer_wheel(){
+    test_add_del();
+    test_next_timeout();
+    test_wait_exact();
+    test_cascade();
+}